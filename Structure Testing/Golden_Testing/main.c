@@ -0,0 +1,378 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <glob.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+#define BASELINE_PATH "Structure Testing/Golden_Testing/baseline.csv"   // default baseline, written on first run
+#define TOLERANCE_PERCENTAGE 25         // growth of time or peak rss over the baseline reported as regression
+#define MIN_TIME_MS 20                  // time differences below this are noise, whatever the percentage
+#define MIN_RSS_KB 1024                 // rss differences below this are noise, whatever the percentage
+#define REPETITIONS 3                   // runs of each input, the fastest one is kept
+#define PATH_SIZE 4096                  // longest path of an input or golden file
+
+static const char* corpus[] = {         // inputs, golden output of x.in is x.out, of .../i/x is .../o/x
+    "Test Pubblici/*/*.in",
+    "Test Pubblici/*/i/*.txt",
+    "Test.txt",
+};
+
+/*
+ * Time and peak rss of an input, from a run or from the baseline
+ */
+typedef struct run {
+    char* input;
+    double ms;
+    long rss_kb;
+} run_t;
+
+/*
+ * Options of the harness
+ */
+typedef struct options {
+    const char* baseline;
+    int tolerance;          // percentage
+    double min_ms;
+    long min_kb;
+    int reps;
+    int write;              // 1 to rewrite the baseline with this run
+    char** engine;          // engine binary and its arguments, NULL terminated
+} options_t;
+
+/*
+ * Compare function for qsort and bsearch of runs
+ */
+int compare_runs(const void* a, const void* b) {
+    
+    return strcmp(((const run_t*)a)->input, ((const run_t*)b)->input);
+}
+
+/*
+ * Path of the golden output of input, 0 if it has none
+ */
+int golden_path(const char* input, char* out) {
+    
+    size_t len = strlen(input);
+    const char* dir;
+    
+    if (len + 2 > PATH_SIZE)
+        return 0;
+    strcpy(out, input);
+    
+    if (len > 3 && strcmp(input + len - 3, ".in") == 0)
+        strcpy(out + len - 3, ".out");
+    else if ((dir = strstr(input, "/i/")) != NULL)
+        out[dir - input + 1] = 'o';
+    else
+        return 0;
+    
+    return access(out, R_OK) == 0;
+}
+
+/*
+ * Read a whole file, dropping carriage returns and a blank right before the end of a line,
+ * so that golden files written on Windows and reports with a trailing space compare equal
+ */
+char* read_normalized(FILE* f, size_t* len) {
+    
+    size_t size = 65536, n = 0;
+    char* buf = malloc(size);
+    int c;
+    
+    while ((c = getc(f)) != EOF) {
+        if (c == '\r')
+            continue;
+        if (c == '\n' && n > 0 && buf[n-1] == ' ')
+            n--;
+        if (n == size) {
+            size = size << 1;
+            buf = realloc(buf, size);
+        }
+        buf[n++] = c;
+    }
+    if (n > 0 && buf[n-1] == ' ')
+        n--;
+    
+    *len = n;
+    return buf;
+}
+
+/*
+ * Compare the output of a run with the golden file. Return 0 if equal, else the first line that differs
+ */
+long compare_output(FILE* out, const char* golden) {
+    
+    FILE* g = fopen(golden, "r");
+    char* a;
+    char* b;
+    size_t a_len, b_len, i;
+    long line = 1;
+    
+    if (g == NULL) {
+        perror(golden);
+        return 1;
+    }
+    rewind(out);
+    a = read_normalized(out, &a_len);
+    b = read_normalized(g, &b_len);
+    fclose(g);
+    
+    for (i=0; i<a_len && i<b_len && a[i] == b[i]; i++)
+        if (a[i] == '\n')
+            line++;
+    if (i == a_len && i == b_len)
+        line = 0;
+    
+    free(a);
+    free(b);
+    return line;
+}
+
+/*
+ * Run the engine once with input on stdin and out as stdout. Return the exit status, -1 if it did not run
+ */
+int run_engine(char** engine, const char* input, FILE* out, run_t* run) {
+    
+    struct timespec start, end;
+    struct rusage usage;
+    int status, in;
+    pid_t pid;
+    
+    in = open(input, O_RDONLY);
+    if (in < 0) {
+        perror(input);
+        return -1;
+    }
+    fflush(out);
+    if (ftruncate(fileno(out), 0) != 0 || fseek(out, 0, SEEK_SET) != 0) {
+        perror("output");
+        close(in);
+        return -1;
+    }
+    
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    pid = fork();
+    if (pid == 0) {
+        dup2(in, STDIN_FILENO);
+        dup2(fileno(out), STDOUT_FILENO);
+        execv(engine[0], engine);
+        perror(engine[0]);
+        _exit(127);
+    }
+    close(in);
+    if (pid < 0 || wait4(pid, &status, 0, &usage) < 0) {
+        perror("fork");
+        return -1;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    
+    run->ms = (end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) / 1e6;
+    run->rss_kb = usage.ru_maxrss;
+    
+    return WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+}
+
+/*
+ * Load the baseline, sorted by input. Return the number of runs, -1 if there is no baseline
+ */
+long load_baseline(const char* path, run_t** runs) {
+    
+    FILE* f = fopen(path, "r");
+    char line[PATH_SIZE + 64];
+    char* comma;
+    long n = 0, size = 1024;
+    
+    if (f == NULL)
+        return -1;
+    *runs = malloc(size * sizeof(run_t));
+    
+    while (fgets(line, sizeof(line), f) != NULL) {
+        comma = strrchr(line, ',');                 // input,ms,rss_kb, inputs may contain commas
+        if (comma == NULL || comma == line)
+            continue;
+        *comma = '\0';
+        (*runs)[n].rss_kb = atol(comma + 1);
+        comma = strrchr(line, ',');
+        if (comma == NULL)
+            continue;
+        *comma = '\0';
+        if (strcmp(comma + 1, "ms") == 0)           // header
+            continue;
+        (*runs)[n].ms = atof(comma + 1);
+        (*runs)[n].input = strdup(line);
+        if (++n == size) {
+            size = size << 1;
+            *runs = realloc(*runs, size * sizeof(run_t));
+        }
+    }
+    fclose(f);
+    
+    qsort(*runs, n, sizeof(run_t), compare_runs);
+    return n;
+}
+
+/*
+ * Write the runs of this session as the new baseline
+ */
+int write_baseline(const char* path, run_t* runs, const long n) {
+    
+    FILE* f = fopen(path, "w");
+    long i;
+    
+    if (f == NULL) {
+        perror(path);
+        return -1;
+    }
+    fprintf(f, "input,ms,rss_kb\n");
+    for (i=0; i<n; i++)
+        fprintf(f, "%s,%.2f,%ld\n", runs[i].input, runs[i].ms, runs[i].rss_kb);
+    
+    return fclose(f);
+}
+
+/*
+ * Parse harness options up to the engine binary, the rest of the line goes to the engine
+ */
+int parse_options(int argc, char** argv, options_t* opt) {
+    
+    int i;
+    
+    opt->baseline = BASELINE_PATH;
+    opt->tolerance = TOLERANCE_PERCENTAGE;
+    opt->min_ms = MIN_TIME_MS;
+    opt->min_kb = MIN_RSS_KB;
+    opt->reps = REPETITIONS;
+    opt->write = 0;
+    
+    for (i=1; i<argc && argv[i][0] == '-'; i++) {
+        if (strcmp(argv[i], "-b") == 0 && i+1 < argc)               // baseline file
+            opt->baseline = argv[++i];
+        else if (strcmp(argv[i], "-t") == 0 && i+1 < argc)          // tolerated percentage
+            opt->tolerance = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-m") == 0 && i+1 < argc)          // noise floor of time
+            opt->min_ms = atof(argv[++i]);
+        else if (strcmp(argv[i], "-k") == 0 && i+1 < argc)          // noise floor of rss
+            opt->min_kb = atol(argv[++i]);
+        else if (strcmp(argv[i], "-r") == 0 && i+1 < argc)          // runs of each input
+            opt->reps = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-w") == 0)                        // rewrite baseline
+            opt->write = 1;
+        else {
+            fprintf(stderr, "unknown option: %s\n", argv[i]);
+            return -1;
+        }
+    }
+    
+    if (i == argc || opt->tolerance < 0 || opt->reps < 1) {
+        fprintf(stderr, "usage: %s [-b baseline] [-t percentage] [-m ms] [-k kb] [-r runs] [-w] engine [engine options]\n", argv[0]);
+        return -1;
+    }
+    opt->engine = argv + i;
+    
+    return 0;
+}
+
+/*
+ * Run the engine over every corpus input, compare outputs with golden files, time and peak rss with the baseline.
+ * One csv line per input on stdout, exit 1 on a wrong output, a failed run or a regression
+ */
+int main(int argc, char** argv) {
+    
+    options_t opt;
+    glob_t files;
+    run_t* base = NULL;
+    run_t* runs;
+    run_t* old;
+    run_t run;
+    FILE* out;
+    char golden[PATH_SIZE];
+    const char* status;
+    long base_count, diff_line, wrong = 0, slower = 0, i;
+    size_t f;
+    int c, r, code;
+    
+    if (parse_options(argc, argv, &opt) != 0)
+        return 2;
+    
+    for (c=0; c<sizeof(corpus)/sizeof(char*); c++)
+        glob(corpus[c], c > 0 ? GLOB_APPEND : 0, NULL, &files);
+    if (files.gl_pathc == 0) {
+        fprintf(stderr, "no corpus input, run from the repository root\n");
+        return 2;
+    }
+    
+    base_count = load_baseline(opt.baseline, &base);
+    if (base_count < 0)
+        opt.write = 1;
+    runs = malloc(files.gl_pathc * sizeof(run_t));
+    out = tmpfile();
+    
+    printf("input,status,ms,base_ms,rss_kb,base_rss_kb\n");
+    for (f=0; f<files.gl_pathc; f++) {
+        runs[f].input = files.gl_pathv[f];
+        runs[f].ms = -1;
+        runs[f].rss_kb = 0;
+    
+        for (r=0, code=0; r<opt.reps && code == 0; r++) {      // fastest run, smallest rss
+            code = run_engine(opt.engine, runs[f].input, out, &run);
+            if (runs[f].ms < 0 || run.ms < runs[f].ms)
+                runs[f].ms = run.ms;
+            if (runs[f].rss_kb == 0 || run.rss_kb < runs[f].rss_kb)
+                runs[f].rss_kb = run.rss_kb;
+        }
+    
+        old = (base_count > 0) ? bsearch(&runs[f], base, base_count, sizeof(run_t), compare_runs) : NULL;
+        diff_line = 0;
+        if (code != 0)
+            status = "failed";
+        else if (golden_path(runs[f].input, golden) && (diff_line = compare_output(out, golden)) != 0)
+            status = "wrong";
+        else if (old == NULL)
+            status = "new";
+        else if (runs[f].ms > old->ms * (100 + opt.tolerance) / 100 && runs[f].ms - old->ms > opt.min_ms)
+            status = "slower";
+        else if (runs[f].rss_kb > old->rss_kb * (100 + opt.tolerance) / 100 && runs[f].rss_kb - old->rss_kb > opt.min_kb)
+            status = "bigger";
+        else
+            status = "ok";
+    
+        if (code != 0 || diff_line != 0) {
+            wrong++;
+            if (code != 0)
+                fprintf(stderr, "%s: engine exited with %d\n", runs[f].input, code);
+            else
+                fprintf(stderr, "%s: output differs from %s at line %ld\n", runs[f].input, golden, diff_line);
+        }
+        else if (status[0] == 's' || status[0] == 'b')
+            slower++;
+    
+        printf("\"%s\",%s,%.2f,", runs[f].input, status, runs[f].ms);
+        if (old != NULL)
+            printf("%.2f,%ld,%ld\n", old->ms, runs[f].rss_kb, old->rss_kb);
+        else
+            printf(",%ld,\n", runs[f].rss_kb);
+        fflush(stdout);
+    }
+    
+    fprintf(stderr, "%zu inputs, %ld wrong or failed, %ld regressions over %d%%\n",
+            files.gl_pathc, wrong, slower, opt.tolerance);
+    if (opt.write) {
+        if (wrong > 0)
+            fprintf(stderr, "baseline not written, some outputs are wrong\n");
+        else if (write_baseline(opt.baseline, runs, files.gl_pathc) == 0)
+            fprintf(stderr, "baseline written to %s\n", opt.baseline);
+    }
+    
+    for (i=0; i<base_count; i++)
+        free(base[i].input);
+    free(base);
+    free(runs);
+    fclose(out);
+    globfree(&files);
+    
+    return (wrong > 0 || slower > 0) ? 1 : 0;
+}
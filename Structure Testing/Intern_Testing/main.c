@@ -0,0 +1,210 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "intern.h"
+
+#define NAME_COUNT 4096                 // distinct names used by the benchmark
+#define NAME_SIZE 30+1                  // length of a name
+#define OPS_PER_THREAD 1000000          // operations run by each thread
+#define WRITE_PERCENTAGE 5              // inserts and deletes on total operations
+#define MAX_BENCH_THREADS 64            // threads of the last round, doubled from 1
+
+/*
+ * Sorted array protected by a mutex, baseline structure
+ */
+typedef struct locked_arr {
+    pthread_mutex_t lock;
+    char** arr;             // sorted names
+    int count;
+} locked_arr_t;
+
+/*
+ * Arguments of a benchmark thread
+ */
+typedef struct bench_arg {
+    int use_intern;         // 1 for interning table, 0 for locked array
+    unsigned seed;          // seed of the operation sequence
+    t_intern_table* table;
+    locked_arr_t* locked;
+} bench_arg_t;
+
+char names[NAME_COUNT][NAME_SIZE];
+
+/*
+ * Compare two names for bsearch and qsort
+ */
+int compare_names(const void* a, const void* b) {
+    return strcmp(*(char**)a, *(char**)b);
+}
+
+/*
+ * Search a name in the locked array
+ */
+char* locked_search(locked_arr_t* locked, char* name) {
+    
+    char** found;
+    char* result;
+    
+    pthread_mutex_lock(&locked->lock);
+    found = bsearch(&name, locked->arr, locked->count, sizeof(char*), compare_names);
+    result = found ? *found : NULL;
+    pthread_mutex_unlock(&locked->lock);
+    
+    return result;
+}
+
+/*
+ * Insert a name in the locked array, keeping it sorted
+ */
+void locked_insert(locked_arr_t* locked, char* name) {
+    
+    int lo = 0, hi, mid, cmp;
+    
+    pthread_mutex_lock(&locked->lock);
+    hi = locked->count;
+    while (lo < hi) {                               // binary search of insertion point
+        mid = (lo + hi) / 2;
+        cmp = strcmp(locked->arr[mid], name);
+        if (cmp == 0) {
+            pthread_mutex_unlock(&locked->lock);
+            return;
+        }
+        if (cmp < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    memmove(&locked->arr[lo+1], &locked->arr[lo], (locked->count - lo) * sizeof(char*));
+    locked->arr[lo] = name;
+    locked->count++;
+    pthread_mutex_unlock(&locked->lock);
+}
+
+/*
+ * Delete a name from the locked array
+ */
+void locked_delete(locked_arr_t* locked, char* name) {
+    
+    char** found;
+    
+    pthread_mutex_lock(&locked->lock);
+    found = bsearch(&name, locked->arr, locked->count, sizeof(char*), compare_names);
+    if (found) {
+        memmove(found, found+1, (locked->arr + locked->count - found - 1) * sizeof(char*));
+        locked->count--;
+    }
+    pthread_mutex_unlock(&locked->lock);
+}
+
+/*
+ * Run OPS_PER_THREAD random operations on one of the structures
+ */
+void* bench_thread(void* p) {
+    
+    bench_arg_t* arg = p;
+    unsigned seed = arg->seed;
+    t_intern_thread* self = NULL;
+    int i, op, created;
+    char* name;
+    
+    if (arg->use_intern)
+        self = intern_join(arg->table);
+    
+    for (i=0; i<OPS_PER_THREAD; i++) {
+        name = names[rand_r(&seed) % NAME_COUNT];
+        op = rand_r(&seed) % 100;
+    
+        if (arg->use_intern) {
+            if (op < WRITE_PERCENTAGE / 2)                          // delete
+                intern_delete(arg->table, self, name);
+            else if (op < WRITE_PERCENTAGE)                         // insert
+                intern_insert(arg->table, self, name, &created);
+            else                                                    // search
+                intern_search(arg->table, self, name);
+        }
+        else {
+            if (op < WRITE_PERCENTAGE / 2)
+                locked_delete(arg->locked, name);
+            else if (op < WRITE_PERCENTAGE)
+                locked_insert(arg->locked, name);
+            else
+                locked_search(arg->locked, name);
+        }
+    }
+    
+    if (arg->use_intern)
+        intern_leave(arg->table, self);
+    
+    return NULL;
+}
+
+/*
+ * Run a round with passed number of threads, return operations per second
+ */
+double run_round(int use_intern, int thread_count) {
+    
+    pthread_t thread[MAX_BENCH_THREADS];
+    bench_arg_t arg[MAX_BENCH_THREADS];
+    t_intern_table* table = NULL;
+    t_intern_thread* self;
+    locked_arr_t locked;
+    struct timespec start, end;
+    double elapsed;
+    int i, created;
+    
+    if (use_intern) {                               // fill half the names before timing
+        table = intern_create();
+        self = intern_join(table);
+        for (i=0; i<NAME_COUNT; i+=2)
+            intern_insert(table, self, names[i], &created);
+        intern_leave(table, self);
+    }
+    else {
+        pthread_mutex_init(&locked.lock, NULL);
+        locked.arr = malloc(NAME_COUNT * sizeof(char*));
+        locked.count = 0;
+        for (i=0; i<NAME_COUNT; i+=2)
+            locked_insert(&locked, names[i]);
+    }
+    
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i=0; i<thread_count; i++) {
+        arg[i].use_intern = use_intern;
+        arg[i].seed = i + 1;
+        arg[i].table = table;
+        arg[i].locked = &locked;
+        pthread_create(&thread[i], NULL, bench_thread, &arg[i]);
+    }
+    for (i=0; i<thread_count; i++)
+        pthread_join(thread[i], NULL);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    
+    elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    
+    if (use_intern)
+        intern_destroy(table);
+    else {
+        free(locked.arr);
+        pthread_mutex_destroy(&locked.lock);
+    }
+    
+    return (double)OPS_PER_THREAD * thread_count / elapsed;
+}
+
+int main(int argc, char** argv) {
+    
+    int i, thread_count;
+    
+    for (i=0; i<NAME_COUNT; i++)
+        snprintf(names[i], NAME_SIZE, "\"entity_%d\"", i);
+    
+    printf("threads,intern_ops_per_sec,locked_ops_per_sec\n");
+    for (thread_count=1; thread_count<=MAX_BENCH_THREADS; thread_count*=2)
+        printf("%d,%.0f,%.0f\n", thread_count, run_round(1, thread_count), run_round(0, thread_count));
+    
+    return 0;
+}
@@ -0,0 +1,881 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "monitor.h"
+
+#define MIN_EXP 2                       // smallest key count is 10^MIN_EXP
+#define MAX_EXP 7                       // biggest key count is 10^MAX_EXP, can be lowered from the command line
+#define REPETITIONS 5                   // timed runs of each case, after one warmup run
+#define OPS_PER_RUN 100000              // operations timed in each run, a pass is repeated on small structures
+#define SHIFT_BUDGET 200000000          // pointers moved by ordered inserts and deletes of one run
+#define MEMORY_LIMIT (3UL << 30)        // cases estimated above this many bytes are skipped
+
+#define INITIAL_ARRAY_SIZE 1024         // initial length of the sorted array, as the array prototype
+#define LOAD_FACTOR_PERCENTAGE 80       // load factor tolerated before resizing, as the hash prototype
+#define INITIAL_HASH_SIZE 503           // initial hash size, prime number
+#define DELETED_VALUE -10               // marker for value of deleted item
+#define NOT_FOUND_VALUE -1              // marker for value of an item not found
+
+#define MPH_MAX_EXP 5                   // biggest relation count of the perfect hash rebuild is 10^MPH_MAX_EXP
+#define HASH_BUCKET_LOAD 1              // average relations per bucket of the perfect hash, as the engine
+#define HASH_MAX_ATTEMPT 2048           // seeds tried for a bucket while most slots are free, as the engine
+#define CHURN_MAX_EXP 4                 // biggest relation count of the relation churn of the engine is 10^CHURN_MAX_EXP
+#define CHURN_TOGGLES 2000              // addrel and delrel of a single edge relation in each run of the churn
+
+static const int name_lens[] = {8, 30, 100};            // lengths of the names, 30 is the one of the prototypes
+static const int hit_pcts[] = {100, 50, 0};             // percentages of operations on a key that is present
+
+/*
+ * Sorted array of names, pointers to the name pool
+ */
+typedef struct sorted_arr {
+    char** arr;
+    size_t count;
+    size_t size;
+} sorted_arr_t;
+
+/*
+ * Bucket of the hash table, key NULL if empty
+ */
+typedef struct hash_item {
+    const char* key;        // entity name
+    int val;                // in final implementation -> val = struct rel_str
+} hash_item_t;
+
+/*
+ * Hash table struct, array of buckets
+ */
+typedef struct hash_table {
+    size_t size;            // prime
+    size_t count;           // live items
+    size_t used;            // live and deleted items
+    hash_item_t* buckets;
+} hash_table_t;
+
+/*
+ * Structure under test, same primitives for the sorted array and the hash table
+ */
+typedef struct bench_struct {
+    const char* name;
+    const char* grow_name;                                  // name of the resize primitive
+    int shifts;                                             // 1 if insert and delete move about count elements
+    void* (*build)(char** keys, const size_t n);
+    void (*destroy)(void* s);
+    int (*search)(void* s, const char* key);                // 1 if found
+    void (*insert)(void* s, const char* key);
+    void (*delete)(void* s, const char* key);
+    double (*grow)(void* s, char** keys, const size_t n);   // ns per key of the resize primitive
+} bench_struct_t;
+
+/*
+ * Operations of one pass, hits first chosen among the keys and misses among names never inserted
+ */
+typedef struct bench_pass {
+    const char** key;
+    size_t ops;
+    size_t hits;
+} bench_pass_t;
+
+/*
+ * Minimal perfect hash over relation names, as the relation table of the engine
+ */
+typedef struct perfect_hash {
+    uint32_t* seed;         // seed of each bucket
+    const char** slot;      // name for each slot
+    size_t buckets;         // number of buckets
+    size_t count;           // number of names, and of slots
+    int valid;              // 1 if a seed was found for every bucket
+} perfect_hash_t;
+
+static const char DELETED_KEY[] = "";   // key of deleted items, as DELETED_ITEM of the hash prototype
+
+/*
+ * Nanoseconds since an arbitrary start
+ */
+static inline double now_ns() {
+    
+    struct timespec t;
+    
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+/*
+ * Compares function for qsort
+ */
+static int my_compare(const void* a, const void* b) {
+    
+    return strcmp(*(const char**)a, *(const char**)b);
+}
+
+/*
+ * Compare function for qsort of doubles
+ */
+static int double_compare(const void* a, const void* b) {
+    
+    double x = *(const double*)a, y = *(const double*)b;
+    
+    return (x > y) - (x < y);
+}
+
+/*
+ * Search the array for entity, one strcmp for each step.
+ * Return position if found, -(insertion point) - 1 else
+ */
+long binary_search(char** arr, const size_t size, const char* target) {
+    
+    long bottom = 0;
+    long mid;
+    long top = (long)size - 1;
+    int c;
+    
+    while(bottom <= top) {
+        mid = (bottom + top)>>1;
+        c = strcmp(arr[mid], target);
+        if (c == 0)
+            return mid;
+        else if (c > 0)
+            top = mid - 1;
+        else
+            bottom = mid + 1;
+    }
+    
+    return -bottom - 1;
+}
+
+/*
+ * Reallocates the array with double the size. Names are pointers to the pool, so no buffer is allocated for them
+ */
+void reallocate(sorted_arr_t* a) {
+    
+    a->size = a->size << 1;
+    a->arr = realloc(a->arr, a->size * sizeof(char*));
+}
+
+/*
+ * Inserts in order new element in the array, shifting the following ones right. Nothing if already present
+ */
+void ordered_insert(void* s, const char* new_elem) {
+    
+    sorted_arr_t* a = s;
+    long pos = binary_search(a->arr, a->count, new_elem);
+    
+    if (pos >= 0)
+        return;
+    pos = -pos - 1;
+    
+    if (a->count == a->size)
+        reallocate(a);
+    memmove(&a->arr[pos+1], &a->arr[pos], (a->count - pos) * sizeof(char*));
+    a->arr[pos] = (char*)new_elem;
+    a->count++;
+}
+
+/*
+ * Delete element in the array shifting the following ones left, as the engine does in place of the tombstone
+ * and qsort of the prototype. Does nothing if element is not present
+ */
+void array_delete(void* s, const char* target) {
+    
+    sorted_arr_t* a = s;
+    long pos = binary_search(a->arr, a->count, target);
+    
+    if (pos < 0)
+        return;
+    memmove(&a->arr[pos], &a->arr[pos+1], (a->count - pos - 1) * sizeof(char*));
+    a->count--;
+}
+
+/*
+ * Search wrapper of the sorted array
+ */
+int array_search(void* s, const char* key) {
+    
+    sorted_arr_t* a = s;
+    
+    return binary_search(a->arr, a->count, key) >= 0;
+}
+
+/*
+ * Sorted array of n keys, built with one qsort
+ */
+void* array_build(char** keys, const size_t n) {
+    
+    sorted_arr_t* a = malloc(sizeof(sorted_arr_t));
+    
+    a->size = INITIAL_ARRAY_SIZE;
+    while (a->size < n + 1)
+        a->size = a->size << 1;
+    a->arr = malloc(a->size * sizeof(char*));
+    memcpy(a->arr, keys, n * sizeof(char*));
+    a->count = n;
+    qsort(a->arr, n, sizeof(char*), my_compare);
+    
+    return a;
+}
+
+/*
+ * Free the sorted array, names belong to the pool
+ */
+void array_destroy(void* s) {
+    
+    sorted_arr_t* a = s;
+    
+    free(a->arr);
+    free(a);
+}
+
+/*
+ * Append n keys to an array growing from INITIAL_ARRAY_SIZE by reallocate. Return ns per key
+ */
+double array_grow(void* s, char** keys, const size_t n) {
+    
+    sorted_arr_t g;
+    size_t i;
+    double start;
+    
+    g.size = INITIAL_ARRAY_SIZE;
+    g.count = 0;
+    g.arr = malloc(g.size * sizeof(char*));
+    
+    start = now_ns();
+    for (i=0; i<n; i++) {
+        if (g.count == g.size)
+            reallocate(&g);
+        g.arr[g.count++] = keys[i];
+    }
+    start = now_ns() - start;
+    
+    free(g.arr);
+    return start / n;
+}
+
+/*
+ * FNV-1a of the name. Power of PRIME_SEED of the prototype overflows past a few characters
+ */
+static inline uint64_t ascii_value(const char* s) {
+    
+    uint64_t h = 14695981039346656037ULL;
+    
+    for (; *s; s++) {
+        h ^= (uint8_t)*s;
+        h *= 1099511628211ULL;
+    }
+    
+    return h;
+}
+
+/*
+ * Return hash value of attempt. hash = (k mod m + attempt * (1 + k mod (m-1))) mod m
+ */
+static inline size_t get_hash(const uint64_t k, const size_t m, const size_t attempt) {
+    
+    return (k % m + attempt * (1 + k % (m-1))) % m;
+}
+
+/*
+ * Calculate a^n%mod
+ */
+uint64_t power(uint64_t a, uint64_t n, const uint64_t mod) {
+    
+    uint64_t result = 1;
+    
+    a %= mod;
+    while (n) {
+        if (n & 1)
+            result = (result * a) % mod;
+        a = (a * a) % mod;
+        n >>= 1;
+    }
+    
+    return result;
+}
+
+/*
+ * Miller-Rabin round, n−1 = 2^s * d with d odd. Return 0 if a proves n composite
+ */
+int witness(const uint64_t n, uint64_t s, const uint64_t d, const uint64_t a) {
+    
+    uint64_t x = power(a, d, n);
+    uint64_t y = x;
+    
+    while (s--) {
+        y = (x * x) % n;
+        if (y == 1 && x != 1 && x != n-1)
+            return 0;
+        x = y;
+    }
+    
+    return y == 1;
+}
+
+/*
+ * Miller-Rabin primality test, bases 2, 3, 5 and 7 are enough below 3,215,031,751
+ */
+int is_prime(const uint64_t n) {
+    
+    uint64_t d = n - 1, s = 0;
+    
+    if (n < 11)
+        return n == 2 || n == 3 || n == 5 || n == 7;
+    if (n % 2 == 0 || n % 3 == 0 || n % 5 == 0 || n % 7 == 0)
+        return 0;
+    
+    while (!(d & 1)) {
+        d >>= 1;
+        s++;
+    }
+    
+    return witness(n, s, d, 2) && witness(n, s, d, 3) && witness(n, s, d, 5) && witness(n, s, d, 7);
+}
+
+/*
+ * Find next prime number after x
+ */
+size_t next_prime(size_t x) {
+    
+    while (!is_prime(++x));
+    
+    return x;
+}
+
+/*
+ * Slot of key, or of the empty bucket ending its chain if missing
+ */
+static inline size_t hash_slot(hash_table_t* ht, const char* key, const uint64_t k) {
+    
+    size_t i, index;
+    
+    for (i=0, index=get_hash(k, ht->size, 0); ht->buckets[index].key != NULL; index=get_hash(k, ht->size, ++i))
+        if (ht->buckets[index].key != DELETED_KEY && strcmp(ht->buckets[index].key, key) == 0)
+            break;
+    
+    return index;
+}
+
+/*
+ * Search value associated to passed key. Return NOT_FOUND_VALUE if not found
+ */
+int search(hash_table_t* ht, const char* key) {
+    
+    size_t index = hash_slot(ht, key, ascii_value(key));
+    
+    return (ht->buckets[index].key == NULL) ? NOT_FOUND_VALUE : ht->buckets[index].val;
+}
+
+/*
+ * Resize the hash table to new_size buckets, reinserting every live item
+ */
+void ht_resize(hash_table_t* ht, const size_t new_size) {
+    
+    size_t i, index, attempt;
+    uint64_t k;
+    hash_item_t* old = ht->buckets;
+    const size_t old_size = ht->size;
+    
+    ht->size = new_size;
+    ht->buckets = calloc(new_size, sizeof(hash_item_t));
+    ht->used = ht->count;
+    
+    for (i=0; i<old_size; i++) {
+        if (old[i].key == NULL || old[i].key == DELETED_KEY)
+            continue;
+        k = ascii_value(old[i].key);
+        for (attempt=0, index=get_hash(k, ht->size, 0); ht->buckets[index].key != NULL; index=get_hash(k, ht->size, ++attempt));
+        ht->buckets[index] = old[i];
+    }
+    
+    free(old);
+}
+
+/*
+ * Insert key - value couple into the hash table. If key already present, does nothing.
+ * A new key takes the first deleted bucket of its chain, the table grows before going beyond the load factor
+ */
+void insert(hash_table_t* ht, const char* key, int value) {
+    
+    uint64_t k = ascii_value(key);
+    size_t i, index, free_index = SIZE_MAX;
+    
+    for (i=0, index=get_hash(k, ht->size, 0); ht->buckets[index].key != NULL; index=get_hash(k, ht->size, ++i)) {
+        if (ht->buckets[index].key == DELETED_KEY) {
+            if (free_index == SIZE_MAX)
+                free_index = index;
+        }
+        else if (strcmp(ht->buckets[index].key, key) == 0)
+            return;
+    }
+    
+    if (free_index == SIZE_MAX) {
+        if ((ht->used + 1) * 100 > ht->size * LOAD_FACTOR_PERCENTAGE) {
+            ht_resize(ht, next_prime(2 * ht->size));
+            insert(ht, key, value);
+            return;
+        }
+        ht->used++;
+        free_index = index;
+    }
+    
+    ht->buckets[free_index].key = key;
+    ht->buckets[free_index].val = value;
+    ht->count++;
+}
+
+/*
+ * Deleting key - value couple. When delete, leaves a tombstone to not interrupt chain path to other element
+ */
+void delete(hash_table_t* ht, const char* key) {
+    
+    size_t index = hash_slot(ht, key, ascii_value(key));
+    
+    if (ht->buckets[index].key == NULL)
+        return;
+    ht->buckets[index].key = DELETED_KEY;
+    ht->buckets[index].val = DELETED_VALUE;
+    ht->count--;
+}
+
+/*
+ * Search wrapper of the hash table
+ */
+int hash_search(void* s, const char* key) {
+    
+    return search(s, key) != NOT_FOUND_VALUE;
+}
+
+/*
+ * Insert wrapper of the hash table
+ */
+void hash_insert(void* s, const char* key) {
+    
+    insert(s, key, 0);
+}
+
+/*
+ * Delete wrapper of the hash table
+ */
+void hash_delete(void* s, const char* key) {
+    
+    delete(s, key);
+}
+
+/*
+ * Hash table of n keys, grown by insert from INITIAL_HASH_SIZE
+ */
+void* hash_build(char** keys, const size_t n) {
+    
+    size_t i;
+    hash_table_t* ht = malloc(sizeof(hash_table_t));
+    
+    ht->size = INITIAL_HASH_SIZE;
+    ht->count = ht->used = 0;
+    ht->buckets = calloc(ht->size, sizeof(hash_item_t));
+    for (i=0; i<n; i++)
+        insert(ht, keys[i], 0);
+    
+    return ht;
+}
+
+/*
+ * Delete the hash table, names belong to the pool
+ */
+void hash_destroy(void* s) {
+    
+    hash_table_t* ht = s;
+    
+    free(ht->buckets);
+    free(ht);
+}
+
+/*
+ * Time ht_resize of the whole table to the next size, then go back to the previous size untimed. Return ns per key
+ */
+double hash_grow(void* s, char** keys, const size_t n) {
+    
+    hash_table_t* ht = s;
+    const size_t size = ht->size;
+    double start = now_ns();
+    
+    ht_resize(ht, next_prime(2 * size));
+    start = now_ns() - start;
+    ht_resize(ht, size);
+    
+    return start / ht->count;
+}
+
+static const bench_struct_t structs[] = {
+    {"sorted_array", "reallocate", 1, array_build, array_destroy, array_search, ordered_insert, array_delete, array_grow},
+    {"hash_table", "ht_resize", 0, hash_build, hash_destroy, hash_search, hash_insert, hash_delete, hash_grow},
+};
+
+/*
+ * Mix hash with a bucket seed to find its slot, finalizer of splitmix64
+ */
+static inline uint64_t hash_mix(uint64_t h, uint32_t seed) {
+    
+    h ^= (uint64_t)seed * 0x9E3779B97F4A7C15ULL;
+    h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    h = (h ^ (h >> 27)) * 0x94D049BB133111EBULL;
+    
+    return h ^ (h >> 31);
+}
+
+/*
+ * Try to build the perfect hash with the passed number of buckets, as try_relation_hash of the engine.
+ * Buckets are placed from the biggest, searching a seed that sends all their names into free slots.
+ * Return 1 if succeeded, 0 else
+ */
+int mph_try(perfect_hash_t* ph, char** keys, uint64_t* hash, const size_t bucket_count) {
+    
+    size_t i, j, k, b, attempts;
+    size_t free_slots = ph->count;      // slots not taken yet
+    uint32_t seed;
+    size_t* bucket_start;               // first name of each bucket in order array
+    size_t* order;                      // names grouped by bucket
+    size_t* by_size;                    // buckets sorted by size, biggest first
+    size_t* slot_of;                    // slot tried for each name of the current bucket
+    char* taken;                        // slot already used
+    int found = 1;
+    
+    ph->buckets = bucket_count;
+    ph->seed = realloc(ph->seed, bucket_count * sizeof(uint32_t));
+    ph->slot = realloc(ph->slot, ph->count * sizeof(char*));
+    
+    // group names by bucket with a counting sort
+    bucket_start = calloc(bucket_count + 1, sizeof(size_t));
+    order = malloc(ph->count * sizeof(size_t));
+    for (i=0; i<ph->count; i++)
+        bucket_start[hash[i] % bucket_count + 1]++;
+    for (b=0; b<bucket_count; b++)
+        bucket_start[b+1] += bucket_start[b];
+    slot_of = calloc(bucket_count, sizeof(size_t));         // used as fill counter while grouping
+    for (i=0; i<ph->count; i++) {
+        b = hash[i] % bucket_count;
+        order[bucket_start[b] + slot_of[b]++] = i;
+    }
+    
+    // sort buckets by size, biggest first, with a counting sort on the size
+    by_size = malloc(bucket_count * sizeof(size_t));
+    taken = calloc(ph->count + 2, sizeof(char));
+    slot_of = realloc(slot_of, (ph->count + 2) * sizeof(size_t));
+    memset(slot_of, 0, (ph->count + 2) * sizeof(size_t));
+    for (b=0; b<bucket_count; b++)
+        slot_of[ph->count - (bucket_start[b+1] - bucket_start[b]) + 1]++;
+    for (k=0; k<=ph->count; k++)
+        slot_of[k+1] += slot_of[k];
+    for (b=0; b<bucket_count; b++)
+        by_size[slot_of[ph->count - (bucket_start[b+1] - bucket_start[b])]++] = b;
+    
+    for (i=0; i<bucket_count && found; i++) {
+        b = by_size[i];
+        ph->seed[b] = 0;
+    
+        // a name lands on a free slot once every count / free_slots seeds, last buckets need about count
+        attempts = (size_t)HASH_MAX_ATTEMPT * (ph->count / (free_slots + 1) + 1);
+        if (attempts > UINT32_MAX)
+            attempts = UINT32_MAX;
+        for (seed=0, found=0; seed<attempts && !found; seed++) {             // find a seed with no collision
+            found = 1;
+            for (j=bucket_start[b]; j<bucket_start[b+1] && found; j++) {
+                slot_of[j] = hash_mix(hash[order[j]], seed) % ph->count;
+                if (taken[slot_of[j]])
+                    found = 0;
+                for (k=bucket_start[b]; k<j && found; k++)          // collision inside the same bucket
+                    if (slot_of[k] == slot_of[j])
+                        found = 0;
+            }
+            if (found) {                                            // take the slots
+                ph->seed[b] = seed;
+                for (j=bucket_start[b]; j<bucket_start[b+1]; j++) {
+                    taken[slot_of[j]] = 1;
+                    ph->slot[slot_of[j]] = keys[order[j]];
+                }
+                free_slots -= bucket_start[b+1] - bucket_start[b];
+            }
+        }
+    }
+    
+    free(bucket_start);
+    free(order);
+    free(by_size);
+    free(slot_of);
+    free(taken);
+    
+    return found;
+}
+
+/*
+ * Rebuild the perfect hash over n names as build_relation_hash of the engine: hash every name once,
+ * then double the buckets until a seed is found for each of them
+ */
+void mph_build(perfect_hash_t* ph, char** keys, const size_t n) {
+    
+    size_t i, bucket_count;
+    uint64_t* hash = malloc(n * sizeof(uint64_t));
+    
+    ph->count = n;
+    ph->valid = 0;
+    for (i=0; i<n; i++)
+        hash[i] = ascii_value(keys[i]);
+    for (bucket_count = n / HASH_BUCKET_LOAD + 1; !ph->valid && bucket_count <= n << 2; bucket_count <<= 1)
+        ph->valid = mph_try(ph, keys, hash, bucket_count);
+    
+    free(hash);
+}
+
+/*
+ * Fill a name of exactly len characters: random characters first, so that names differ early as real ones do,
+ * then the id in base 62 so that every name is distinct
+ */
+void make_name(char* dst, const int len, size_t id, unsigned* seed) {
+    
+    static const char digits[] = "0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ";
+    int i;
+    
+    for (i=len-1; i>=0 && (i>=len-6 || id>0); i--, id/=62)  // at least 6 id characters, 62^6 names
+        dst[i] = digits[id % 62];
+    for (; i>=0; i--)
+        dst[i] = digits[rand_r(seed) % 62];
+    dst[len] = '\0';
+}
+
+/*
+ * Operations of one pass: hits distinct keys picked by a partial shuffle, misses distinct names never inserted
+ */
+void make_pass(bench_pass_t* pass, char** keys, size_t* perm, const size_t n, char** miss, const int hit_pct, unsigned* seed) {
+    
+    size_t i, j, t;
+    
+    pass->hits = pass->ops * hit_pct / 100;
+    for (i=0; i<pass->hits; i++) {
+        j = i + (((size_t)rand_r(seed) << 16) ^ rand_r(seed)) % (n - i);
+        t = perm[i];
+        perm[i] = perm[j];
+        perm[j] = t;
+        pass->key[i] = keys[perm[i]];
+    }
+    for (i=pass->hits; i<pass->ops; i++)
+        pass->key[i] = miss[i - pass->hits];
+}
+
+/*
+ * Run one pass of a primitive, 0 search, 1 insert, 2 delete, then put the structure back as it was. Return elapsed ns
+ */
+double run_pass(const bench_struct_t* st, void* s, bench_pass_t* pass, const int prim) {
+    
+    size_t i;
+    volatile int found = 0;
+    double start = now_ns();
+    
+    if (prim == 0)
+        for (i=0; i<pass->ops; i++)
+            found += st->search(s, pass->key[i]);
+    else if (prim == 1)
+        for (i=0; i<pass->ops; i++)
+            st->insert(s, pass->key[i]);
+    else
+        for (i=0; i<pass->ops; i++)
+            st->delete(s, pass->key[i]);
+    start = now_ns() - start;
+    
+    if (prim == 1)                                  // drop inserted misses
+        for (i=pass->hits; i<pass->ops; i++)
+            st->delete(s, pass->key[i]);
+    else if (prim == 2)                             // put deleted hits back
+        for (i=0; i<pass->hits; i++)
+            st->insert(s, pass->key[i]);
+    
+    return start;
+}
+
+/*
+ * Time search, insert and delete of a structure of n keys for each hit ratio, then its resize primitive.
+ * Each case is one warmup run and REPETITIONS timed runs of at least OPS_PER_RUN operations, a csv line each
+ */
+void bench_struct(const bench_struct_t* st, char** keys, char** miss, size_t* perm, const size_t n, const int len, const int reps) {
+    
+    static const char* prim_names[] = {"search", "insert", "delete"};
+    bench_pass_t pass;
+    unsigned seed = 1;
+    size_t h, ops, done = 0;
+    int prim, r;
+    double* ns = malloc(reps * sizeof(double));
+    double t;
+    void* s = st->build(keys, n);
+    
+    pass.key = malloc(OPS_PER_RUN * sizeof(char*));
+    for (prim=0; prim<3; prim++)
+        for (h=0; h<sizeof(hit_pcts)/sizeof(int); h++) {
+            ops = (n < OPS_PER_RUN) ? n : OPS_PER_RUN;         // hits of a pass are distinct keys
+            if (prim > 0 && st->shifts && ops > SHIFT_BUDGET / n)
+                ops = (SHIFT_BUDGET / n > 0) ? SHIFT_BUDGET / n : 1;
+            pass.ops = ops;
+    
+            for (r=-1; r<reps; r++) {                           // run -1 is the warmup
+                t = 0;
+                done = 0;
+                do {
+                    make_pass(&pass, keys, perm, n, miss, hit_pcts[h], &seed);
+                    t += run_pass(st, s, &pass, prim);
+                    done += pass.ops;
+                } while (done < OPS_PER_RUN && !(prim > 0 && st->shifts && pass.ops < n));
+                if (r >= 0)
+                    ns[r] = t / done;
+            }
+            qsort(ns, reps, sizeof(double), double_compare);
+            printf("%s,%s,%zu,%d,%d,%zu,%.1f,%.1f\n", st->name, prim_names[prim], n, len, hit_pcts[h],
+                   done, ns[0], ns[reps/2]);
+            fflush(stdout);
+        }
+    
+    st->grow(s, keys, n);                                       // warmup
+    for (r=0; r<reps; r++)
+        ns[r] = st->grow(s, keys, n);
+    qsort(ns, reps, sizeof(double), double_compare);
+    printf("%s,%s,%zu,%d,,%zu,%.1f,%.1f\n", st->name, st->grow_name, n, len, n, ns[0], ns[reps/2]);
+    fflush(stdout);
+    
+    st->destroy(s);
+    free(pass.key);
+    free(ns);
+}
+
+/*
+ * Time the rebuild of the relation perfect hash over n names, done by the engine each time a relation
+ * is created or removed. One warmup run and reps timed ones, a csv line in ns per name
+ */
+void bench_mph(char** keys, const size_t n, const int len, const int reps) {
+    
+    perfect_hash_t ph = {NULL, NULL, 0, 0, 0};
+    double* ns = malloc(reps * sizeof(double));
+    double start;
+    int r;
+    
+    for (r=-1; r<reps; r++) {                                   // run -1 is the warmup
+        start = now_ns();
+        mph_build(&ph, keys, n);
+        start = now_ns() - start;
+        if (r >= 0)
+            ns[r] = start / n;
+    }
+    if (!ph.valid)
+        fprintf(stderr, "no perfect hash for %zu keys of %d characters\n", n, len);
+    qsort(ns, reps, sizeof(double), double_compare);
+    printf("perfect_hash,rebuild,%zu,%d,,%zu,%.1f,%.1f\n", n, len, n, ns[0], ns[reps/2]);
+    fflush(stdout);
+    
+    free(ph.seed);
+    free(ph.slot);
+    free(ns);
+}
+
+/*
+ * Time relation churn in the relation table of the engine: create n relations with one edge each, then toggle
+ * one more relation by deleting and adding its only edge, then remove the n relations. Each run starts from
+ * a new monitor, one warmup run and reps timed ones, a csv line in ns per operation for each primitive
+ */
+void bench_churn(char** keys, const size_t n, const int len, const int reps) {
+    
+    static const char* churn_names[] = {"create", "toggle", "remove"};
+    const size_t ops[] = {n, CHURN_TOGGLES << 1, n};
+    double* ns = malloc(3 * reps * sizeof(double));
+    double start;
+    size_t i;
+    int r, prim;
+    t_monitor* monitor;
+    
+    for (r=-1; r<reps; r++) {                                   // run -1 is the warmup
+        monitor = monitor_create(NULL);
+        monitor_add_entity(monitor, "orig");
+        monitor_add_entity(monitor, "dest");
+        
+        start = now_ns();
+        for (i=0; i<n; i++)
+            monitor_add_rel(monitor, "orig", "dest", keys[i]);
+        if (r >= 0)
+            ns[r] = (now_ns() - start) / ops[0];
+        
+        start = now_ns();
+        for (i=0; i<CHURN_TOGGLES; i++) {                       // last removal of an edge drops the relation
+            monitor_add_rel(monitor, "orig", "dest", keys[n]);
+            monitor_del_rel(monitor, "orig", "dest", keys[n]);
+        }
+        if (r >= 0)
+            ns[reps + r] = (now_ns() - start) / ops[1];
+        
+        start = now_ns();
+        for (i=0; i<n; i++)
+            monitor_del_rel(monitor, "orig", "dest", keys[i]);
+        if (r >= 0)
+            ns[2 * reps + r] = (now_ns() - start) / ops[2];
+        
+        monitor_destroy(monitor);
+    }
+    
+    for (prim=0; prim<3; prim++) {
+        qsort(ns + prim * reps, reps, sizeof(double), double_compare);
+        printf("relation_table,%s,%zu,%d,,%zu,%.1f,%.1f\n", churn_names[prim], n, len, ops[prim], ns[prim * reps], ns[prim * reps + reps/2]);
+    }
+    fflush(stdout);
+    
+    free(ns);
+}
+
+/*
+ * Microbenchmarks of the primitives of the array and hash table prototypes, then of the rebuild of the relation
+ * perfect hash up to 10^MPH_MAX_EXP relations and of relation churn in the engine up to 10^CHURN_MAX_EXP, csv on stdout.
+ * Usage: micro_bench [max_exp [repetitions]], key counts go from 10^2 to 10^max_exp
+ */
+int main(int argc, char** argv) {
+    
+    int max_exp = (argc > 1) ? atoi(argv[1]) : MAX_EXP;
+    int reps = (argc > 2) ? atoi(argv[2]) : REPETITIONS;
+    int e, l, len;
+    size_t i, n, mem;
+    unsigned seed = 1;
+    char* pool;
+    char** keys;
+    size_t* perm;
+    
+    if (max_exp < MIN_EXP || max_exp > 9 || reps < 1) {
+        fprintf(stderr, "usage: %s [max_exp [repetitions]], max_exp from %d to 9\n", argv[0], MIN_EXP);
+        return 1;
+    }
+    
+    printf("structure,primitive,keys,name_len,hit_pct,ops,ns_per_op_min,ns_per_op_median\n");
+    for (e=MIN_EXP, n=100; e<=max_exp; e++, n*=10)
+        for (l=0; l<sizeof(name_lens)/sizeof(int); l++) {
+            len = name_lens[l];
+            mem = (n + OPS_PER_RUN) * (len + 1 + sizeof(char*)) + n * (sizeof(size_t) + 5 * sizeof(hash_item_t));
+            if (mem > MEMORY_LIMIT) {
+                fprintf(stderr, "skipped %zu keys of %d characters, about %zu MB\n", n, len, mem >> 20);
+                continue;
+            }
+    
+            pool = malloc((n + OPS_PER_RUN) * (len + 1));       // keys, then names never inserted
+            keys = malloc((n + OPS_PER_RUN) * sizeof(char*));
+            perm = malloc(n * sizeof(size_t));
+            for (i=0; i<n+OPS_PER_RUN; i++) {
+                keys[i] = pool + i * (len + 1);
+                make_name(keys[i], len, i, &seed);
+            }
+            for (i=0; i<n; i++)
+                perm[i] = i;
+    
+            for (i=0; i<sizeof(structs)/sizeof(bench_struct_t); i++)
+                bench_struct(&structs[i], keys, keys + n, perm, n, len, reps);
+            if (e <= MPH_MAX_EXP)
+                bench_mph(keys, n, len, reps);
+            if (e <= CHURN_MAX_EXP)
+                bench_churn(keys, n, len, reps);                // keys[n] is never inserted, it is the toggled relation
+    
+            free(pool);
+            free(keys);
+            free(perm);
+        }
+    
+    return 0;
+}
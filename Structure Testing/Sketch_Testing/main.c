@@ -0,0 +1,177 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "monitor.h"
+
+#define ENTITY_COUNT 20000              // entities of the workload
+#define RELATION_COUNT 4                // relation types
+#define OP_COUNT 2000000                // addrel and delrel of the workload
+#define REPORT_EVERY 100000             // commands between two reports
+#define DEL_PERCENTAGE 20               // delrel of a relation added before, on total commands
+#define RECENT_SIZE 65536               // added relations a delrel is picked from
+#define SKEW 3.0                        // destinations are picked as ENTITY_COUNT * u^SKEW, low ones receive the most
+#define REPORT_SIZE 65536               // buffer of one report line
+
+/*
+ * Command of the workload, entities and relation by index
+ */
+typedef struct bench_op {
+    int orig;
+    int dest;
+    int rel;
+    int add;                // 1 for addrel, 0 for delrel
+} bench_op_t;
+
+/*
+ * Receivers and count of one relation of a report line
+ */
+typedef struct bench_rel {
+    char* rel;
+    char* first;            // first receiver
+    char* dests;            // every receiver, separated by spaces
+    long count;
+} bench_rel_t;
+
+char names[ENTITY_COUNT][32];
+char rels[RELATION_COUNT][32];
+bench_op_t ops[OP_COUNT];
+
+/*
+ * Build the same workload for every run: skewed destinations, delrel of recently added relations
+ */
+void build_workload() {
+    
+    int i, j, recent_count = 0;
+    bench_op_t recent[RECENT_SIZE];
+    unsigned seed = 1;
+    
+    for (i=0; i<OP_COUNT; i++) {
+        if (recent_count > 0 && rand_r(&seed) % 100 < DEL_PERCENTAGE) {
+            j = rand_r(&seed) % recent_count;
+            ops[i] = recent[j];
+            ops[i].add = 0;
+            recent[j] = recent[--recent_count];
+            continue;
+        }
+        ops[i].orig = rand_r(&seed) % ENTITY_COUNT;
+        ops[i].dest = (int)(ENTITY_COUNT * pow((double)rand_r(&seed) / RAND_MAX, SKEW)) % ENTITY_COUNT;
+        ops[i].rel = rand_r(&seed) % RELATION_COUNT;
+        ops[i].add = 1;
+        if (recent_count < RECENT_SIZE)
+            recent[recent_count++] = ops[i];
+        else
+            recent[rand_r(&seed) % RECENT_SIZE] = ops[i];
+    }
+}
+
+/*
+ * Split a report line in place into its relations. Return their number
+ */
+int parse_report(char* line, bench_rel_t* out, const int size) {
+    
+    int n = 0;
+    char *seg, *next, *last;
+    
+    for (seg=line; n<size && (next = strstr(seg, "; ")) != NULL; seg=next+2) {
+        *next = '\0';
+        last = strrchr(seg, ' ');
+        *last = '\0';
+        out[n].count = atol(last + 1);
+        out[n].rel = seg;
+        out[n].dests = strchr(seg, ' ') + 1;
+        *(out[n].dests - 1) = '\0';
+        out[n].first = out[n].dests;
+        n++;
+    }
+    
+    return n;
+}
+
+/*
+ * Run the workload on a monitor, exact one if eps is 0, keeping every report line. Return commands per second
+ */
+double run(const double eps, char reports[][REPORT_SIZE]) {
+    
+    t_monitor_config config;
+    t_monitor* monitor;
+    struct timespec start, end;
+    int i, report = 0;
+    
+    monitor_default_config(&config);
+    config.ent_dict = MONITOR_DICT_HASH;            // so that entity lookups do not hide the relation engines
+    config.sketch_eps = eps;
+    monitor = monitor_create(&config);
+    
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i=0; i<ENTITY_COUNT; i++)
+        monitor_add_entity(monitor, names[i]);
+    for (i=0; i<OP_COUNT; i++) {
+        if (ops[i].add)
+            monitor_add_rel(monitor, names[ops[i].orig], names[ops[i].dest], rels[ops[i].rel]);
+        else
+            monitor_del_rel(monitor, names[ops[i].orig], names[ops[i].dest], rels[ops[i].rel]);
+        if ((i + 1) % REPORT_EVERY == 0)
+            monitor_report(monitor, reports[report++], REPORT_SIZE);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    
+    monitor_destroy(monitor);
+    return (ENTITY_COUNT + OP_COUNT) / ((end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9);
+}
+
+/*
+ * Compare approximate reports with exact ones and print the csv columns of accuracy:
+ * average and max relative error of the reported count, share of reports whose first receiver is a true one
+ */
+void compare(char approx[][REPORT_SIZE], char exact[][REPORT_SIZE]) {
+    
+    static char line[REPORT_SIZE];
+    bench_rel_t got[RELATION_COUNT], want[RELATION_COUNT];
+    double err, max_err = 0, sum_err = 0;
+    int i, j, n, m, hits = 0, compared = 0;
+    char first[40];
+    
+    for (i=0; i<OP_COUNT/REPORT_EVERY; i++) {
+        n = parse_report(approx[i], got, RELATION_COUNT);
+        strcpy(line, exact[i]);                     // exact reports are parsed again for each eps
+        m = parse_report(line, want, RELATION_COUNT);
+        for (j=0; j<n && j<m && strcmp(got[j].rel, want[j].rel)==0; j++) {
+            err = fabs((double)(got[j].count - want[j].count)) / want[j].count;
+            sum_err += err;
+            if (err > max_err)
+                max_err = err;
+            sscanf(got[j].first, "%39s", first);
+            hits += strstr(want[j].dests, first) != NULL;
+            compared++;
+        }
+    }
+    
+    printf(",%.4f,%.4f,%.3f", compared ? sum_err / compared : 0.0, max_err, compared ? (double)hits / compared : 0.0);
+}
+
+int main(int argc, char** argv) {
+    
+    int i;
+    double eps[] = {0.1, 0.01, 0.001};
+    static char exact[OP_COUNT / REPORT_EVERY][REPORT_SIZE];
+    static char approx[OP_COUNT / REPORT_EVERY][REPORT_SIZE];
+    
+    for (i=0; i<ENTITY_COUNT; i++)
+        snprintf(names[i], sizeof(names[i]), "\"entity_%d\"", i);
+    for (i=0; i<RELATION_COUNT; i++)
+        snprintf(rels[i], sizeof(rels[i]), "\"rel_%d\"", i);
+    build_workload();
+    
+    printf("mode,eps,ops_per_sec,avg_rel_count_error,max_rel_count_error,top_receiver_hit_rate\n");
+    printf("exact,0,%.0f,0,0,1\n", run(0, exact));
+    for (i=0; i<sizeof(eps)/sizeof(eps[0]); i++) {
+        printf("sketch,%g,%.0f", eps[i], run(eps[i], approx));
+        compare(approx, exact);
+        printf("\n");
+    }
+    
+    return 0;
+}
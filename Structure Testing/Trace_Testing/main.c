@@ -0,0 +1,114 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#define ENTITY_COUNT 2000               // entities of the trace, by default
+#define RELATION_COUNT 5                // relation types, by default
+#define ADDENT_PERCENTAGE 8             // addent on total commands
+#define ADDREL_PERCENTAGE 55            // addrel on total commands
+#define DELREL_PERCENTAGE 30            // delrel on total commands
+#define DELENT_PERCENTAGE 2             // delent on total commands, the rest are reports
+#define RECENT_SIZE 4096                // added relations a delrel is picked from
+
+static const char* first[] = {"Jean_Luc", "William", "Beverly", "Deanna", "Geordi", "Worf", "Kathryn", "Seven",
+                              "Benjamin", "Kira", "Julian", "Jadzia", "Michael", "Saru", "Sylvia", "Hugh"};
+static const char* rels[] = {"parent", "friend", "mentor", "rival", "crew", "sibling", "commander", "ally"};
+
+/*
+ * A relation, entities and type by index
+ */
+typedef struct trace_rel {
+    int orig;
+    int dest;
+    int rel;
+} trace_rel_t;
+
+/*
+ * Print the name of entity i, a first name and a number so that names sort apart from the order of creation
+ */
+void print_name(const int i) {
+    printf("\"%s_%d\"", first[i % (sizeof(first)/sizeof(char*))], i);
+}
+
+/*
+ * Random number in [0, n), destinations skewed towards low indexes when skew is set
+ */
+int pick(const int n, const int skew, unsigned* seed) {
+    
+    double u = rand_r(seed) / ((double)RAND_MAX + 1);
+    
+    return (int)(n * (skew ? u * u * u : u));
+}
+
+/*
+ * Random text trace of monitor commands on stdout, with the command mix of the public tests plus some delent.
+ * Usage: trace_gen seed commands [entities [relation types]]
+ */
+int main(int argc, char** argv) {
+    
+    unsigned seed;
+    long commands, i;
+    int entities = ENTITY_COUNT, relations = RELATION_COUNT, choice, e;
+    trace_rel_t recent[RECENT_SIZE];
+    trace_rel_t r;
+    int recent_count = 0;
+    
+    if (argc < 3) {
+        fprintf(stderr, "usage: %s seed commands [entities [relation types]]\n", argv[0]);
+        return 1;
+    }
+    seed = atoi(argv[1]);
+    commands = atol(argv[2]);
+    if (argc > 3)
+        entities = atoi(argv[3]);
+    if (argc > 4)
+        relations = atoi(argv[4]);
+    if (commands < 1 || entities < 1 || relations < 1 || relations > sizeof(rels)/sizeof(char*)) {
+        fprintf(stderr, "invalid size, at most %zu relation types\n", sizeof(rels)/sizeof(char*));
+        return 1;
+    }
+    
+    for (e=0; e<entities && e<commands; e++) {      // most entities exist before the first relation
+        printf("addent ");
+        print_name(e);
+        printf("\n");
+    }
+    
+    for (i=e; i<commands; i++) {
+        choice = rand_r(&seed) % 100;
+    
+        if (choice < ADDENT_PERCENTAGE) {
+            printf("addent ");
+            print_name(pick(entities, 0, &seed));
+        }
+        else if (choice < ADDENT_PERCENTAGE + ADDREL_PERCENTAGE) {
+            r.orig = pick(entities, 0, &seed);
+            r.dest = pick(entities, 1, &seed);
+            r.rel = pick(relations, 1, &seed);
+            recent[recent_count++ % RECENT_SIZE] = r;
+            printf("addrel ");
+            print_name(r.orig);
+            printf(" ");
+            print_name(r.dest);
+            printf(" \"%s\"", rels[r.rel]);
+        }
+        else if (choice < ADDENT_PERCENTAGE + ADDREL_PERCENTAGE + DELREL_PERCENTAGE) {
+            if (recent_count > 0)                   // mostly relations that exist
+                r = recent[rand_r(&seed) % (recent_count < RECENT_SIZE ? recent_count : RECENT_SIZE)];
+            printf("delrel ");
+            print_name(recent_count > 0 ? r.orig : pick(entities, 0, &seed));
+            printf(" ");
+            print_name(recent_count > 0 ? r.dest : pick(entities, 1, &seed));
+            printf(" \"%s\"", rels[recent_count > 0 ? r.rel : 0]);
+        }
+        else if (choice < ADDENT_PERCENTAGE + ADDREL_PERCENTAGE + DELREL_PERCENTAGE + DELENT_PERCENTAGE) {
+            printf("delent ");
+            print_name(pick(entities, 1, &seed));
+        }
+        else
+            printf("report");
+        printf("\n");
+    }
+    printf("end\n");
+    
+    return 0;
+}
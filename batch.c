@@ -0,0 +1,449 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "batch.h"
+
+// DEFINES
+
+#define CACHE_LINE_SIZE 64                      // alignment of workers, their deque ends are hit by thieves
+#define INPUT_ARRAY_SIZE 64                     // initial length of the inputs list
+
+// END OF DEFINES
+
+// One input of the batch and how it went
+typedef struct batch_job {
+
+    const char* input;                  // path of the input
+    off_t size;                         // bytes of the input, larger ones are started first
+    double seconds;                     // time to run it, output included
+    int worker;                         // worker that ran it
+    int stolen;                         // 1 if it was taken from another worker
+    int failed;                         // 1 if input or output could not be opened
+
+} t_batch_job;
+
+struct batch_pool;
+
+// Worker thread with its own deque of jobs. The owner takes from the bottom, thieves from the top
+typedef struct batch_worker {
+
+    atomic_long top;                    // next job a thief takes
+    atomic_long bottom;                 // one past next job the owner takes
+    int* deque;                         // jobs of this worker by increasing size, largest at the bottom
+    int id;                             // index among workers
+    unsigned seed;                      // choice of the first victim
+    pthread_t thread;                   // worker thread
+    struct batch_pool* pool;            // pool the worker belongs to
+
+} __attribute__((aligned(CACHE_LINE_SIZE))) t_batch_worker;
+
+// Workers and jobs of one batch
+typedef struct batch_pool {
+
+    const t_monitor_config* config;     // configuration of every monitor
+    const char* out_dir;                // directory of outputs
+    t_batch_job* jobs;                  // every job, in input order
+    t_batch_worker* workers;            // every worker
+    int threads;                        // number of workers
+
+} t_batch_pool;
+
+// FUNCTION PROTOTYPES
+
+// Worker thread, runs its own jobs then steals until every deque is empty
+static void* worker_main(void* arg);
+
+// Take the next job from the bottom of own deque. Return -1 if empty
+static int take_job(t_batch_worker* worker);
+
+// Take a job from the top of another worker deque. Return -1 if every deque is empty
+static int steal_job(t_batch_worker* thief);
+
+// Run one input through a fresh monitor
+static void run_job(t_batch_pool* pool, t_batch_job* job);
+
+// Deal jobs to workers by decreasing size, round robin
+static void deal_jobs(t_batch_pool* pool, const int count);
+
+// Compare jobs by decreasing size, for qsort of job pointers
+static int compare_job_size(const void* a, const void* b);
+
+// Compare strings, for qsort of paths
+static int compare_path(const void* a, const void* b);
+
+// Compare last components of paths, then whole paths, for qsort of paths
+static int compare_base_name(const void* a, const void* b);
+
+// Report inputs whose outputs would go to the same file. Return the number of clashes
+static int check_out_names(char** inputs, const int count, const char* out_dir);
+
+// Last component of a path
+static const char* base_name(const char* path);
+
+// END OF FUNCTION PROTOTYPES
+
+/*
+ * Run the batch. Jobs are dealt largest first so every worker starts on its biggest inputs,
+ * workers left without jobs steal the smallest ones still waiting
+ */
+int monitor_batch(const t_monitor_config* config, char** inputs, const int count, const char* out_dir,
+                  int threads, FILE* timing) {
+    
+    int i, failed = 0, stolen = 0;
+    double work = 0;
+    struct timespec start, end;
+    t_batch_pool pool;
+    
+    if (check_out_names(inputs, count, out_dir) > 0) {     // two workers would write the same file at once
+        fprintf(stderr, "batch: inputs with the same name, nothing run\n");
+        return count;
+    }
+    if (mkdir(out_dir, 0777) < 0 && errno != EEXIST) {
+        perror(out_dir);
+        return count;
+    }
+    
+    if (threads < 1)
+        threads = sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads > count)
+        threads = count > 0 ? count : 1;
+    
+    pool.config = config;
+    pool.out_dir = out_dir;
+    pool.threads = threads;
+    pool.jobs = calloc(count > 0 ? count : 1, sizeof(t_batch_job));
+    pool.workers = aligned_alloc(CACHE_LINE_SIZE, threads * sizeof(t_batch_worker));
+    for (i=0; i<count; i++)
+        pool.jobs[i].input = inputs[i];
+    deal_jobs(&pool, count);
+    
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i=0; i<threads; i++)
+        pthread_create(&pool.workers[i].thread, NULL, worker_main, &pool.workers[i]);
+    for (i=0; i<threads; i++)
+        pthread_join(pool.workers[i].thread, NULL);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    
+    fprintf(timing, "input,bytes,worker,stolen,seconds\n");
+    for (i=0; i<count; i++) {
+        if (pool.jobs[i].failed) {
+            fprintf(timing, "%s,%lld,%d,%d,failed\n", pool.jobs[i].input, (long long)pool.jobs[i].size,
+                    pool.jobs[i].worker, pool.jobs[i].stolen);
+            failed++;
+            continue;
+        }
+        fprintf(timing, "%s,%lld,%d,%d,%.6f\n", pool.jobs[i].input, (long long)pool.jobs[i].size,
+                pool.jobs[i].worker, pool.jobs[i].stolen, pool.jobs[i].seconds);
+        work += pool.jobs[i].seconds;
+        stolen += pool.jobs[i].stolen;
+    }
+    fprintf(stderr, "batch: %d inputs on %d threads, %.3f s wall, %.3f s of work, %d stolen, %d failed\n",
+            count, threads, (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9, work, stolen, failed);
+    
+    for (i=0; i<threads; i++)
+        free(pool.workers[i].deque);
+    free(pool.workers);
+    free(pool.jobs);
+    
+    return failed;
+}
+
+/*
+ * Sort jobs by decreasing size and deal them round robin. Each deque keeps its jobs by increasing size,
+ * so the owner takes its largest first from the bottom and thieves take smallest ones from the top
+ */
+static void deal_jobs(t_batch_pool* pool, const int count) {
+    
+    int i, w, n;
+    t_batch_job** order = malloc((count > 0 ? count : 1) * sizeof(t_batch_job*));
+    struct stat st;
+    t_batch_worker* worker;
+    
+    for (i=0; i<count; i++) {
+        pool->jobs[i].size = stat(pool->jobs[i].input, &st) == 0 ? st.st_size : 0;
+        order[i] = &pool->jobs[i];
+    }
+    qsort(order, count, sizeof(t_batch_job*), compare_job_size);
+    
+    for (w=0; w<pool->threads; w++) {
+        worker = &pool->workers[w];
+        n = (count - w + pool->threads - 1) / pool->threads;   // jobs w, w + threads, ...
+        worker->deque = malloc((n > 0 ? n : 1) * sizeof(int));
+        for (i=0; i<n; i++)
+            worker->deque[n - 1 - i] = order[w + i * pool->threads] - pool->jobs;
+        atomic_init(&worker->top, 0);
+        atomic_init(&worker->bottom, n);
+        worker->id = w;
+        worker->seed = w + 1;
+        worker->pool = pool;
+    }
+    
+    free(order);
+}
+
+/*
+ * Worker thread. Jobs are never added once started, so when a steal finds every deque empty the batch is over
+ */
+static void* worker_main(void* arg) {
+    
+    t_batch_worker* self = arg;
+    int job, stolen;
+    
+    for (;;) {
+        stolen = 0;
+        if ((job = take_job(self)) < 0) {
+            if ((job = steal_job(self)) < 0)
+                break;
+            stolen = 1;
+        }
+        self->pool->jobs[job].worker = self->id;
+        self->pool->jobs[job].stolen = stolen;
+        run_job(self->pool, &self->pool->jobs[job]);
+    }
+    
+    return NULL;
+}
+
+/*
+ * Pop from the bottom of own deque. Only the last job can race with a thief, the top decides who gets it
+ */
+static int take_job(t_batch_worker* worker) {
+    
+    long t, b;
+    int job = -1;
+    
+    b = atomic_load(&worker->bottom) - 1;
+    atomic_store(&worker->bottom, b);               // claim the bottom before looking at the top
+    t = atomic_load(&worker->top);
+    
+    if (t < b)                                      // more than one left, no thief can reach it
+        return worker->deque[b];
+    
+    if (t == b && atomic_compare_exchange_strong(&worker->top, &t, t + 1))
+        job = worker->deque[b];
+    atomic_store(&worker->bottom, b + 1);           // deque is empty either way, top is b + 1
+    
+    return job;
+}
+
+/*
+ * Steal from the top of other deques, starting from a random victim. A failed exchange means another thief
+ * or the owner took that job, the same deque is tried again
+ */
+static int steal_job(t_batch_worker* thief) {
+    
+    int i, threads = thief->pool->threads;
+    long t, b;
+    t_batch_worker* victim;
+    
+    for (i=0; i<threads; i++) {
+        victim = &thief->pool->workers[(rand_r(&thief->seed) + i) % threads];
+        if (victim == thief)
+            continue;
+    
+        t = atomic_load(&victim->top);
+        b = atomic_load(&victim->bottom);
+        while (t < b) {
+            if (atomic_compare_exchange_strong(&victim->top, &t, t + 1))
+                return victim->deque[t];
+            b = atomic_load(&victim->bottom);       // t was reloaded by the failed exchange
+        }
+    }
+    
+    return -1;
+}
+
+/*
+ * Run an input through its own monitor, output to the file of same name in output directory
+ */
+static void run_job(t_batch_pool* pool, t_batch_job* job) {
+    
+    char path[BATCH_PATH_SIZE];
+    struct timespec start, end;
+    struct stat in_st, out_st;
+    t_monitor* monitor;
+    FILE* in;
+    FILE* out;
+    
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    snprintf(path, BATCH_PATH_SIZE, "%s/%s", pool->out_dir, base_name(job->input));
+    
+    if ((in = fopen(job->input, "r")) == NULL) {
+        perror(job->input);
+        job->failed = 1;
+        return;
+    }
+    if (stat(path, &out_st) == 0 && fstat(fileno(in), &in_st) == 0 &&
+        in_st.st_dev == out_st.st_dev && in_st.st_ino == out_st.st_ino) {
+        fprintf(stderr, "%s: output would overwrite its input\n", job->input);
+        fclose(in);
+        job->failed = 1;
+        return;
+    }
+    if ((out = fopen(path, "w")) == NULL) {
+        perror(path);
+        fclose(in);
+        job->failed = 1;
+        return;
+    }
+    
+    monitor = monitor_create(pool->config);
+    monitor_execute(monitor, in, out);
+    monitor_destroy(monitor);
+    
+    fclose(in);
+    if (fclose(out) != 0) {
+        perror(path);
+        job->failed = 1;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    job->seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+/*
+ * List inputs from a directory or from a file with one path per line
+ */
+char** monitor_batch_inputs(const char* path, int* count) {
+    
+    int size = INPUT_ARRAY_SIZE;
+    char** inputs;
+    char line[BATCH_PATH_SIZE];
+    struct stat st;
+    struct dirent* entry;
+    DIR* dir;
+    FILE* list;
+    
+    *count = 0;
+    if (stat(path, &st) < 0) {
+        perror(path);
+        return NULL;
+    }
+    inputs = malloc(size * sizeof(char*));
+    
+    if (S_ISDIR(st.st_mode)) {
+        if ((dir = opendir(path)) == NULL) {
+            perror(path);
+            free(inputs);
+            return NULL;
+        }
+        while ((entry = readdir(dir)) != NULL) {
+            if (entry->d_name[0] == '.')                    // hidden files, current and parent directory
+                continue;
+            snprintf(line, BATCH_PATH_SIZE, "%s/%s", path, entry->d_name);
+            if (stat(line, &st) < 0 || !S_ISREG(st.st_mode))
+                continue;
+            if (*count == size) {                           // double size if full
+                size = size << 1;
+                inputs = realloc(inputs, size * sizeof(char*));
+            }
+            inputs[(*count)++] = strdup(line);
+        }
+        closedir(dir);
+        qsort(inputs, *count, sizeof(char*), compare_path);
+        return inputs;
+    }
+    
+    if ((list = fopen(path, "r")) == NULL) {
+        perror(path);
+        free(inputs);
+        return NULL;
+    }
+    while (fgets(line, BATCH_PATH_SIZE, list)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '\0')
+            continue;
+        if (*count == size) {                               // double size if full
+            size = size << 1;
+            inputs = realloc(inputs, size * sizeof(char*));
+        }
+        inputs[(*count)++] = strdup(line);
+    }
+    fclose(list);
+    
+    return inputs;
+}
+
+/*
+ * Free every path and the list
+ */
+void monitor_batch_free_inputs(char** inputs, const int count) {
+    
+    int i;
+    
+    for (i=0; i<count; i++)
+        free(inputs[i]);
+    free(inputs);
+}
+
+/*
+ * Larger jobs first, input order among same size
+ */
+static int compare_job_size(const void* a, const void* b) {
+    
+    const t_batch_job* x = *(t_batch_job* const*)a;
+    const t_batch_job* y = *(t_batch_job* const*)b;
+    
+    if (x->size != y->size)
+        return x->size < y->size ? 1 : -1;
+    return x < y ? -1 : x > y;
+}
+
+/*
+ * Order of two paths
+ */
+static int compare_path(const void* a, const void* b) {
+    
+    return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+/*
+ * Order of two paths by last component, whole paths among same one
+ */
+static int compare_base_name(const void* a, const void* b) {
+    
+    const char* x = *(char* const*)a;
+    const char* y = *(char* const*)b;
+    int c = strcmp(base_name(x), base_name(y));
+    
+    return c != 0 ? c : strcmp(x, y);
+}
+
+/*
+ * Sort a copy of the inputs by last component, inputs with the same one are neighbours then
+ */
+static int check_out_names(char** inputs, const int count, const char* out_dir) {
+    
+    int i, clashes = 0;
+    char** sorted = malloc((count > 0 ? count : 1) * sizeof(char*));
+    
+    memcpy(sorted, inputs, count * sizeof(char*));
+    qsort(sorted, count, sizeof(char*), compare_base_name);
+    for (i=1; i<count; i++)
+        if (strcmp(base_name(sorted[i-1]), base_name(sorted[i])) == 0) {
+            fprintf(stderr, "%s and %s: both would be written to %s/%s\n", sorted[i-1], sorted[i],
+                    out_dir, base_name(sorted[i]));
+            clashes++;
+        }
+    free(sorted);
+    
+    return clashes;
+}
+
+/*
+ * Part of the path after last slash
+ */
+static const char* base_name(const char* path) {
+    
+    const char* slash = strrchr(path, '/');
+    
+    return slash != NULL ? slash + 1 : path;
+}
@@ -0,0 +1,32 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdio.h>
+
+#include "monitor.h"
+
+// DEFINES
+
+#define BATCH_PATH_SIZE 4096                    // max length of an input or output path
+
+// END OF DEFINES
+
+// FUNCTION PROTOTYPES
+
+// List the inputs of a batch: every regular file of path if it is a directory, sorted by name,
+// else every non empty line of path. Return NULL if path cannot be read, count is set to their number
+char** monitor_batch_inputs(const char* path, int* count);
+
+// Free a list of inputs
+void monitor_batch_free_inputs(char** inputs, const int count);
+
+// Run each input through its own monitor built with config, on threads workers stealing inputs from each other.
+// Output of an input goes to the file of same name in out_dir, created if missing. Timing of each input is
+// printed as csv on timing, in input order. Return the number of inputs that could not be processed,
+// all of them if two inputs share their name, nothing is run then
+int monitor_batch(const t_monitor_config* config, char** inputs, const int count, const char* out_dir,
+                  int threads, FILE* timing);
+
+// END OF FUNCTION PROTOTYPES
+
+#endif
@@ -0,0 +1,510 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "intern.h"
+
+#define CACHE_LINE_SIZE 64              // alignment of per thread records
+
+// Block whose release waits until no thread can be reading it
+typedef struct intern_retired {
+
+    void* ptr;                          // block to free
+    struct intern_retired* next;        // next block retired in the same epoch
+
+} t_intern_retired;
+
+// Interned name, hash is kept before the characters so that probing compares strings only on a match.
+// Length sits right before the characters, as for every name stored by the monitor
+typedef struct intern_name {
+
+    uint64_t hash;                      // hash of the name
+    uint32_t reserved;                  // 0
+    uint32_t len;                       // number of characters
+    char name[];                        // characters, terminated
+
+} t_intern_name;
+
+// Array of slots, replaced as a whole by a resize
+typedef struct intern_array {
+
+    size_t size;                        // number of slots, power of 2
+    _Atomic uintptr_t slot[];           // name pointer, SLOT_DELETED or 0 if empty, SLOT_FROZEN bit set while copied
+
+} t_intern_array;
+
+// Epoch record of one thread
+struct intern_thread {
+
+    _Atomic int used;                   // 1 if a thread owns this record
+    _Atomic uint64_t active;            // epoch seen when current operation started, 0 outside operations
+    t_intern_retired* limbo[3];         // retired blocks by epoch modulo 3
+    uint64_t limbo_epoch;               // epoch of last retired block
+    size_t retired;                     // retired blocks since last try to advance the epoch
+
+} __attribute__((aligned(CACHE_LINE_SIZE)));
+
+struct intern_table {
+
+    _Atomic(t_intern_array*) array;     // current array of slots
+    _Atomic size_t used;                // slots taken, deleted ones included
+    _Atomic size_t count;               // names in the table
+    pthread_mutex_t resize_lock;        // one resize at a time, writers finding frozen slots wait on it
+
+    _Atomic uint64_t epoch;             // global epoch, starts from 1
+    t_intern_thread thread[INTERN_MAX_THREADS];     // epoch record of each thread
+
+};
+
+// DEFINES
+
+#define SLOT_FROZEN 1                           // low bit of a slot being copied by a resize, writers wait for new array
+#define SLOT_DELETED 2                          // value of a slot whose name was deleted, skipped and never reused
+
+#define RETIRE_THRESHOLD 64                     // retired blocks of a thread before trying to advance the epoch
+
+// END OF DEFINES
+
+// FUNCTION PROTOTYPES
+
+// Hash a name with FNV-1a and a final mix, low bits are used as slot
+static inline uint64_t hash_name(const char* s);
+
+// Find header of an interned name
+static inline t_intern_name* name_header(uintptr_t key);
+
+// Allocate an empty array of slots
+static t_intern_array* new_array(const size_t size);
+
+// Mark calling thread as reading the table
+static inline void epoch_enter(t_intern_table* table, t_intern_thread* self);
+
+// Mark calling thread as out of the table
+static inline void epoch_exit(t_intern_thread* self);
+
+// Hand a block to epoch based reclamation
+static void retire(t_intern_table* table, t_intern_thread* self, void* ptr);
+
+// Free a list of retired blocks
+static void free_retired(t_intern_retired* list);
+
+// Move global epoch forward if every active thread already saw it
+static void try_advance(t_intern_table* table);
+
+// Replace passed array with a new one holding only the live names
+static void resize(t_intern_table* table, t_intern_thread* self, t_intern_array* arr);
+
+// Wait until a resize of passed array is published
+static void wait_resize(t_intern_table* table, t_intern_array* arr);
+
+// END OF FUNCTION PROTOTYPES
+
+/*
+ * Create an empty table
+ */
+t_intern_table* intern_create() {
+    
+    t_intern_table* table = aligned_alloc(CACHE_LINE_SIZE, (sizeof(t_intern_table) + CACHE_LINE_SIZE - 1) & ~(size_t)(CACHE_LINE_SIZE - 1));
+    
+    memset(table, 0, sizeof(t_intern_table));
+    atomic_init(&table->array, new_array(INTERN_INITIAL_SIZE));
+    atomic_init(&table->epoch, 1);
+    pthread_mutex_init(&table->resize_lock, NULL);
+    
+    return table;
+}
+
+/*
+ * Free the table and every name inside, no thread may be using it
+ */
+void intern_destroy(t_intern_table* table) {
+    
+    int i, j;
+    size_t k;
+    uintptr_t key;
+    t_intern_array* arr = atomic_load(&table->array);
+    
+    for (k=0; k<arr->size; k++) {                               // free live names
+        key = atomic_load(&arr->slot[k]) & ~(uintptr_t)SLOT_FROZEN;
+        if (key != 0 && key != SLOT_DELETED)
+            free(name_header(key));
+    }
+    free(arr);
+    
+    for (i=0; i<INTERN_MAX_THREADS; i++)                        // free deleted names and old arrays
+        for (j=0; j<3; j++)
+            free_retired(table->thread[i].limbo[j]);
+    
+    pthread_mutex_destroy(&table->resize_lock);
+    free(table);
+}
+
+/*
+ * Register calling thread. Return NULL if INTERN_MAX_THREADS threads are already registered
+ */
+t_intern_thread* intern_join(t_intern_table* table) {
+    
+    int i, expected;
+    
+    for (i=0; i<INTERN_MAX_THREADS; i++) {
+        expected = 0;
+        if (atomic_compare_exchange_strong(&table->thread[i].used, &expected, 1))
+            return &table->thread[i];
+    }
+    
+    return NULL;
+}
+
+/*
+ * Unregister a thread. Its retired blocks stay with the record and are freed by the next owner or at destroy
+ */
+void intern_leave(t_intern_table* table, t_intern_thread* self) {
+    
+    atomic_store(&self->active, 0);
+    atomic_store(&self->used, 0);
+}
+
+/*
+ * Search a name. Wait-free: at most one pass over the array, no stores to shared memory.
+ * Slots frozen by a resize still hold their name, so readers never wait for it.
+ * Return the interned pointer, NULL if missing
+ */
+char* intern_search(t_intern_table* table, t_intern_thread* self, const char* name) {
+    
+    size_t i, n;
+    uintptr_t key;
+    char* found = NULL;
+    uint64_t h = hash_name(name);
+    t_intern_array* arr;
+    
+    epoch_enter(table, self);
+    arr = atomic_load_explicit(&table->array, memory_order_acquire);
+    
+    for (i=h & (arr->size - 1), n=0; n<arr->size; i=(i+1) & (arr->size - 1), n++) {      // linear probing
+        key = atomic_load_explicit(&arr->slot[i], memory_order_acquire) & ~(uintptr_t)SLOT_FROZEN;
+        if (key == 0)                                   // end of the cluster, name is missing
+            break;
+        if (key != SLOT_DELETED && name_header(key)->hash == h && strcmp((char*)key, name) == 0) {
+            found = (char*)key;
+            break;
+        }
+    }
+    
+    epoch_exit(self);
+    return found;
+}
+
+/*
+ * Insert a name if missing. An empty slot is claimed with CAS, the loser of a race on the same slot
+ * finds the winner's name there. Deleted slots are never reused, so two threads inserting the same
+ * name always meet on the same slot. Writers finding a frozen slot wait for the resize and retry on the new array.
+ * Return the interned pointer, *created is set to 1 if it was inserted now
+ */
+char* intern_insert(t_intern_table* table, t_intern_thread* self, const char* name, int* created) {
+    
+    size_t i, n;
+    uintptr_t key, expected;
+    char* found = NULL;
+    uint64_t h = hash_name(name);
+    size_t len;
+    t_intern_name* fresh = NULL;
+    t_intern_array* arr;
+    
+    if (created != NULL)
+        *created = 0;
+    
+    epoch_enter(table, self);
+    
+    while (found == NULL) {
+        arr = atomic_load_explicit(&table->array, memory_order_acquire);
+    
+        if (atomic_load(&table->used) << 1 >= arr->size) {             // keep load under one half, deleted slots included
+            resize(table, self, arr);
+            continue;
+        }
+    
+        for (i=h & (arr->size - 1), n=0; n<arr->size; i=(i+1) & (arr->size - 1), n++) {
+            key = atomic_load_explicit(&arr->slot[i], memory_order_acquire);
+    
+            if (key == 0) {                                 // free slot, try to claim it
+                if (fresh == NULL) {
+                    len = strlen(name);
+                    fresh = malloc(sizeof(t_intern_name) + len + 1);
+                    fresh->hash = h;
+                    fresh->reserved = 0;
+                    fresh->len = len;
+                    memcpy(fresh->name, name, len + 1);
+                }
+                expected = 0;
+                if (atomic_compare_exchange_strong(&arr->slot[i], &expected, (uintptr_t)fresh->name)) {
+                    atomic_fetch_add(&table->used, 1);
+                    atomic_fetch_add(&table->count, 1);
+                    found = fresh->name;
+                    if (created != NULL)
+                        *created = 1;
+                    break;
+                }
+                key = expected;                             // lost the race, look at the winner
+            }
+    
+            if (key & SLOT_FROZEN)                          // resize in progress
+                break;
+            if (key != SLOT_DELETED && name_header(key)->hash == h && strcmp((char*)key, name) == 0) {
+                found = (char*)key;
+                break;
+            }
+        }
+    
+        if (found == NULL) {
+            if (n < arr->size)                              // stopped on a frozen slot
+                wait_resize(table, arr);
+            else                                            // every slot taken by deleted names
+                resize(table, self, arr);
+        }
+    }
+    
+    epoch_exit(self);
+    
+    if (fresh != NULL && found != fresh->name)             // another thread inserted it first
+        free(fresh);
+    return found;
+}
+
+/*
+ * Delete a name, its slot becomes SLOT_DELETED with CAS.
+ * Readers may still hold the name, so its memory is retired and freed two epochs later.
+ * Return 1 if it was found
+ */
+int intern_delete(t_intern_table* table, t_intern_thread* self, const char* name) {
+    
+    size_t i, n;
+    uintptr_t key, expected;
+    uintptr_t deleted = 0;
+    uint64_t h = hash_name(name);
+    t_intern_array* arr;
+    int retry = 1;
+    
+    epoch_enter(table, self);
+    
+    while (retry) {
+        retry = 0;
+        arr = atomic_load_explicit(&table->array, memory_order_acquire);
+    
+        for (i=h & (arr->size - 1), n=0; n<arr->size; i=(i+1) & (arr->size - 1), n++) {
+            key = atomic_load_explicit(&arr->slot[i], memory_order_acquire);
+    
+            if (key & SLOT_FROZEN) {                        // resize in progress, retry on new array
+                wait_resize(table, arr);
+                retry = 1;
+                break;
+            }
+            if (key == 0)                                   // name is missing
+                break;
+            if (key != SLOT_DELETED && name_header(key)->hash == h && strcmp((char*)key, name) == 0) {
+                expected = key;
+                if (atomic_compare_exchange_strong(&arr->slot[i], &expected, SLOT_DELETED)) {
+                    atomic_fetch_sub(&table->count, 1);
+                    deleted = key;
+                }
+                else                                        // slot was frozen or deleted meanwhile
+                    retry = 1;
+                break;
+            }
+        }
+    }
+    
+    epoch_exit(self);
+    
+    if (deleted != 0)
+        retire(table, self, name_header(deleted));
+    return deleted != 0;
+}
+
+/*
+ * Number of names in the table
+ */
+size_t intern_count(t_intern_table* table) {
+    
+    return atomic_load(&table->count);
+}
+
+/*
+ * Call visit on every name, in slot order. No thread may be changing the table
+ */
+void intern_visit(t_intern_table* table, void (*visit)(char* name, void* arg), void* arg) {
+    
+    size_t i;
+    uintptr_t key;
+    t_intern_array* arr = atomic_load(&table->array);
+    
+    for (i=0; i<arr->size; i++) {
+        key = atomic_load(&arr->slot[i]) & ~(uintptr_t)SLOT_FROZEN;
+        if (key != 0 && key != SLOT_DELETED)
+            visit((char*)key, arg);
+    }
+}
+
+/*
+ * Hash a name with FNV-1a, then finalizer of splitmix64 since low bits are used as slot
+ */
+static inline uint64_t hash_name(const char* s) {
+    
+    uint64_t h = 14695981039346656037ULL;          // FNV offset basis
+    
+    for (; *s; s++) {
+        h ^= (uint8_t)*s;
+        h *= 1099511628211ULL;                      // FNV prime
+    }
+    
+    h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    h = (h ^ (h >> 27)) * 0x94D049BB133111EBULL;
+    return h ^ (h >> 31);
+}
+
+/*
+ * Find header of an interned name
+ */
+static inline t_intern_name* name_header(uintptr_t key) {
+    
+    return (t_intern_name*)(key - offsetof(t_intern_name, name));
+}
+
+/*
+ * Allocate an empty array of slots
+ */
+static t_intern_array* new_array(const size_t size) {
+    
+    t_intern_array* arr = calloc(1, sizeof(t_intern_array) + size * sizeof(uintptr_t));
+    
+    arr->size = size;
+    return arr;
+}
+
+/*
+ * Mark calling thread as reading the table.
+ * Full fence so that the epoch is visible before any slot is loaded
+ */
+static inline void epoch_enter(t_intern_table* table, t_intern_thread* self) {
+    
+    atomic_store(&self->active, atomic_load(&table->epoch));
+    atomic_thread_fence(memory_order_seq_cst);
+}
+
+/*
+ * Mark calling thread as out of the table
+ */
+static inline void epoch_exit(t_intern_thread* self) {
+    
+    atomic_store_explicit(&self->active, 0, memory_order_release);
+}
+
+/*
+ * Hand a block to epoch based reclamation.
+ * A block retired in epoch e can be freed once global epoch reached e+2: every thread that could
+ * have loaded it was active in e or before, and the epoch cannot move past e+1 while one of them is.
+ * Limbo lists are indexed by epoch modulo 3, so the one of current epoch only holds blocks old enough
+ */
+static void retire(t_intern_table* table, t_intern_thread* self, void* ptr) {
+    
+    uint64_t e = atomic_load(&table->epoch);
+    t_intern_retired* el = malloc(sizeof(t_intern_retired));
+    
+    if (self->limbo_epoch != e) {                   // first retire in this epoch, release blocks from e-3 or older
+        free_retired(self->limbo[e % 3]);
+        self->limbo[e % 3] = NULL;
+        self->limbo_epoch = e;
+    }
+    
+    el->ptr = ptr;
+    el->next = self->limbo[e % 3];
+    self->limbo[e % 3] = el;
+    
+    if (++self->retired >= RETIRE_THRESHOLD) {
+        self->retired = 0;
+        try_advance(table);
+    }
+}
+
+/*
+ * Free a list of retired blocks
+ */
+static void free_retired(t_intern_retired* list) {
+    
+    t_intern_retired* next;
+    
+    for (; list != NULL; list = next) {
+        next = list->next;
+        free(list->ptr);
+        free(list);
+    }
+}
+
+/*
+ * Move global epoch forward if every active thread already saw it
+ */
+static void try_advance(t_intern_table* table) {
+    
+    int i;
+    uint64_t active;
+    uint64_t e = atomic_load(&table->epoch);
+    
+    for (i=0; i<INTERN_MAX_THREADS; i++) {
+        active = atomic_load(&table->thread[i].active);
+        if (active != 0 && active != e)             // a thread is still reading in an older epoch
+            return;
+    }
+    
+    atomic_compare_exchange_strong(&table->epoch, &e, e + 1);
+}
+
+/*
+ * Replace passed array with a new one holding only the live names.
+ * Every slot is frozen before being copied, so no insert or delete can land on the old array afterwards.
+ * Only one thread resizes, others asking for the same array find it already replaced
+ */
+static void resize(t_intern_table* table, t_intern_thread* self, t_intern_array* arr) {
+    
+    size_t i, j, size, copied = 0;
+    uintptr_t key;
+    t_intern_array* fresh;
+    
+    pthread_mutex_lock(&table->resize_lock);
+    if (atomic_load(&table->array) != arr) {        // someone else already did it
+        pthread_mutex_unlock(&table->resize_lock);
+        return;
+    }
+    
+    for (size = INTERN_INITIAL_SIZE; size < atomic_load(&table->count) << 2; size <<= 1);     // live names at one quarter
+    fresh = new_array(size);
+    
+    for (i=0; i<arr->size; i++) {
+        key = atomic_fetch_or(&arr->slot[i], SLOT_FROZEN) & ~(uintptr_t)SLOT_FROZEN;
+        if (key == 0 || key == SLOT_DELETED)
+            continue;
+        for (j=name_header(key)->hash & (size - 1); atomic_load_explicit(&fresh->slot[j], memory_order_relaxed) != 0; j=(j+1) & (size - 1));
+        atomic_store_explicit(&fresh->slot[j], key, memory_order_relaxed);
+        copied++;
+    }
+    
+    atomic_store(&table->used, copied);
+    atomic_store_explicit(&table->array, fresh, memory_order_release);
+    pthread_mutex_unlock(&table->resize_lock);
+    
+    retire(table, self, arr);                       // readers may still be probing it
+}
+
+/*
+ * Wait until a resize of passed array is published.
+ * A frozen slot means the resizing thread holds the lock, so taking it waits for the end of the copy
+ */
+static void wait_resize(t_intern_table* table, t_intern_array* arr) {
+    
+    while (atomic_load_explicit(&table->array, memory_order_acquire) == arr) {
+        pthread_mutex_lock(&table->resize_lock);
+        pthread_mutex_unlock(&table->resize_lock);
+    }
+}
@@ -0,0 +1,52 @@
+#ifndef INTERN_H
+#define INTERN_H
+
+#include <stddef.h>
+
+// DEFINES
+
+#define INTERN_MAX_THREADS 128                  // threads that can use one table at the same time
+#define INTERN_INITIAL_SIZE 1024                // initial number of slots, power of 2
+
+// END OF DEFINES
+
+// Concurrent interning table: each name is stored once and identified by its pointer.
+// Reads are wait-free, inserts and deletes use CAS, deleted names are freed through epoch based reclamation.
+// An interned name has its length as uint32_t in the 4 bytes before its characters
+typedef struct intern_table t_intern_table;
+
+// Epoch record of one thread using a table, obtained with intern_join
+typedef struct intern_thread t_intern_thread;
+
+// FUNCTION PROTOTYPES
+
+// Create an empty table
+t_intern_table* intern_create();
+
+// Free the table and every name inside, no thread may be using it
+void intern_destroy(t_intern_table* table);
+
+// Register calling thread, every operation needs its record
+t_intern_thread* intern_join(t_intern_table* table);
+
+// Unregister a thread, its record can be reused
+void intern_leave(t_intern_table* table, t_intern_thread* self);
+
+// Search a name. Return the interned pointer, NULL if missing
+char* intern_search(t_intern_table* table, t_intern_thread* self, const char* name);
+
+// Insert a name if missing. Return the interned pointer, *created is set to 1 if it was inserted now
+char* intern_insert(t_intern_table* table, t_intern_thread* self, const char* name, int* created);
+
+// Delete a name. Return 1 if it was found. Its memory is released once no thread can be reading it
+int intern_delete(t_intern_table* table, t_intern_thread* self, const char* name);
+
+// Number of names in the table
+size_t intern_count(t_intern_table* table);
+
+// Call visit on every name, no thread may be changing the table
+void intern_visit(t_intern_table* table, void (*visit)(char* name, void* arg), void* arg);
+
+// END OF FUNCTION PROTOTYPES
+
+#endif
@@ -0,0 +1,6407 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <inttypes.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <math.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+#include "monitor.h"
+#include "intern.h"
+#include "sketch.h"
+#include "trace.h"
+#include "store.h"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#define SIMD_SCAN 1                     // AVX2 scan of destination counts can be compiled
+#endif
+
+#define CACHE_LINE_SIZE 64              // alignment of hot structures
+
+// Stored name of an entity or relation, of any length. Structures point to its characters, so that it reads
+// as a plain string, and find its length just before them
+typedef struct name {
+    
+    uint32_t len;                       // number of characters
+    char str[];                         // characters, terminated
+    
+} t_name;
+
+// Report text of one relation, immutable once built and shared by every snapshot taken while the relation does not change
+typedef struct rel_summary {
+    
+    _Atomic int refs;                   // snapshots holding it, plus one while the relation still points to it
+    size_t len;                         // number of characters
+    char text[];                        // name, most receivers entities and count, as printed by report
+    
+} t_rel_summary;
+
+// Structure for origin set of a destination, its count is kept in the relation structure.
+// Small sets are sorted arrays of names, big ones hash sets of names so that inserts do not shift
+typedef struct dest_str {
+    
+    char** dest_of;                     // array of entities that he is destination of, hash slots if is_hash
+    uint32_t dest_of_size;              // size of destination_of array
+    uint8_t is_hash;                    // 1 if dest_of is an open addressing hash set, NULL for empty slots
+    
+} t_dest_str;
+
+// Cold part of a relation structure, used only when printing, resizing or when relation set changes
+typedef struct rel_cold {
+    
+    char* rel;                          // name of the relation
+    int pos;                            // position in relation array, kept up to date as the array shifts
+    uint32_t most_dest_size;            // size of most_dest array
+    uint32_t dest_size;                 // size of destination arrays
+    
+    char** rank_arr;                    // destinations by decreasing count, NULL until first top k request on the relation
+    uint32_t* rank_pos;                 // position in rank array of each destination, parallel to destination arrays
+    uint32_t* rank_ge;                  // number of destinations receiving at least c relations, bucket c is [rank_ge[c+1], rank_ge[c])
+    uint32_t rank_ge_size;              // length of rank_ge array
+    
+    t_rel_summary* reported;            // report text at last delta report, NULL if never reported
+    
+} t_rel_cold;
+
+// Structure for relation array, hot part only so that each one fits a cache line. 
+// Destinations are kept as parallel arrays sorted by name
+typedef struct rel_str {
+    
+    uint32_t n_most_dest;               // number of relation received at most
+    uint32_t most_dest_count;           // number of entities in most_dest array
+    uint32_t dest_count;                // number of entities in destination arrays
+    
+    char** most_dest_arr;               // array of entities that are receiving the most for this relation
+    
+    char** dest_arr;                    // names of entities that are destination for this relation
+    uint32_t* dest_of_count;            // number of entities each destination is destination of
+    t_dest_str* dest_of;                // origin set of each destination
+    
+    t_rel_cold* cold;                   // cold part of the structure
+    t_rel_summary* summary;             // report text at last published snapshot, NULL if relation changed since
+    
+} __attribute__((aligned(CACHE_LINE_SIZE))) t_rel_str;
+
+// Slot of the relation perfect hash or of its side table, name is kept here so that verification does not touch
+// cold data. Cold part of a relation does not move, its position in relation array is read from there
+typedef struct rel_slot {
+    
+    char* rel;                          // name of the relation, NULL if empty, REL_SLOT_DELETED if deleted from side table
+    t_rel_cold* cold;                   // cold part of the relation
+    
+} t_rel_slot;
+
+// Relation removed after being printed by a delta report
+typedef struct removed_rel {
+    
+    char* rel;                          // name of the relation
+    t_rel_summary* reported;            // report text at last delta report
+    
+} t_removed_rel;
+
+// Relation array with its perfect hash. One for the whole engine, or one for each shard
+typedef struct rel_table {
+    
+    t_rel_str* rel_arr;                 // relation array
+    size_t rel_count;                   // current number of relation
+    size_t rel_size;                    // length of relation array
+    
+    uint32_t* hash_seed;                // seed of each bucket of the relation perfect hash
+    t_rel_slot* hash_slot;              // relation for each slot of the perfect hash, emptied when the relation is removed
+    size_t hash_buckets;                // number of buckets of the perfect hash
+    size_t hash_size;                   // number of slots of the perfect hash, relations at last rebuild
+    t_rel_slot* side_slot;              // relations created since last rebuild, open addressing with linear probing
+    size_t side_size;                   // number of slots of the side table, power of two
+    size_t hash_changes;                // used side slots and empty perfect hash slots, rebuild at half the side table
+    int hash_valid;                     // 1 if the perfect hash can be used, binary search is used else
+    
+    size_t hash_rebuilds;               // number of times the perfect hash was rebuilt
+    double hash_time;                   // total time spent rebuilding in seconds
+    
+    t_removed_rel* removed;             // reported relations removed since last delta report
+    size_t removed_count;               // number of removed names
+    size_t removed_size;                // length of removed names array
+    
+} t_rel_table;
+
+// Growable text buffer, used to format reports
+typedef struct text {
+    
+    char* buf;                          // characters, not terminated
+    size_t len;                         // number of characters
+    size_t size;                        // size of buffer
+    
+} t_text;
+
+// Report of the whole engine published by the writer, read by reporter thread and by any thread through the API
+typedef struct snapshot {
+    
+    _Atomic int refs;                   // readers holding it, plus one while it is the published snapshot
+    size_t count;                       // number of relations
+    t_rel_summary* summary[];           // summary of each relation in name order
+    
+} t_snapshot;
+
+// Internal node of the radix tree entity dictionary. Leaves are the entity names themselves
+typedef struct radix_node {
+    
+    void* child[2];                     // children, internal node if tagged with lowest bit set, entity name else
+    uint32_t byte;                      // position of the first byte where the two subtrees differ
+    uint8_t otherbits;                  // every bit set except the critical one
+    
+} t_radix_node;
+
+// DEFINES
+
+#define ENTITY_ARRAY_SIZE 2048                  // number of entity
+#define RELATION_ARRAY_SIZE 128                 // number of relation
+
+#define MOST_DESTINATION_ARRAY_SIZE 256         // number of most destination
+#define DESTINATION_ARRAY_SIZE 1024             // number of destination
+
+#define DESTINATION_OF_SIZE 4                   // initial number of origin
+#define ORIGIN_HASH_MIN 256                     // origins of a destination before its sorted array becomes a hash set
+
+#define LINE_SIZE 256                           // initial size of the line buffer, grown for longer lines
+#define COMMAND_SIZE 7+1                        // max command length
+#define TOKEN_COUNT 5                           // command and its arguments, the most a line uses
+
+#define NAME_INLINE_SIZE 16                     // copy of a name kept inside its structure up to 15 characters, spilled to the heap above
+
+#define HASH_BUCKET_LOAD 1                      // average relations per bucket of the perfect hash
+#define HASH_MAX_ATTEMPT 2048                   // seeds tried for a bucket while most slots are free, more as they fill up
+#define HASH_CHANGE_PERCENTAGE 12               // relations created or removed since last rebuild, in percentage of relations, before next one
+#define HASH_SIDE_MIN 16                        // least slots of the side table of the perfect hash
+#define REL_SLOT_DELETED (&rel_slot_deleted)    // marker of a deleted slot of the side table of the perfect hash
+
+#define BATCH_ARRAY_SIZE 1024                   // number of buffered commands
+#define BATCH_MERGE_RATIO 16                    // merge a relation only if it receives at least 1 command every this many destinations
+
+#define PEEP_WINDOW_SIZE 65536                  // pending commands of the peephole optimizer before a forced flush
+#define PEEP_INDEX_SIZE 1024                    // initial size of the peephole optimizer hash indexes
+
+#define SHARD_QUEUE_SIZE 4096                   // commands waiting for each shard, power of 2
+#define SHARD_CHUNK_SIZE 256                    // commands staged by main thread before taking the shard lock
+
+#define SHARD_ADD_REL 0                         // shard command: addrel with resolved entities
+#define SHARD_DEL_REL 1                         // shard command: delrel with resolved entities
+#define SHARD_DEL_ENT 2                         // shard command: remove entity from owned relations
+#define SHARD_REPORT 3                          // shard command: format report fragment of owned relations
+#define SHARD_STOP 4                            // shard command: terminate worker thread
+
+#define TEXT_SIZE 4096                          // initial size of text buffers
+
+#define REPORT_QUEUE_SIZE 64                    // snapshots waiting for the reporter thread, power of 2
+
+#define RANK_COUNT_SIZE 64                      // initial number of count buckets of a rank array
+
+#define WHEEL_BITS 6                            // bits of time covered by each level of the timer wheel
+#define WHEEL_SIZE (1 << WHEEL_BITS)            // slots of each level
+#define WHEEL_LEVELS 4                          // levels of the timer wheel, farther timers wait in the last one
+
+#define SKETCH_ARRAY_SIZE 16                    // number of relation sketches
+#define SKETCH_GEN_SIZE 65536                   // entity generations of approximate mode, entities share them by name hash
+
+#define HASH_REL_SIZE 503                       // initial slots of the relation table of the hash engine, prime
+#define HASH_SET_SIZE 5                         // initial slots of destination tables and origin sets of the hash engine, prime
+#define HASH_LOAD_PERCENTAGE 80                 // live and deleted slots tolerated in a table of the hash engine before resizing
+#define HASH_DELETED (&hash_deleted)            // marker of a deleted slot of the hash engine
+
+#define CHECKPOINT_POLL 1024                    // commands between two checks for the end of a running checkpoint
+
+#define DICT_ARRAY MONITOR_DICT_ARRAY           // entity dictionary as sorted array of fixed size names
+#define DICT_RADIX MONITOR_DICT_RADIX           // entity dictionary as compressed radix tree (crit-bit)
+#define DICT_HASH MONITOR_DICT_HASH             // entity dictionary as concurrent interning hash table
+
+#define ENGINE_ARRAY MONITOR_ENGINE_ARRAY       // relations in sorted arrays
+#define ENGINE_HASH MONITOR_ENGINE_HASH         // relations in open addressing hash tables
+
+// END OF DEFINES
+
+// Private copy of a name inside a structure, short names inline and long ones spilled to the heap
+typedef struct name_copy {
+    
+    uint32_t len;                       // number of characters
+    union {
+        char buf[NAME_INLINE_SIZE];     // characters, terminated, if len < NAME_INLINE_SIZE
+        char* heap;                     // characters, terminated, otherwise
+    };
+    
+} t_name_copy;
+
+// Buffered addrel or delrel waiting to be applied in batch
+typedef struct batch_op {
+    
+    char* orig;                         // name of origin entity, pointer to entity dictionary
+    char* dest;                         // name of destination entity, pointer to entity dictionary
+    t_name_copy rel;                    // name of the relation
+    uint32_t seq;                       // arrival order, last one wins for the same edge
+    int add;                            // 1 for addrel, 0 for delrel
+    
+} t_batch_op;
+
+// Pending entity state of the peephole optimizer
+typedef struct peep_ent {
+    
+    t_name_copy name;                   // name of the entity
+    int base;                           // 1 if entity exists in the engine
+    int exists;                         // 1 if entity exists after pending commands
+    int wiped;                          // 1 if entity has to be deleted from the engine
+    uint32_t del_seq;                   // arrival of the last effective delent, older commands on its edges are dead
+    
+} t_peep_ent;
+
+// Pending edge command of the peephole optimizer, only the last one for each edge is kept
+typedef struct peep_rel {
+    
+    t_name_copy orig;                   // name of origin entity
+    t_name_copy dest;                   // name of destination entity
+    t_name_copy rel;                    // name of the relation
+    uint32_t seq;                       // arrival of the last command
+    int add;                            // 1 for addrel, 0 for delrel
+    
+} t_peep_rel;
+
+// Sketch of the destination counts of one relation, approximate mode only
+typedef struct sketch_rel {
+    
+    char* rel;                          // name of the relation, stored name
+    t_sketch* sketch;                   // count-min sketch with candidate receivers
+    
+} t_sketch_rel;
+
+// Scheduled expiry of a relation added with a ttl, names are copied since entities can be deleted meanwhile
+typedef struct timer {
+    
+    struct timer* next;                 // next timer in the same wheel slot, or in the free list
+    uint64_t expire;                    // tick when the relation is deleted
+    t_name_copy orig;                   // name of origin entity
+    t_name_copy dest;                   // name of destination entity
+    t_name_copy rel;                    // name of the relation
+    
+} t_timer;
+
+// Binary trace being replayed, names of its dictionary and the entities they resolve to
+typedef struct replay {
+    
+    char** name;                        // names of the dictionary by id
+    char** ent;                         // name in the entity dictionary of each id, NULL if missing
+    uint8_t* resolved;                  // 1 if ent of the id is up to date
+    uint32_t name_count;                // number of names
+    uint64_t ttl;                       // ttl of the next addrel, 0 if none
+    int direct;                         // 1 if resolved entities can go straight to the engine
+    
+} t_replay;
+
+// Command sent by the main thread to a shard
+typedef struct shard_cmd {
+    
+    int op;                             // one of SHARD_ADD_REL, SHARD_DEL_REL, SHARD_DEL_ENT, SHARD_REPORT, SHARD_STOP
+    char* orig;                         // origin entity, or entity to delete, pointer to entity dictionary
+    char* dest;                         // destination entity, pointer to entity dictionary
+    t_name_copy rel;                    // name of the relation, freed by the worker once applied
+    
+} t_shard_cmd;
+
+// Worker thread owning the relations whose name hashes to it
+typedef struct shard {
+    
+    pthread_t thread;                   // worker thread
+    t_rel_table table;                  // relations owned by this shard, touched only by the worker between barriers
+    
+    t_shard_cmd* queue;                 // ring of commands, written by main thread and read by the worker
+    size_t head;                        // commands pushed so far, slot is head % SHARD_QUEUE_SIZE
+    size_t tail;                        // commands applied so far
+    pthread_mutex_t lock;               // protects head and tail
+    pthread_cond_t not_empty;           // signaled by main thread when commands are pushed
+    pthread_cond_t not_full;            // signaled by the worker when commands are applied
+    
+    t_shard_cmd* stage;                 // commands staged by main thread, pushed in chunks to take the lock once
+    size_t stage_count;                 // number of staged commands
+    
+    t_text frag;                        // report fragment, owned relations formatted one after the other
+    size_t* frag_off;                   // start of each relation in the fragment, one more for the end
+    size_t frag_off_size;               // length of fragment offsets array
+    size_t frag_next;                   // next relation to print while merging fragments
+    
+} t_shard;
+
+// Destination of a relation in the hash engine, with the set of its origins
+typedef struct hash_dest {
+    
+    char* dest;                         // destination entity, pointer to entity dictionary, NULL if free, HASH_DELETED if deleted
+    uint32_t count;                     // number of origins
+    uint32_t orig_used;                 // origin slots live or deleted
+    uint32_t orig_size;                 // slots of origin set, prime
+    char** orig;                        // origin entities, open addressing like the destinations
+    
+} t_hash_dest;
+
+// Relation of the hash engine, destinations are a table of their own keyed by entity
+typedef struct hash_rel {
+    
+    char* rel;                          // name of the relation, stored name, NULL if free, HASH_DELETED if deleted
+    uint64_t hash;                      // hash of the name, checked before the name and kept for resizes
+    t_hash_dest* dest;                  // destination slots
+    uint32_t dest_count;                // live destinations
+    uint32_t dest_used;                 // destination slots live or deleted
+    uint32_t dest_size;                 // slots of destination table, prime
+    uint32_t max;                       // biggest count of a destination, 0 if it has to be recomputed
+    
+} t_hash_rel;
+
+// Storage behind the commands of a monitor. The command layer resolves entities of delent and of edges,
+// rel gets the names as commands carry them so that each engine resolves them when it needs to
+typedef struct engine {
+    
+    const char* name;                                                       // name of the engine
+    void (*init)(t_monitor* monitor);                                       // set up empty storage
+    void (*free)(t_monitor* monitor);                                       // release storage, pending commands are dropped
+    void (*rel)(t_monitor* monitor, char* orig, char* dest, char* rel, const int add);     // addrel or delrel by names
+    void (*edge)(t_monitor* monitor, char* orig, char* dest, char* rel, const int add);    // addrel or delrel of resolved entities, NULL if not supported
+    void (*del_ent)(t_monitor* monitor, char* ent);                         // remove relations of a resolved entity before it leaves the dictionary
+    void (*flush)(t_monitor* monitor);                                      // apply buffered commands, NULL if none are kept
+    void (*report)(t_monitor* monitor);                                     // format the report into report text
+    void (*topk)(t_monitor* monitor, const int k);                          // format top k into report text, after flush
+    void (*stats)(t_monitor* monitor, FILE* out);                           // print statistics of the storage, after flush
+    void (*dump)(t_monitor* monitor, FILE* out);                            // print every structure, after flush
+    void (*save)(t_monitor* monitor, FILE* out);                            // write every relation as addrel, after flush, NULL if not supported
+    
+} t_engine;
+
+// Every state of one monitor, instances share nothing
+struct monitor {
+    
+    t_rel_table rel_table;              // relations of the engine when not sharded
+    t_text report_text;                 // last formatted report
+    char* line;                         // line being executed, split into tokens
+    size_t line_size;                   // size of line buffer
+    
+    char** ent_arr;                     // entity array
+    uint32_t ent_count;                 // current number of entity 
+    uint32_t ent_size;                  // length of the entity array
+    
+    int batch_mode;                     // 1 if addrel and delrel are buffered until report or delent
+    t_batch_op* batch_arr;              // buffered commands
+    size_t batch_count;                 // number of buffered commands
+    size_t batch_size;                  // length of buffered commands array
+    uint32_t batch_seq;                 // arrival counter of buffered commands
+    
+    int peep_mode;                      // 1 if commands go through the peephole optimizer
+    t_peep_ent* peep_ent_arr;           // pending entity states
+    size_t peep_ent_count;              // number of pending entity states
+    size_t peep_ent_size;               // length of pending entity states array
+    t_peep_rel* peep_rel_arr;           // pending edge commands
+    size_t peep_rel_count;              // number of pending edge commands
+    size_t peep_rel_size;               // length of pending edge commands array
+    int* peep_ent_index;                // hash index over pending entity states, position + 1, 0 if empty
+    size_t peep_ent_index_size;         // length of entity hash index
+    int* peep_rel_index;                // hash index over pending edge commands, position + 1, 0 if empty
+    size_t peep_rel_index_size;         // length of edge hash index
+    uint32_t peep_seq;                  // arrival counter of the peephole optimizer
+    size_t peep_in;                     // commands received by the peephole optimizer
+    size_t peep_out;                    // commands sent to the engine by the peephole optimizer
+    
+    int shard_count;                    // number of worker threads owning the relations, 0 if not sharded
+    t_shard* shard_arr;                 // worker threads
+    
+    int ent_dict;                       // entity dictionary in use, DICT_ARRAY, DICT_RADIX or DICT_HASH
+    void* radix_root;                   // root of the radix tree entity dictionary
+    t_intern_table* intern;             // interning table entity dictionary
+    t_intern_thread* intern_self;       // epoch record of the thread driving the monitor
+    
+    int snapshot_mode;                  // 1 if reports are printed from published snapshots by a reporter thread
+    t_snapshot* snapshot;               // last published snapshot
+    pthread_mutex_t snapshot_lock;      // protects swap of published snapshot and taking a reference to it
+    size_t snapshot_count;              // snapshots published so far
+    size_t summary_count;               // relation summaries formatted so far, the others were reused
+    
+    pthread_t reporter;                 // thread printing queued snapshots while commands are read
+    FILE* report_out;                   // output of the reporter thread
+    t_snapshot** report_queue;          // ring of snapshots to print, NULL asks the reporter to stop
+    size_t report_head;                 // snapshots pushed so far, slot is head % REPORT_QUEUE_SIZE
+    size_t report_tail;                 // snapshots printed so far
+    pthread_mutex_t report_lock;        // protects head and tail
+    pthread_cond_t report_not_empty;    // signaled by main thread when a snapshot is pushed
+    pthread_cond_t report_not_full;     // signaled by the reporter when a snapshot is printed
+    
+    char** topk_arr;                    // scratch selecting the printed names of one count bucket while formatting top k
+    size_t topk_size;                   // length of top k scratch
+    
+    size_t rel_cursor;                  // next relation to visit in name order when not sharded
+    t_text summary_text;                // scratch to format one relation summary
+    
+    int delta_mode;                     // 1 if report prints only relations changed since previous report
+    t_removed_rel* delta_arr;           // scratch for removed relations while formatting a delta report
+    size_t delta_size;                  // length of removed relations scratch
+    
+    uint64_t now;                       // logical time, advanced by tick
+    t_timer* wheel[WHEEL_LEVELS][WHEEL_SIZE];   // pending expiries, level l slot s holds timers expiring in its WHEEL_SIZE^l ticks
+    t_timer* timer_free;                // fired timers, reused by next addrel with ttl
+    size_t timer_count;                 // pending timers
+    size_t timer_level_count[WHEEL_LEVELS];     // pending timers of each level
+    size_t timer_expired;               // timers fired so far
+    
+    double sketch_eps;                  // additive error of approximate mode relative to relations of a type, 0 for exact counts
+    double sketch_delta;                // probability that an estimate goes beyond its error
+    size_t sketch_edges;                // live relations the edge filter is sized for
+    t_sketch_rel* sketch_arr;           // sketch of each relation, sorted by name
+    size_t sketch_count;                // number of relation sketches
+    size_t sketch_size;                 // length of relation sketches array
+    t_sketch_filter* sketch_filter;     // set of live relations, with false positives
+    uint32_t* sketch_gen;               // generation of entity names by hash, bumped by delent
+    size_t sketch_cand;                 // candidates of each sketch
+    t_text sketch_key;                  // scratch to build entity and edge keys of approximate mode
+    const char** sketch_keys;           // scratch for candidates of one sketch
+    uint32_t* sketch_counts;            // scratch for estimates of one sketch
+    size_t sketch_repeated;             // addrel taken as already present
+    
+    const t_engine* engine;             // storage behind the commands, sorted arrays, hash tables or sketches
+    
+    t_hash_rel* hash_rel_arr;           // relation slots of the hash engine
+    uint32_t hash_rel_count;            // live relations of the hash engine
+    uint32_t hash_rel_used;             // relation slots live or deleted
+    uint32_t hash_rel_size;             // slots of relation table, prime
+    size_t hash_resizes;                // resizes of every table of the hash engine
+    t_hash_rel** hash_order;            // scratch for relations in name order
+    size_t hash_order_size;             // length of relations scratch
+    t_hash_dest** hash_dests;           // scratch for destinations of one relation
+    size_t hash_dests_size;             // length of destinations scratch
+    
+    pid_t checkpoint_pid;               // forked writer of the running checkpoint, 0 if none
+    char* checkpoint_path;              // file of the running checkpoint
+    double checkpoint_start;            // when the running checkpoint was started, in seconds
+    double checkpoint_pause;            // time commands waited for the running checkpoint to start, in seconds
+    long checkpoint_faults;             // page faults of this process when the running checkpoint was forked
+    size_t checkpoint_polls;            // commands since the running checkpoint was started
+    size_t checkpoint_done;             // checkpoints written so far
+    size_t checkpoint_failed;           // checkpoints whose writer failed
+    double checkpoint_max_pause;        // longest pause to start a checkpoint, in seconds
+    
+    t_store* store;                     // file holding entities and relations in out-of-core mode, NULL else
+    
+};
+
+// State of a monitor kept in the root record of its store, everything it points to lives in the store too
+typedef struct store_state {
+    
+    size_t layout[4];                   // sizes of the structures in the store, another build cannot read it if they changed
+    int clean;                          // 1 if the monitor closed the store, its structures may be half changed else
+    int ent_dict;                       // entity dictionary, DICT_ARRAY or DICT_RADIX
+    char** ent_arr;                     // entity array
+    uint32_t ent_count;                 // current number of entity
+    uint32_t ent_size;                  // length of the entity array
+    void* radix_root;                   // root of the radix tree entity dictionary
+    t_rel_table rel_table;              // relations of the engine
+    uint64_t now;                       // logical time
+    
+} t_store_state;
+
+// FUNCTION PROTOTYPES
+
+// Print entity array
+static void print_ent_arr(t_monitor* monitor, FILE* out);
+
+// Print destination structure
+static void print_dest_str(FILE* out, const t_rel_str* el, const int pos);
+
+// Print relation structure
+static void print_rel_str(FILE* out, const t_rel_str* el);
+
+// Print relation array
+static void print_rel_arr(FILE* out, t_rel_table* table);
+
+// Free passed relation structure
+static inline void free_rel_str(t_rel_str* rel_str);
+
+// Set up an empty relation table
+static void init_rel_table(t_rel_table* table);
+
+// Free every relation of a table
+static void free_rel_table(t_rel_table* table);
+
+// Search for a string in the passed array 
+static int search_string_array(char** arr, const size_t elem_count, char* target);
+
+// Compare function for qsort for array of stored names
+static int string_compare(const void* a, const void* b);
+
+// Allocate a stored name with its length
+static char* name_new(const char* s, const size_t len);
+
+// Free a stored name
+static inline void name_free(char* name);
+
+// Length of a stored name
+static inline uint32_t name_len(const char* name);
+
+// Order of two stored names
+static inline int name_compare(const char* a, const char* b);
+
+// Order of a stored name and a string of known length
+static inline int name_compare_len(const char* stored, const char* s, const size_t len);
+
+// Copy a name inside a structure
+static inline void name_copy_set(t_name_copy* copy, const char* s, const size_t len);
+
+// Characters of a copied name
+static inline char* name_copy_str(const t_name_copy* copy);
+
+// Release a copied name
+static inline void name_copy_free(t_name_copy* copy);
+
+// Order of two copied names
+static inline int name_copy_compare(const t_name_copy* a, const t_name_copy* b);
+
+// Check if a copied name equals a string of known length
+static inline int name_copy_equal(const t_name_copy* copy, const char* s, const size_t len);
+
+// Reallocate passed array of string with double the size
+static inline char** realloc_string_array(char** arr, uint32_t *max_size);
+
+// Add entity into entity array in order
+static void add_entity(t_monitor* monitor, char* new_ent);
+
+// Search for an entity in the entity dictionary
+static char* search_entity(t_monitor* monitor, char* target);
+
+// Remove entity from the entity dictionary and release its name
+static void remove_entity(t_monitor* monitor, char* ent);
+
+// Append an interned name to a string array, used to list the interning table
+static void collect_interned(char* name, void* arg);
+
+// Print radix tree in order
+static void print_radix_tree(FILE* out, void* node, int* i);
+
+// Free radix tree and every entity name inside
+static void free_radix_tree(void* node);
+
+// Search for an entity in the radix tree
+static char* search_radix_tree(t_monitor* monitor, char* target);
+
+// Insert entity into the radix tree
+static void insert_radix_tree(t_monitor* monitor, char* new_ent);
+
+// Delete entity from the radix tree
+static void delete_radix_tree(t_monitor* monitor, char* ent);
+
+// Search for a relation in the relation array. 
+static int search_relation(t_rel_table* table, char* target);
+
+// Hash a string with FNV-1a
+static inline uint64_t hash_string(const char* s);
+
+// Mix hash with a bucket seed to find its slot
+static inline uint64_t hash_mix(uint64_t h, uint32_t seed);
+
+// Rebuild the minimal perfect hash over the relation names
+static void build_relation_hash(t_rel_table* table);
+
+// Try to build the perfect hash with the passed number of buckets
+static int try_relation_hash(t_rel_table* table, uint64_t* hash, size_t bucket_count);
+
+// Slot of the perfect hash a hashed name falls into
+static inline t_rel_slot* relation_hash_slot(t_rel_table* table, const uint64_t h);
+
+// Slot of the side table holding a hashed name, NULL if missing
+static t_rel_slot* relation_side_find(t_rel_table* table, const uint64_t h, const char* rel);
+
+// Add a created relation to the perfect hash, rebuilt if too many relations changed
+static void relation_hash_insert(t_rel_table* table, t_rel_cold* cold);
+
+// Remove a relation from the perfect hash, before it is freed
+static void relation_hash_remove(t_rel_table* table, t_rel_cold* cold);
+
+// Rebuild the perfect hash if it cannot be used or too many relations changed since last rebuild
+static inline void relation_hash_check(t_rel_table* table);
+
+// Create relation structure when a new relation is introduced
+static void fill_rel_str(t_rel_str* el, char* rel);
+
+// Insert element into relation array in order, return its position
+static int insert_relation_element(t_rel_str* arr, char* new_elem, size_t elem_count);
+
+// Reallocate relation array with double the size
+static inline void realloc_rel_array(t_rel_table* table);
+
+// Reallocate destination arrays with double the size
+static inline void realloc_dest_array(t_rel_str* rel_str);
+
+// Create destination structure when a new destination for a relation is introduced
+static void fill_dest_str(t_rel_str* rel_str, const int pos, char* dest);
+
+// Insert element into destination arrays in order. 
+static int insert_dest_element(t_rel_str* rel_str, char* new_elem);
+
+// Update destination_of array with the new origin 
+static void update_dest_of(t_dest_str* dest_str, uint32_t* dest_of_count, char* orig);
+
+// Hash of an entity name
+static inline size_t origin_hash(const char* orig, const uint32_t size);
+
+// Search an origin in the origin set
+static int origin_search(t_dest_str* dest_str, const uint32_t count, char* orig);
+
+// Insert a missing origin into the hash set
+static void origin_hash_insert(t_dest_str* dest_str, const uint32_t count, char* orig);
+
+// Remove an origin from the hash set
+static void origin_hash_delete(t_dest_str* dest_str, const uint32_t count, size_t pos);
+
+// Move every origin of the hash set into a new one of the passed size
+static void origin_rehash(t_dest_str* dest_str, const uint32_t count, const uint32_t size);
+
+// Turn a sorted origin array into a hash set
+static void origin_to_hash(t_dest_str* dest_str, const uint32_t count);
+
+// Turn a hash set back into a sorted origin array
+static void origin_to_array(t_dest_str* dest_str, const uint32_t count);
+
+// Update relation structure
+static inline void update_rel_str(t_rel_str* rel_str, char* dest, const uint32_t dest_of_count);
+
+// Add new relation between two entity, routed to the owning shard if sharded
+static void add_rel(t_monitor* monitor, char* orig, char* dest, char* rel);
+
+// Add new relation between two registered entity into relation table
+static void insert_rel(t_rel_table* table, char* orig, char* dest, char* rel);
+
+// Delete passed relation structure and fix relation array order
+static void remove_rel_str(t_rel_table* table, t_rel_str* rel_str, const int rel_pos);
+
+// Delete passed destination structure and fix destination array order
+static void remove_dest_str(t_rel_str* rel_str, const int dest_pos);
+
+// Update destination of count
+static void update_dest_of_count(t_rel_str* rel_str, const int dest_pos, const int orig_pos);
+
+// Recompute which entities receives most number of relation and updates most_dest_arr
+static void recompute_most_dest(t_rel_str* rel_str);
+
+// Find the maximum of the counts array
+static uint32_t max_count_scalar(const uint32_t* count, const size_t n);
+
+// Collect destinations whose count is equal to max into most_dest_arr
+static void collect_most_dest_scalar(t_rel_str* rel_str, const uint32_t max);
+
+#ifdef SIMD_SCAN
+// Find the maximum of the counts array, AVX2 version
+static uint32_t max_count_avx2(const uint32_t* count, const size_t n);
+
+// Collect destinations whose count is equal to max into most_dest_arr, AVX2 version
+static void collect_most_dest_avx2(t_rel_str* rel_str, const uint32_t max);
+#endif
+
+// Search position of target in most destination array.
+static inline int search_most_dest(char** arr, size_t count, char* target);
+
+// Fix most destination array shifting left. Return new count
+static inline int update_most_dest(char** arr, size_t count, const int pos);
+
+// Delete, if exists, passed relation, routed to the owning shard if sharded
+static void del_rel(t_monitor* monitor, char* orig, char* dest, char* rel);
+
+// Delete, if exists, passed relation from relation table
+static void remove_rel(t_rel_table* table, char* orig, char* dest, char* rel);
+
+// Delete relations of a registered entity, broadcast to every shard if sharded
+static void del_ent(t_monitor* monitor, char* ent);
+
+// Remove every relation of a registered entity from relation table
+static void remove_ent(t_rel_table* table, char* ent);
+
+// Buffer addrel or delrel until next barrier
+static void batch_rel(t_monitor* monitor, char* orig, char* dest, char* rel, const int add);
+
+// Compare function for qsort for buffered commands
+static int batch_compare(const void* a, const void* b);
+
+// Apply every buffered command
+static void flush_batch(t_monitor* monitor);
+
+// Merge sorted buffered commands of one relation into its destination arrays
+static void merge_rel_str(t_rel_str* rel_str, t_batch_op* ops, const size_t n);
+
+// Merge sorted buffered commands of one destination into its origin set
+static uint32_t merge_dest_of(t_dest_str* dest_str, const uint32_t count, t_batch_op* ops, const size_t n);
+
+// Send addrel or delrel to the engine
+static void apply_rel(t_monitor* monitor, char* orig, char* dest, char* rel, const int add);
+
+// Send delent to the engine, then drop the entity from the dictionary
+static void apply_del_ent(t_monitor* monitor, char* ent);
+
+// Set up the sorted array engine
+static void array_init(t_monitor* monitor);
+
+// Release the sorted array engine
+static void array_free(t_monitor* monitor);
+
+// Send addrel or delrel by names to the sorted array engine, buffered if in batch mode
+static void array_rel(t_monitor* monitor, char* orig, char* dest, char* rel, const int add);
+
+// Send addrel or delrel of resolved entities to the sorted array engine
+static void array_edge(t_monitor* monitor, char* orig, char* dest, char* rel, const int add);
+
+// Remove every relation of a resolved entity from the sorted array engine
+static void array_del_ent(t_monitor* monitor, char* ent);
+
+// Apply commands buffered by batch mode and shards
+static void array_flush(t_monitor* monitor);
+
+// Format the report of the sorted array engine, full or delta
+static void array_report(t_monitor* monitor);
+
+// Print statistics of the sorted array engine
+static void array_stats(t_monitor* monitor, FILE* out);
+
+// Print every relation structure of the sorted array engine
+static void array_dump(t_monitor* monitor, FILE* out);
+
+// Find pending state of an entity, creating it if asked
+static t_peep_ent* peep_find_ent(t_monitor* monitor, char* name, const int create);
+
+// Find pending command of an edge, creating it if asked
+static t_peep_rel* peep_find_rel(t_monitor* monitor, char* orig, char* dest, char* rel, const int create);
+
+// Find free or matching slot of a peephole hash index
+static inline int* peep_index_slot(t_monitor* monitor, int* index, const size_t size, uint64_t h, const int match, void* key);
+
+// Double the size of a peephole hash index and reinsert every entry
+static int* peep_index_grow(t_monitor* monitor, int* index, size_t* size, const int is_rel);
+
+// Tell if an entity exists once pending commands are applied
+static inline int peep_exists(t_monitor* monitor, char* name);
+
+// Add entity through the peephole optimizer
+static void peep_add_ent(t_monitor* monitor, char* ent);
+
+// Delete entity through the peephole optimizer
+static void peep_del_ent(t_monitor* monitor, char* ent);
+
+// Add or delete an edge through the peephole optimizer
+static void peep_rel(t_monitor* monitor, char* orig, char* dest, char* rel, const int add);
+
+// Send the net effect of pending commands to the engine
+static void flush_peephole(t_monitor* monitor);
+
+// Free names copied by the pending commands
+static void free_peep_names(t_monitor* monitor);
+
+// Format the report results
+static void report(t_monitor* monitor);
+
+// Append a string to a text buffer
+static inline void text_append(t_text* text, const char* s, const size_t len);
+
+// Format one relation of the report
+static void format_rel_str(t_text* text, t_rel_str* el);
+
+// Start worker threads of the sharded engine
+static void start_shards(t_monitor* monitor);
+
+// Stop and free worker threads of the sharded engine
+static void stop_shards(t_monitor* monitor);
+
+// Find the shard owning a relation
+static inline t_shard* shard_of(t_monitor* monitor, char* rel);
+
+// Stage a command for a shard
+static void shard_push(t_shard* shard, const int op, char* orig, char* dest, char* rel);
+
+// Move staged commands into the shard queue
+static void shard_flush(t_shard* shard);
+
+// Wait until every shard applied all its commands
+static void shard_barrier(t_monitor* monitor);
+
+// Body of each worker thread
+static void* shard_main(void* arg);
+
+// Apply one command inside a shard. Return 1 if the worker has to stop
+static int shard_apply(t_shard* shard, t_shard_cmd* cmd);
+
+// Format report fragment of every relation owned by a shard
+static void shard_format(t_shard* shard);
+
+// Format the report merging the fragments of every shard in relation order
+static void report_shards(t_monitor* monitor);
+
+// Apply every pending command of peephole optimizer and engine
+static void flush_pending(t_monitor* monitor);
+
+// Copy a string into a buffer that may be too short
+static inline size_t copy_cut(char* buffer, const size_t size, const size_t len, const char* s, const size_t n);
+
+// Drop the summary of a changed relation
+static inline void drop_summary(t_rel_str* rel_str);
+
+// Release a reference to a relation summary
+static inline void release_summary(t_rel_summary* summary);
+
+// Take a reference to published snapshot
+static t_snapshot* acquire_snapshot(t_monitor* monitor);
+
+// Release a reference to a snapshot
+static void release_snapshot(t_snapshot* snap);
+
+// Build a snapshot of the current relations and publish it
+static void publish_snapshot(t_monitor* monitor);
+
+// Add summary of a relation to a snapshot, formatting it only if the relation changed
+static void snapshot_add(t_monitor* monitor, t_snapshot* snap, t_rel_str* rel_str);
+
+// Start reporter thread printing on output
+static void start_reporter(t_monitor* monitor, FILE* output);
+
+// Format last published snapshot into report text
+static void snapshot_text(t_monitor* monitor);
+
+// Wait until every queued snapshot is printed and stop reporter thread
+static void stop_reporter(t_monitor* monitor);
+
+// Queue a snapshot for the reporter thread
+static void reporter_push(t_monitor* monitor, t_snapshot* snap);
+
+// Body of the reporter thread
+static void* reporter_main(void* arg);
+
+// Wait until the reporter thread printed every queued snapshot
+static void reporter_wait(t_monitor* monitor);
+
+// Replay a binary trace, its magic line already read
+static void replay_trace(t_monitor* monitor, FILE* input, FILE* output);
+
+// Check the header of a binary trace against the input. Return 0 if its sizes cannot be right, 1 otherwise
+static int replay_header_valid(const t_trace_header* header, FILE* input);
+
+// Apply one record of a binary trace. Return 1 at end, -1 if the record is invalid, 0 otherwise
+static int replay_record(t_monitor* monitor, t_replay* replay, t_trace_record* rec, FILE* output);
+
+// Entity of the engine named by a dictionary id, looked up once until next addent or delent of it
+static inline char* replay_entity(t_monitor* monitor, t_replay* replay, const uint32_t id);
+
+// Format top k receivers of every relation
+static void topk(t_monitor* monitor, const int k);
+
+// Format top k receivers of one relation
+static void format_topk(t_monitor* monitor, t_rel_str* rel_str, const int k);
+
+// Restore the max heap of names rooted at i, greatest name on top
+static void topk_sift_down(char** heap, const uint32_t n, uint32_t i);
+
+// Build rank array of a relation
+static void rank_build(t_rel_str* rel_str);
+
+// Free rank array of a relation
+static void rank_free(t_rel_cold* cold);
+
+// Swap two positions of the rank array
+static inline void rank_swap(t_rel_str* rel_str, const int dest_pos, const uint32_t p, const uint32_t q);
+
+// Move a destination whose count was incremented to its new bucket
+static void rank_increment(t_rel_str* rel_str, const int dest_pos, const uint32_t c);
+
+// Move a destination whose count is going to be decremented to its new bucket
+static void rank_decrement(t_rel_str* rel_str, const int dest_pos, const uint32_t c);
+
+// Move a destination about to be removed out of the rank array
+static void rank_remove(t_rel_str* rel_str, const int dest_pos);
+
+// Rewind the cursors used to visit every relation in name order
+static void rel_rewind(t_monitor* monitor);
+
+// Return next relation in name order, among every shard if sharded
+static t_rel_str* rel_next(t_monitor* monitor);
+
+// Format the report text of one relation into a new summary
+static t_rel_summary* build_summary(t_monitor* monitor, t_rel_str* rel_str);
+
+// Format the delta report
+static void delta_report(t_monitor* monitor);
+
+// Format one relation of the delta report if its report text changed
+static void delta_rel(t_monitor* monitor, t_rel_str* rel_str);
+
+// Remember a removed relation for the next delta report
+static void note_removed(t_rel_table* table, t_rel_str* rel_str);
+
+// Compare function for qsort for removed relations
+static int removed_compare(const void* a, const void* b);
+
+// Insert a timer in the wheel
+static void timer_insert(t_monitor* monitor, t_timer* timer);
+
+// Advance logical time by one tick, firing expired timers
+static void timer_advance(t_monitor* monitor);
+
+// Free every timer
+static void free_timers(t_monitor* monitor);
+
+// Append the key of an entity in a relation sketch
+static size_t sketch_ent_key(t_monitor* monitor, t_text* key, const char* ent);
+
+// Check that an entity key still names a live entity
+static int sketch_key_alive(t_monitor* monitor, const char* key);
+
+// Find the sketch of a relation, creating it if asked
+static t_sketch* sketch_of(t_monitor* monitor, const char* rel, const int create);
+
+// Apply addrel or delrel in approximate mode
+static void sketch_apply_rel(t_monitor* monitor, char* orig, char* dest, char* rel, const int add);
+
+// Delete entity in approximate mode
+static void sketch_del_ent(t_monitor* monitor, char* ent);
+
+// Format the report from relation sketches
+static void sketch_report(t_monitor* monitor);
+
+// Format top k receivers of every relation from their sketch
+static void sketch_topk(t_monitor* monitor, const int k);
+
+// Free every relation sketch and the edge filter
+static void free_sketches(t_monitor* monitor);
+
+// Set up approximate mode
+static void sketch_init(t_monitor* monitor);
+
+// Print statistics of approximate mode
+static void sketch_stats(t_monitor* monitor, FILE* out);
+
+// Print every relation sketch
+static void sketch_dump(t_monitor* monitor, FILE* out);
+
+// Set up the hash engine
+static void hash_init(t_monitor* monitor);
+
+// Release the hash engine
+static void hash_free(t_monitor* monitor);
+
+// Send addrel or delrel by names to the hash engine
+static void hash_apply_rel(t_monitor* monitor, char* orig, char* dest, char* rel, const int add);
+
+// Send addrel or delrel of resolved entities to the hash engine
+static void hash_edge(t_monitor* monitor, char* orig, char* dest, char* rel, const int add);
+
+// Remove every relation of a resolved entity from the hash engine
+static void hash_del_ent(t_monitor* monitor, char* ent);
+
+// Format the report of the hash engine
+static void hash_report(t_monitor* monitor);
+
+// Format top k receivers of every relation of the hash engine
+static void hash_topk(t_monitor* monitor, const int k);
+
+// Print statistics of the hash engine
+static void hash_stats(t_monitor* monitor, FILE* out);
+
+// Print every relation of the hash engine
+static void hash_dump(t_monitor* monitor, FILE* out);
+
+// Find a relation of the hash engine by name, creating it if asked
+static t_hash_rel* hash_find_rel(t_monitor* monitor, const char* rel, const int create);
+
+// Find a destination of a hash engine relation, creating it if asked
+static t_hash_dest* hash_find_dest(t_monitor* monitor, t_hash_rel* rel, char* dest, const int create);
+
+// Add an origin to the set of a destination
+static int hash_add_orig(t_monitor* monitor, t_hash_dest* dest, char* orig);
+
+// Remove an origin from the set of a destination
+static int hash_del_orig(t_hash_dest* dest, char* orig);
+
+// Remove a destination without origins left, and its relation if it was the last one
+static void hash_drop_dest(t_monitor* monitor, t_hash_rel* rel, t_hash_dest* dest);
+
+// Slot of a key in a table keyed by pointers
+static uint32_t hash_probe(const void* slots, const size_t stride, const uint32_t size, const char* key, const uint64_t h, int* found);
+
+// Move every live slot of a table keyed by pointers into a new one
+static void* hash_rehash(void* slots, const size_t stride, const uint32_t size, const uint32_t new_size);
+
+// Move every live relation of the hash engine into a new relation table
+static void hash_resize_rels(t_monitor* monitor);
+
+// Size of a table being resized
+static inline uint32_t hash_next_size(const uint32_t count, const uint32_t size);
+
+// Hash of an entity, by its pointer
+static inline uint64_t hash_ptr(const char* ent);
+
+// Recompute the biggest count of a relation
+static void hash_max(t_hash_rel* rel);
+
+// Collect live relations of the hash engine in name order
+static size_t hash_sorted(t_monitor* monitor);
+
+// Collect destinations of a relation receiving at least min relations
+static size_t hash_collect(t_monitor* monitor, t_hash_rel* rel, const uint32_t min);
+
+// Compare function for qsort for relations of the hash engine
+static int hash_rel_compare(const void* a, const void* b);
+
+// Compare function for qsort for destinations of the hash engine
+static int hash_dest_compare(const void* a, const void* b);
+
+// Calculate a^n mod m
+static uint64_t power_mod(uint64_t a, uint64_t n, const uint64_t m);
+
+// Miller-Rabin round of n with base a
+static int witness(const uint64_t n, uint32_t s, const uint64_t d, const uint64_t a);
+
+// Miller-Rabin primality test
+static int is_prime(const uint32_t n);
+
+// Find next prime number after x
+static uint32_t next_prime(uint32_t x);
+
+// Write the whole state as commands, in the forked writer
+static int checkpoint_write(t_monitor* monitor, const char* path);
+
+// Write an addent for every entity of the dictionary
+static void save_entities(t_monitor* monitor, FILE* out);
+
+// Write an addent for every entity of the radix tree
+static void save_radix_tree(FILE* out, void* node);
+
+// Write an addent for an interned name
+static void save_interned(char* name, void* arg);
+
+// Write an addrel for every relation of a table
+static void save_rel_table(FILE* out, t_rel_table* table);
+
+// Write every relation of the sorted array engine
+static void array_save(t_monitor* monitor, FILE* out);
+
+// Write every relation of the hash engine
+static void hash_save(t_monitor* monitor, FILE* out);
+
+// Take entities and relations from the root record of the store left by a previous monitor
+static int load_store(t_monitor* monitor, const char* path);
+
+// Keep entities and relations in the root record of the store, then close it
+static void save_store(t_monitor* monitor);
+
+// Allocate memory of entities and relations, from the store of the monitor running on this thread if it has one
+static inline void* mem_alloc(const size_t size);
+
+// Allocate zeroed memory of entities and relations
+static inline void* mem_calloc(const size_t n, const size_t size);
+
+// Allocate cache line aligned memory of entities and relations
+static inline void* mem_aligned(const size_t size);
+
+// Resize memory of entities and relations
+static inline void* mem_realloc(void* p, const size_t size);
+
+// Free memory of entities and relations
+static inline void mem_free(void* p);
+
+// Ask for read ahead of an array about to be scanned, out-of-core mode only
+static inline void mem_prefetch(const void* p, const size_t len);
+
+// Seconds since an arbitrary start
+static inline double now_seconds(void);
+
+// Minor page faults of this process so far
+static long minor_faults(void);
+
+// Check if the cpu supports AVX2, run once whatever the monitors created
+static void detect_avx2(void);
+
+// END OF FUNCTION PROTOTYPES
+
+// GLOBAL VARIABLES
+
+static int use_avx2;                    // 1 if the cpu supports AVX2 scan of destination counts, same for every monitor
+static pthread_once_t avx2_once = PTHREAD_ONCE_INIT;    // monitors can be created by concurrent threads
+
+static char hash_deleted;               // its address marks deleted slots of the hash engine, as the tombstone item of the prototype
+static char rel_slot_deleted;           // its address marks deleted slots of the side table of the relation perfect hash
+
+static __thread t_store* mem_store;     // store of the monitor running on this thread, NULL if entities and relations are on the heap
+
+// sorted relation arrays, with batches, shards, snapshots and delta reports
+static const t_engine array_engine = {
+    .name = "array", .init = array_init, .free = array_free, .rel = array_rel, .edge = array_edge,
+    .del_ent = array_del_ent, .flush = array_flush, .report = array_report, .topk = topk, .stats = array_stats, .dump = array_dump,
+    .save = array_save
+};
+
+// open addressing hash tables with double hashing, ported from Structure Testing/Hash_Testing
+static const t_engine hash_engine = {
+    .name = "hash", .init = hash_init, .free = hash_free, .rel = hash_apply_rel, .edge = hash_edge,
+    .del_ent = hash_del_ent, .flush = NULL, .report = hash_report, .topk = hash_topk, .stats = hash_stats, .dump = hash_dump,
+    .save = hash_save
+};
+
+// count-min sketches of approximate mode, names are needed to build their keys
+static const t_engine sketch_engine = {
+    .name = "sketch", .init = sketch_init, .free = free_sketches, .rel = sketch_apply_rel, .edge = NULL,
+    .del_ent = sketch_del_ent, .flush = NULL, .report = sketch_report, .topk = sketch_topk, .stats = sketch_stats, .dump = sketch_dump,
+    .save = NULL
+};
+
+// END OF GLOBAL VARIABLES
+
+
+
+/*
+ * Print statistics of the monitor
+ */
+void monitor_print_stats(t_monitor* monitor, FILE* out) {
+    
+    mem_store = monitor->store;
+    flush_pending(monitor);                                 // engine structures are read below
+    
+    fprintf(out, "engine: %s\n", monitor->engine->name);
+    fprintf(out, "entities: %" PRIu32 "\n", monitor->ent_count);
+    monitor->engine->stats(monitor, out);
+    if (monitor->peep_mode)
+        fprintf(out, "peephole: %zu commands in, %zu sent to engine\n", monitor->peep_in, monitor->peep_out);
+    if (monitor->snapshot_mode)
+        fprintf(out, "snapshots: %zu published, %zu relation summaries formatted\n", monitor->snapshot_count, monitor->summary_count);
+    if (monitor->timer_count > 0 || monitor->timer_expired > 0)
+        fprintf(out, "ttl: tick %" PRIu64 ", %zu pending, %zu expired\n", monitor->now, monitor->timer_count, monitor->timer_expired);
+    if (monitor->checkpoint_done > 0 || monitor->checkpoint_failed > 0)
+        fprintf(out, "checkpoints: %zu written, %zu failed, longest pause %.3f ms\n", monitor->checkpoint_done, 
+                monitor->checkpoint_failed, monitor->checkpoint_max_pause * 1e3);
+    if (monitor->store != NULL)
+        store_print_stats(monitor->store, out);
+}
+
+/*
+ * Print entity array
+ */
+static void print_ent_arr(t_monitor* monitor, FILE* out) {
+    
+    int i = 0;
+    
+    if (monitor->ent_dict == DICT_RADIX)
+        print_radix_tree(out, monitor->radix_root, &i);     // in order visit gives ascii order
+    else if (monitor->ent_dict == DICT_HASH) {
+        monitor->ent_count = 0;                             // names are listed in ent_arr only to be sorted
+        intern_visit(monitor->intern, collect_interned, monitor);
+        qsort(monitor->ent_arr, monitor->ent_count, sizeof(char*), string_compare);
+        for (i=0; i<monitor->ent_count; i++)
+            fprintf(out, "ent_arr[%d] = %s\n", i, monitor->ent_arr[i]);
+        monitor->ent_count = intern_count(monitor->intern);
+    }
+    else
+        for (i=0; i<monitor->ent_count; i++)                // for each element of entity array
+            fprintf(out, "ent_arr[%d] = %s\n", i, monitor->ent_arr[i]);        
+    
+    fprintf(out, "\n");
+}
+
+/*
+ * Print destination structure in position pos of the relation
+ */
+static void print_dest_str(FILE* out, const t_rel_str* el, const int pos) {
+    
+    int i;
+    
+    fprintf(out, "%s\n", el->dest_arr[pos]);                                  // print destination name
+    fprintf(out, "\t\tdest of count: %" PRIu32 "\n", el->dest_of_count[pos]); // print number of origin
+    fprintf(out, "\t\tdest of arr ->");                                       // print origins' names
+    if (el->dest_of[pos].is_hash) {                                         // hash set, slot order
+        for (i=0; i<el->dest_of[pos].dest_of_size; i++)
+            if (el->dest_of[pos].dest_of[i] != NULL)
+                fprintf(out, " %s ", el->dest_of[pos].dest_of[i]);
+    }
+    else
+        for (i=0; i<el->dest_of_count[pos]; i++)
+            fprintf(out, " %s ", el->dest_of[pos].dest_of[i]);
+    fprintf(out, "\n");
+}
+
+/*
+ * Print relation structure
+ */
+static void print_rel_str(FILE* out, const t_rel_str* el) {
+    
+    int i;
+    
+    fprintf(out, "%s\n", el->cold->rel);                              // print relation name
+    fprintf(out, "\tmost dest entity ->");                            // print most destination array
+    for (i=0; i<el->most_dest_count; i++) 
+        fprintf(out, " %s", el->most_dest_arr[i]);
+    fprintf(out, "\n\tmax rel received: %" PRIu32 "\n", el->n_most_dest);    // print number of relation at most
+    fprintf(out, "\tcurr total dest: %" PRIu32 "\n", el->dest_count);       // print number of destination
+    for (i=0; i<el->dest_count; i++) {                          // print destination array
+        fprintf(out, "\tdest_arr[%d] -> ", i);
+        print_dest_str(out, el, i);
+    }
+}
+
+/*
+ * Print relation array
+ */
+static void print_rel_arr(FILE* out, t_rel_table* table) {
+    
+    int i;
+    for (i=0; i<table->rel_count; i++) {                   // print each relation structure
+        fprintf(out, "rel_elem[%d] -> ", i);
+        print_rel_str(out, &table->rel_arr[i]);
+    }
+    
+    fprintf(out, "\n");
+}
+
+/*
+ * Free passed relation structure
+ */
+static inline void free_rel_str(t_rel_str* rel_str) {
+    
+    int i;
+    
+    mem_free(rel_str->most_dest_arr);               // free most destination array. String inside are pointer to entity array, not allocated so no need to be freed
+        
+    for (i=0; i<rel_str->dest_count; i++)           // free each destination_of array for every destination. String inside are pointer not allocated.
+        mem_free(rel_str->dest_of[i].dest_of);
+
+    mem_free(rel_str->dest_arr);                    // free destination arrays
+    mem_free(rel_str->dest_of_count);
+    mem_free(rel_str->dest_of);
+    name_free(rel_str->cold->rel);                  // free relation name which was allocated
+    rank_free(rel_str->cold);
+    release_summary(rel_str->cold->reported);
+    mem_free(rel_str->cold);
+    release_summary(rel_str->summary);              // snapshots may still be holding it
+}
+
+/*
+ * Release all memory of the monitor, pending commands are dropped. 
+ * In out-of-core mode they are applied instead, and entities and relations stay in the store for the next monitor
+ */
+void monitor_destroy(t_monitor* monitor) {
+    
+    int i;
+    
+    monitor_checkpoint_poll(monitor, 1);            // a running checkpoint is not abandoned
+    free(monitor->checkpoint_path);
+    mem_store = monitor->store;
+    
+    if (monitor->store != NULL) {
+        flush_pending(monitor);
+        save_store(monitor);
+    }
+    else {
+        // free entity array
+        if (monitor->ent_dict == DICT_RADIX)
+            free_radix_tree(monitor->radix_root);   // free every node and every name in the tree
+        else if (monitor->ent_dict == DICT_HASH)
+            intern_destroy(monitor->intern);        // free table and every name inside
+        else
+            for (i=0; i<monitor->ent_count; i++)    // free each string in entity array
+                name_free(monitor->ent_arr[i]);
+        mem_free(monitor->ent_arr);                 // free entity array
+        
+        // free relations of the engine
+        monitor->engine->free(monitor);
+    }
+    
+    free(monitor->report_text.buf);                 // free report text
+    free(monitor->line);
+    for (i=0; i<monitor->batch_count; i++)          // free buffered commands
+        name_copy_free(&monitor->batch_arr[i].rel);
+    free(monitor->batch_arr);
+    
+    free_peep_names(monitor);                       // free peephole optimizer
+    free(monitor->peep_ent_arr);
+    free(monitor->peep_rel_arr);
+    free(monitor->peep_ent_index);
+    free(monitor->peep_rel_index);
+    
+    free(monitor->topk_arr);
+    free(monitor->summary_text.buf);
+    free(monitor->delta_arr);
+    free_timers(monitor);
+    
+    if (monitor->snapshot_mode) {                   // free published snapshot, relations released their summaries above
+        release_snapshot(monitor->snapshot);
+        pthread_mutex_destroy(&monitor->snapshot_lock);
+        free(monitor->report_queue);
+    }
+    free(monitor);
+}
+
+/*
+ * Create a monitor with the passed options, default ones if NULL. 
+ * Set up all array and their sizes
+ */
+t_monitor* monitor_create(const t_monitor_config* config) {
+    
+    int created = 0;
+    t_monitor_config default_config;
+    t_monitor* monitor = calloc(1, sizeof(t_monitor));
+    
+    if (config == NULL) {
+        monitor_default_config(&default_config);
+        config = &default_config;
+    }
+    
+    monitor->ent_dict = config->ent_dict;
+    monitor->batch_mode = config->batch_mode;
+    monitor->peep_mode = config->peep_mode;
+    monitor->shard_count = (config->shard_count > 0) ? config->shard_count : 0;
+    monitor->snapshot_mode = config->snapshot_mode;
+    monitor->delta_mode = config->delta_mode;
+    monitor->sketch_eps = (config->sketch_eps > 0 && config->sketch_eps < 1) ? config->sketch_eps : 0;
+    monitor->sketch_delta = (config->sketch_delta > 0 && config->sketch_delta < 1) ? config->sketch_delta : 0.01;
+    monitor->sketch_edges = (config->sketch_edges > 0) ? config->sketch_edges : 1 << 20;
+    
+    // approximate mode is an engine of its own
+    if (monitor->sketch_eps > 0 && config->engine == ENGINE_HASH)
+        fprintf(stderr, "hash engine is not available with approximate mode, ignored\n");
+    if (monitor->sketch_eps > 0)
+        monitor->engine = &sketch_engine;
+    else if (config->engine == ENGINE_HASH)
+        monitor->engine = &hash_engine;
+    else
+        monitor->engine = &array_engine;
+    
+    // sketches replace the relation tables that batches, shards, snapshots and delta reports work on,
+    // peephole rewrites rely on delent removing relations of origins too
+    if (monitor->sketch_eps > 0 && (monitor->batch_mode || monitor->peep_mode || monitor->shard_count > 0 || 
+                                    monitor->snapshot_mode || monitor->delta_mode)) {
+        fprintf(stderr, "batch, peephole, shards, snapshot and delta reports are not available with approximate mode, ignored\n");
+        monitor->batch_mode = monitor->peep_mode = monitor->shard_count = monitor->snapshot_mode = monitor->delta_mode = 0;
+    }
+    
+    // hash tables are not ordered nor split, so they have no merges, shards, summaries nor delta reports
+    if (monitor->engine == &hash_engine && (monitor->batch_mode || monitor->shard_count > 0 || 
+                                            monitor->snapshot_mode || monitor->delta_mode)) {
+        fprintf(stderr, "batch, shards, snapshot and delta reports are not available with hash engine, ignored\n");
+        monitor->batch_mode = monitor->shard_count = monitor->snapshot_mode = monitor->delta_mode = 0;
+    }
+    
+    // merges need the whole relation table, shards already apply commands off the main thread
+    if (monitor->batch_mode && monitor->shard_count > 0) {
+        fprintf(stderr, "batch mode is not available with shards, ignored\n");
+        monitor->batch_mode = 0;
+    }
+    
+    // delta report is formatted and printed by the thread reading commands
+    if (monitor->delta_mode && monitor->snapshot_mode) {
+        fprintf(stderr, "snapshot reports are not available with delta reports, ignored\n");
+        monitor->snapshot_mode = 0;
+    }
+    
+    // the store holds one relation table of sorted arrays and a dictionary of stored names
+    if (config->store_path != NULL && (monitor->engine != &array_engine || monitor->shard_count > 0 || 
+                                       monitor->snapshot_mode || monitor->delta_mode || monitor->ent_dict == DICT_HASH))
+        fprintf(stderr, "out-of-core mode is not available with hash engine, approximate mode, hash dictionary, shards, snapshot and delta reports, ignored\n");
+    else if (config->store_path != NULL && (monitor->store = store_open(config->store_path, &created)) == NULL)
+        fprintf(stderr, "out-of-core file %s cannot be opened, locked by another monitor or not a store, ignored\n", config->store_path);
+    mem_store = monitor->store;
+    
+    // entities and relations left in the store by a previous monitor, or empty ones
+    if (monitor->store == NULL || created || !load_store(monitor, config->store_path)) {
+        
+        // initialization of entity array
+        monitor->ent_count = 0;
+        monitor->ent_size = ENTITY_ARRAY_SIZE;
+        monitor->ent_arr = mem_calloc(monitor->ent_size, sizeof(char*));
+        monitor->radix_root = NULL;
+        if (monitor->ent_dict == DICT_HASH) {
+            monitor->intern = intern_create();
+            monitor->intern_self = intern_join(monitor->intern);
+        }
+        
+        // initialization of the relations of the engine
+        monitor->engine->init(monitor);
+    }
+    
+    // initialization of report text
+    monitor->report_text.len = 0;
+    monitor->report_text.size = TEXT_SIZE;
+    monitor->report_text.buf = malloc(monitor->report_text.size);
+    monitor->line_size = LINE_SIZE;
+    monitor->line = malloc(monitor->line_size);
+    monitor->summary_text.len = 0;
+    monitor->summary_text.size = TEXT_SIZE;
+    monitor->summary_text.buf = malloc(monitor->summary_text.size);
+    
+    // initialization of buffered commands
+    monitor->batch_count = 0;
+    monitor->batch_size = BATCH_ARRAY_SIZE;
+    monitor->batch_arr = malloc(monitor->batch_size * sizeof(t_batch_op));
+    monitor->batch_seq = 0;
+    
+    // initialization of peephole optimizer
+    monitor->peep_ent_count = monitor->peep_rel_count = 0;
+    monitor->peep_ent_size = monitor->peep_rel_size = PEEP_INDEX_SIZE;
+    monitor->peep_ent_arr = malloc(monitor->peep_ent_size * sizeof(t_peep_ent));
+    monitor->peep_rel_arr = malloc(monitor->peep_rel_size * sizeof(t_peep_rel));
+    monitor->peep_ent_index_size = monitor->peep_rel_index_size = PEEP_INDEX_SIZE << 1;
+    monitor->peep_ent_index = calloc(monitor->peep_ent_index_size, sizeof(int));
+    monitor->peep_rel_index = calloc(monitor->peep_rel_index_size, sizeof(int));
+    monitor->peep_seq = 1;
+    monitor->peep_in = monitor->peep_out = 0;
+    
+    // check once if the counts scan can be vectorized
+    pthread_once(&avx2_once, detect_avx2);
+    
+    // initialization of snapshots, an empty one is published so that readers always find one
+    if (monitor->snapshot_mode) {
+        pthread_mutex_init(&monitor->snapshot_lock, NULL);
+        monitor->snapshot_count = monitor->summary_count = 0;
+        monitor->snapshot = NULL;
+        publish_snapshot(monitor);
+        monitor->report_queue = malloc(REPORT_QUEUE_SIZE * sizeof(t_snapshot*));
+    }
+    
+    return monitor;
+}
+
+/*
+ * Fill passed options with the default ones: array dictionary and engine, commands applied one by one on one thread
+ */
+void monitor_default_config(t_monitor_config* config) {
+    
+    config->ent_dict = MONITOR_DICT_ARRAY;
+    config->engine = MONITOR_ENGINE_ARRAY;
+    config->batch_mode = 0;
+    config->peep_mode = 0;
+    config->shard_count = 0;
+    config->snapshot_mode = 0;
+    config->delta_mode = 0;
+    config->sketch_eps = 0;
+    config->sketch_delta = 0.01;
+    config->sketch_edges = 1 << 20;
+    config->store_path = NULL;
+}
+
+/*
+ * Check if the counts scan can be vectorized on this cpu
+ */
+static void detect_avx2(void) {
+    
+#ifdef SIMD_SCAN
+    __builtin_cpu_init();
+    use_avx2 = __builtin_cpu_supports("avx2");
+#else
+    use_avx2 = 0;
+#endif
+}
+
+/*
+ * Set up an empty relation table. Perfect hash is empty until first relation
+ */
+static void init_rel_table(t_rel_table* table) {
+    
+    table->rel_count = 0;
+    table->rel_size = RELATION_ARRAY_SIZE;
+    table->rel_arr = mem_aligned(table->rel_size * sizeof(t_rel_str));
+    
+    table->hash_seed = NULL;
+    table->hash_slot = NULL;
+    table->hash_buckets = 0;
+    table->hash_size = 0;
+    table->side_slot = NULL;
+    table->side_size = 0;
+    table->hash_changes = 0;
+    table->hash_valid = 0;
+    table->hash_rebuilds = 0;
+    table->hash_time = 0;
+    
+    table->removed = NULL;
+    table->removed_count = table->removed_size = 0;
+}
+
+/*
+ * Free every relation of a table
+ */
+static void free_rel_table(t_rel_table* table) {
+    
+    int i;
+    
+    for (i=0; i<table->rel_count; i++) 
+        free_rel_str(&table->rel_arr[i]);           // free each relation structure
+       
+    mem_free(table->rel_arr);                       // free relation array
+    mem_free(table->hash_seed);                     // free perfect hash
+    mem_free(table->hash_slot);
+    mem_free(table->side_slot);
+    
+    for (i=0; i<table->removed_count; i++) {        // free relations waiting for delta report
+        name_free(table->removed[i].rel);
+        release_summary(table->removed[i].reported);
+    }
+    free(table->removed);
+}
+
+/*
+ * Search for a string in the passed array. 
+ * Return position of the corrisponding string if found, -1 else
+ */
+static int search_string_array(char** arr, const size_t elem_count, char* target) {
+    
+    int bottom = 0;
+    int mid, c;
+    int top = elem_count - 1;
+    const size_t len = strlen(target);                  // stored names carry their length, target is measured once
+    
+    while(bottom <= top) {      
+        mid = (bottom + top)>>1;                        // mid = (bot + top) / 2
+        c = name_compare_len(arr[mid], target, len);
+        if (c == 0) 
+            return mid;
+        else if (c > 0)                                 // mid is bigger than target
+            top = mid - 1;
+        else                                            // mid is smaller than target
+            bottom = mid + 1;
+    }
+    
+    return -1;
+}
+
+/*
+ * Compare function for qsort for array of stored names
+ */
+static int string_compare(const void* a, const void* b) { 
+    
+    return name_compare(*(const char**)a, *(const char**)b);    // ascii order, as strcmp
+} 
+
+/*
+ * Allocate a stored name of len characters, terminated. Return its characters
+ */
+static char* name_new(const char* s, const size_t len) {
+    
+    t_name* name = mem_alloc(sizeof(t_name) + len + 1);
+    
+    name->len = len;
+    memcpy(name->str, s, len);
+    name->str[len] = '\0';
+    
+    return name->str;
+}
+
+/*
+ * Free a stored name from its characters
+ */
+static inline void name_free(char* name) {
+    
+    if (name != NULL)
+        mem_free(name - offsetof(t_name, str));
+}
+
+/*
+ * Length of a stored name, read before its characters
+ */
+static inline uint32_t name_len(const char* name) {
+    
+    return ((const t_name*)(name - offsetof(t_name, str)))->len;
+}
+
+/*
+ * Order of two stored names as strcmp, lengths decide only when one is a prefix of the other
+ */
+static inline int name_compare(const char* a, const char* b) {
+    
+    return name_compare_len(a, b, name_len(b));
+}
+
+/*
+ * Order of a stored name and a string of known length, as strcmp
+ */
+static inline int name_compare_len(const char* stored, const char* s, const size_t len) {
+    
+    const size_t stored_len = name_len(stored);
+    int c = memcmp(stored, s, (stored_len < len) ? stored_len : len);
+    
+    if (c != 0)
+        return c;
+    return (stored_len > len) - (stored_len < len);
+}
+
+/*
+ * Copy a name into a structure, inline if it fits, spilled to the heap else. Previous copy has to be freed
+ */
+static inline void name_copy_set(t_name_copy* copy, const char* s, const size_t len) {
+    
+    char* dst = copy->buf;
+    
+    if (len >= NAME_INLINE_SIZE)
+        dst = copy->heap = malloc(len + 1);
+    memcpy(dst, s, len);
+    dst[len] = '\0';
+    copy->len = len;
+}
+
+/*
+ * Characters of a copied name, terminated
+ */
+static inline char* name_copy_str(const t_name_copy* copy) {
+    
+    return (copy->len < NAME_INLINE_SIZE) ? (char*)copy->buf : copy->heap;
+}
+
+/*
+ * Release a copied name spilled to the heap, it is left empty
+ */
+static inline void name_copy_free(t_name_copy* copy) {
+    
+    if (copy->len >= NAME_INLINE_SIZE)
+        free(copy->heap);
+    copy->len = 0;
+    copy->buf[0] = '\0';
+}
+
+/*
+ * Order of two copied names as strcmp
+ */
+static inline int name_copy_compare(const t_name_copy* a, const t_name_copy* b) {
+    
+    int c = memcmp(name_copy_str(a), name_copy_str(b), (a->len < b->len) ? a->len : b->len);
+    
+    if (c != 0)
+        return c;
+    return (a->len > b->len) - (a->len < b->len);
+}
+
+/*
+ * Check if a copied name equals a string of known length
+ */
+static inline int name_copy_equal(const t_name_copy* copy, const char* s, const size_t len) {
+    
+    return copy->len == len && memcmp(name_copy_str(copy), s, len) == 0;
+}
+
+/*
+ * Reallocate passed array of string with double the size. 
+ * Return new max size.
+ */
+static inline char** realloc_string_array(char** arr, uint32_t *max_size) {
+    
+    *max_size = (*max_size) << 1;                               // double the size
+    
+    return mem_realloc(arr, (*max_size) * sizeof(char*));
+}
+
+/*
+ * Add entity into entity array in order. Double the size if it's full.
+ */
+static void add_entity(t_monitor* monitor, char* new_ent) {
+   
+    int created;
+    
+    if (monitor->ent_dict == DICT_RADIX) 
+        insert_radix_tree(monitor, new_ent);
+    
+    else if (monitor->ent_dict == DICT_HASH) {
+        intern_insert(monitor->intern, monitor->intern_self, new_ent, &created);
+        monitor->ent_count += created;
+    }
+    
+    else if (search_string_array(monitor->ent_arr, monitor->ent_count, new_ent) == -1) { // if new entity it's not already in the array
+
+        if (monitor->ent_count == monitor->ent_size) 
+            monitor->ent_arr = realloc_string_array(monitor->ent_arr, &monitor->ent_size); // double size if array is full
+
+        monitor->ent_arr[monitor->ent_count++] = name_new(new_ent, strlen(new_ent));  // exact size, any length
+        qsort(monitor->ent_arr, monitor->ent_count, sizeof(char*), string_compare); // sorting by ascii order
+     }
+}
+
+/*
+ * Search for an entity in the entity dictionary. 
+ * Return the stored name, which is shared by every structure referring to the entity, NULL if not found
+ */
+static char* search_entity(t_monitor* monitor, char* target) {
+    
+    int pos;
+    
+    if (monitor->ent_dict == DICT_RADIX)
+        return search_radix_tree(monitor, target);
+    if (monitor->ent_dict == DICT_HASH)
+        return intern_search(monitor->intern, monitor->intern_self, target);
+    
+    pos = search_string_array(monitor->ent_arr, monitor->ent_count, target);
+    return (pos == -1) ? NULL : monitor->ent_arr[pos];
+}
+
+/*
+ * Remove entity from the entity dictionary and release its name
+ * Entity has to be present
+ */
+static void remove_entity(t_monitor* monitor, char* ent) {
+    
+    int ent_pos;
+    
+    if (monitor->ent_dict == DICT_RADIX) {
+        delete_radix_tree(monitor, ent);
+        return;
+    }
+    if (monitor->ent_dict == DICT_HASH) {            // name is released once no thread can read it
+        monitor->ent_count -= intern_delete(monitor->intern, monitor->intern_self, ent);
+        return;
+    }
+    
+    // drop it and shift the following ones left, order is kept
+    ent_pos = search_string_array(monitor->ent_arr, monitor->ent_count, ent);
+    name_free(monitor->ent_arr[ent_pos]);
+    memmove(&monitor->ent_arr[ent_pos], &monitor->ent_arr[ent_pos+1], (monitor->ent_count - ent_pos - 1) * sizeof(char*));
+    monitor->ent_count--;
+}
+
+/*
+ * Append an interned name to entity array, used to list the interning table
+ */
+static void collect_interned(char* name, void* arg) {
+    
+    t_monitor* monitor = (t_monitor*)arg;
+    
+    if (monitor->ent_count == monitor->ent_size) 
+        monitor->ent_arr = realloc_string_array(monitor->ent_arr, &monitor->ent_size);     // double size if array is full
+    monitor->ent_arr[monitor->ent_count++] = name;
+}
+
+/*
+ * Print radix tree in order, i is the running position
+ */
+static void print_radix_tree(FILE* out, void* node, int* i) {
+    
+    t_radix_node* q;
+    
+    if (node == NULL)
+        return;
+    
+    if ((uintptr_t)node & 1) {                              // internal node, visit left then right
+        q = (t_radix_node*)((uintptr_t)node - 1);
+        print_radix_tree(out, q->child[0], i);
+        print_radix_tree(out, q->child[1], i);
+    }
+    else
+        fprintf(out, "ent_arr[%d] = %s\n", (*i)++, (char*)node);
+}
+
+/*
+ * Free radix tree and every entity name inside
+ */
+static void free_radix_tree(void* node) {
+    
+    t_radix_node* q;
+    
+    if (node == NULL)
+        return;
+    
+    if ((uintptr_t)node & 1) {
+        q = (t_radix_node*)((uintptr_t)node - 1);
+        free_radix_tree(q->child[0]);
+        free_radix_tree(q->child[1]);
+        mem_free(q);
+    }
+    else
+        name_free(node);
+}
+
+/*
+ * Search for an entity in the radix tree. 
+ * Only critical bytes are tested while walking down, one strcmp at the leaf.
+ * Return the stored name if found, NULL else
+ */
+static char* search_radix_tree(t_monitor* monitor, char* target) {
+    
+    const uint8_t* ubytes = (const uint8_t*)target;
+    const size_t len = strlen(target);
+    uint8_t c;
+    void* p = monitor->radix_root;
+    t_radix_node* q;
+    
+    if (p == NULL)
+        return NULL;
+    
+    while ((uintptr_t)p & 1) {                              // walk down until a leaf is reached
+        q = (t_radix_node*)((uintptr_t)p - 1);
+        c = (q->byte < len) ? ubytes[q->byte] : 0;
+        p = q->child[(1 + (q->otherbits | c)) >> 8];        // direction given by the critical bit
+    }
+    
+    return (strcmp(target, (char*)p) == 0) ? (char*)p : NULL;
+}
+
+/*
+ * Insert entity into the radix tree. Does nothing if it's already present.
+ * Name is stored with its exact length instead of a fixed size slot
+ */
+static void insert_radix_tree(t_monitor* monitor, char* new_ent) {
+    
+    const uint8_t* ubytes = (const uint8_t*)new_ent;
+    const size_t len = strlen(new_ent);
+    uint8_t c, *p_bytes;
+    uint32_t newbyte, newotherbits;
+    int direction, newdirection;
+    void* p = monitor->radix_root;
+    void** wherep;
+    char* name;
+    t_radix_node *q, *newnode;
+    
+    name = name_new(new_ent, len);
+    
+    if (p == NULL) {                                        // empty tree, name is the root
+        monitor->radix_root = name;
+        monitor->ent_count++;
+        return;
+    }
+    
+    // step 1: find the best matching leaf
+    while ((uintptr_t)p & 1) {
+        q = (t_radix_node*)((uintptr_t)p - 1);
+        c = (q->byte < len) ? ubytes[q->byte] : 0;
+        p = q->child[(1 + (q->otherbits | c)) >> 8];
+    }
+    p_bytes = (uint8_t*)p;
+    
+    // step 2: find the critical bit between new name and the leaf
+    for (newbyte=0; newbyte<len; newbyte++) 
+        if (p_bytes[newbyte] != ubytes[newbyte]) {
+            newotherbits = p_bytes[newbyte] ^ ubytes[newbyte];
+            goto different_byte_found;
+        }
+    
+    if (p_bytes[newbyte] != 0) {
+        newotherbits = p_bytes[newbyte];
+        goto different_byte_found;
+    }
+    
+    name_free(name);                                        // already present
+    return;
+    
+different_byte_found:
+    
+    while (newotherbits & (newotherbits - 1))               // keep only the most significant differing bit
+        newotherbits &= newotherbits - 1;
+    newotherbits ^= 255;
+    c = p_bytes[newbyte];
+    newdirection = (1 + (newotherbits | c)) >> 8;
+    
+    // step 3: create new internal node and hang it in the right place
+    newnode = mem_alloc(sizeof(t_radix_node));
+    newnode->byte = newbyte;
+    newnode->otherbits = newotherbits;
+    newnode->child[1 - newdirection] = name;
+    
+    wherep = &monitor->radix_root;
+    for (;;) {
+        p = *wherep;
+        if (!((uintptr_t)p & 1))
+            break;
+        q = (t_radix_node*)((uintptr_t)p - 1);
+        if (q->byte > newbyte)
+            break;
+        if (q->byte == newbyte && q->otherbits > newotherbits)
+            break;
+        c = (q->byte < len) ? ubytes[q->byte] : 0;
+        direction = (1 + (q->otherbits | c)) >> 8;
+        wherep = q->child + direction;
+    }
+    
+    newnode->child[newdirection] = *wherep;
+    *wherep = (void*)((uintptr_t)newnode + 1);
+    monitor->ent_count++;
+}
+
+/*
+ * Delete entity from the radix tree and free its name. Does nothing if it's not present
+ */
+static void delete_radix_tree(t_monitor* monitor, char* ent) {
+    
+    const uint8_t* ubytes = (const uint8_t*)ent;
+    const size_t len = strlen(ent);
+    uint8_t c;
+    int direction = 0;
+    void* p = monitor->radix_root;
+    void** wherep = &monitor->radix_root;
+    void** whereq = NULL;
+    t_radix_node* q = NULL;
+    
+    if (p == NULL)
+        return;
+    
+    while ((uintptr_t)p & 1) {                              // walk down remembering parent slot
+        whereq = wherep;
+        q = (t_radix_node*)((uintptr_t)p - 1);
+        c = (q->byte < len) ? ubytes[q->byte] : 0;
+        direction = (1 + (q->otherbits | c)) >> 8;
+        wherep = q->child + direction;
+        p = *wherep;
+    }
+    
+    if (strcmp(ent, (char*)p) != 0)
+        return;
+    name_free(p);
+    
+    if (whereq == NULL)                                     // it was the only entity
+        monitor->radix_root = NULL;
+    else {                                                  // sibling takes the place of the parent
+        *whereq = q->child[1 - direction];
+        mem_free(q);
+    }
+    monitor->ent_count--;
+}
+
+/*
+ * Search for a relation in the relation table. 
+ * Uses the perfect hash when available: one hash and one compare, then the side table for relations created
+ * since last rebuild. Binary search else.
+ * Return position if found, -1 else
+ */
+static int search_relation(t_rel_table* table, char* target) {
+    
+    uint64_t h;
+    t_rel_slot* slot;
+    
+    if (table->hash_valid) {
+        h = hash_string(target);
+        slot = relation_hash_slot(table, h);
+        if (slot->rel != NULL && strcmp(slot->rel, target) == 0)
+            return slot->cold->pos;
+        if (table->hash_changes == 0)                       // nothing created nor removed since last rebuild
+            return -1;
+        slot = relation_side_find(table, h, target);
+        return (slot != NULL) ? slot->cold->pos : -1;
+    }
+    
+    int bottom = 0;
+    int mid;
+    int top = table->rel_count - 1;
+    
+    while(bottom <= top) {      
+        mid = (bottom + top)>>1;                                // mid = (bot + top) / 2
+        if (strcmp(table->rel_arr[mid].cold->rel, target) == 0) 
+            return mid;
+        else if (strcmp(table->rel_arr[mid].cold->rel, target) > 0)    // mid is bigger than target
+            top = mid - 1;
+        else if (strcmp(table->rel_arr[mid].cold->rel, target) < 0)    // mid is smaller than target
+            bottom = mid + 1;
+    }
+    
+    return -1;
+}
+
+/*
+ * Hash a string with FNV-1a
+ */
+static inline uint64_t hash_string(const char* s) {
+    
+    uint64_t h = 14695981039346656037ULL;          // FNV offset basis
+    
+    for (; *s; s++) {
+        h ^= (uint8_t)*s;
+        h *= 1099511628211ULL;                      // FNV prime
+    }
+    
+    return h;
+}
+
+/*
+ * Mix hash with a bucket seed to find its slot, finalizer of splitmix64
+ */
+static inline uint64_t hash_mix(uint64_t h, uint32_t seed) {
+    
+    h ^= (uint64_t)seed * 0x9E3779B97F4A7C15ULL;
+    h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    h = (h ^ (h >> 27)) * 0x94D049BB133111EBULL;
+    
+    return h ^ (h >> 31);
+}
+
+/*
+ * Rebuild the minimal perfect hash over the relation names, with an empty side table.
+ * Slots point to cold parts, so shifts of relation array do not need a rebuild. Created and removed relations
+ * are kept apart until they are HASH_CHANGE_PERCENTAGE of the relations, so a rebuild is paid by that many changes
+ */
+static void build_relation_hash(t_rel_table* table) {
+    
+    int i;
+    size_t bucket_count, side_size = HASH_SIDE_MIN;
+    uint64_t* hash;
+    struct timespec start, end;
+    
+    table->hash_valid = 0;
+    if (table->rel_count == 0)
+        return;
+    
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    
+    while (side_size < (table->rel_count * HASH_CHANGE_PERCENTAGE / 100) << 1)    // changes fill at most half of it
+        side_size <<= 1;
+    if (table->side_size != side_size) {
+        table->side_size = side_size;
+        mem_free(table->side_slot);
+        table->side_slot = mem_alloc(side_size * sizeof(t_rel_slot));
+    }
+    memset(table->side_slot, 0, side_size * sizeof(t_rel_slot));
+    table->hash_changes = 0;
+    table->hash_size = table->rel_count;
+    
+    hash = malloc(table->rel_count * sizeof(uint64_t));
+    for (i=0; i<table->rel_count; i++)                             // hash every relation only once
+        hash[i] = hash_string(table->rel_arr[i].cold->rel);
+    
+    // hash and displace, more buckets make it easier to find seeds
+    for (bucket_count = table->rel_count / HASH_BUCKET_LOAD + 1; !table->hash_valid && bucket_count <= table->rel_count << 2; bucket_count <<= 1) 
+        table->hash_valid = try_relation_hash(table, hash, bucket_count);
+    
+    free(hash);
+    
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    table->hash_rebuilds++;
+    table->hash_time += (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9;
+}
+
+/*
+ * Try to build the perfect hash with the passed number of buckets. 
+ * Buckets are placed from the biggest, searching a seed that sends all their relations into free slots.
+ * Return 1 if succeeded, 0 else
+ */
+static int try_relation_hash(t_rel_table* table, uint64_t* hash, size_t bucket_count) {
+    
+    int i, j, k, b;
+    int free_slots = table->rel_count;  // slots not taken yet
+    uint32_t seed;
+    size_t attempts;                    // seeds tried for the current bucket
+    int* bucket_start;                  // first relation of each bucket in order array
+    int* order;                         // relations grouped by bucket
+    int* by_size;                       // buckets sorted by size, biggest first
+    int* slot_of;                       // slot tried for each relation of the current bucket
+    char* taken;                        // slot already used
+    int found = 1;
+    
+    table->hash_buckets = bucket_count;
+    table->hash_seed = mem_realloc(table->hash_seed, bucket_count * sizeof(uint32_t));
+    table->hash_slot = mem_realloc(table->hash_slot, table->rel_count * sizeof(t_rel_slot));
+    
+    // group relations by bucket with a counting sort
+    bucket_start = calloc(bucket_count + 1, sizeof(int));
+    order = malloc(table->rel_count * sizeof(int));
+    for (i=0; i<table->rel_count; i++)
+        bucket_start[hash[i] % bucket_count + 1]++;
+    for (b=0; b<bucket_count; b++)
+        bucket_start[b+1] += bucket_start[b];
+    slot_of = calloc(bucket_count, sizeof(int));            // used as fill counter while grouping
+    for (i=0; i<table->rel_count; i++) {
+        b = hash[i] % bucket_count;
+        order[bucket_start[b] + slot_of[b]++] = i;
+    }
+    
+    // sort buckets by size, biggest first, with a counting sort on the size
+    by_size = malloc(bucket_count * sizeof(int));
+    taken = calloc(table->rel_count + 2, sizeof(char));
+    slot_of = realloc(slot_of, (table->rel_count + 2) * sizeof(int));
+    memset(slot_of, 0, (table->rel_count + 2) * sizeof(int));
+    for (b=0; b<bucket_count; b++)                          // slot_of used as size counter, taken is not used yet
+        slot_of[table->rel_count - (bucket_start[b+1] - bucket_start[b]) + 1]++;
+    for (k=0; k<=table->rel_count; k++)
+        slot_of[k+1] += slot_of[k];
+    for (b=0; b<bucket_count; b++)
+        by_size[slot_of[table->rel_count - (bucket_start[b+1] - bucket_start[b])]++] = b;
+    
+    for (i=0; i<bucket_count && found; i++) {
+        b = by_size[i];
+        table->hash_seed[b] = 0;
+        
+        // a relation lands on a free slot once every rel_count / free_slots seeds, last buckets need about rel_count
+        attempts = (size_t)HASH_MAX_ATTEMPT * (table->rel_count / (free_slots + 1) + 1);
+        if (attempts > UINT32_MAX)
+            attempts = UINT32_MAX;
+        for (seed=0, found=0; seed<attempts && !found; seed++) {                    // find a seed with no collision
+            found = 1;
+            for (j=bucket_start[b]; j<bucket_start[b+1] && found; j++) {
+                slot_of[j] = hash_mix(hash[order[j]], seed) % table->rel_count;
+                if (taken[slot_of[j]])
+                    found = 0;
+                for (k=bucket_start[b]; k<j && found; k++)          // collision inside the same bucket
+                    if (slot_of[k] == slot_of[j])
+                        found = 0;
+            }
+            if (found) {                                            // take the slots
+                table->hash_seed[b] = seed;
+                for (j=bucket_start[b]; j<bucket_start[b+1]; j++) {
+                    taken[slot_of[j]] = 1;
+                    table->hash_slot[slot_of[j]].rel = table->rel_arr[order[j]].cold->rel;
+                    table->hash_slot[slot_of[j]].cold = table->rel_arr[order[j]].cold;
+                }
+                free_slots -= bucket_start[b+1] - bucket_start[b];
+            }
+        }
+    }
+    
+    free(bucket_start);
+    free(order);
+    free(by_size);
+    free(slot_of);
+    free(taken);
+    
+    return found;
+}
+
+/*
+ * Slot given by the seed of the bucket of the name
+ */
+static inline t_rel_slot* relation_hash_slot(t_rel_table* table, const uint64_t h) {
+    
+    return &table->hash_slot[hash_mix(h, table->hash_seed[h % table->hash_buckets]) % table->hash_size];
+}
+
+/*
+ * Probe the side table from the slot of the name until an empty one, deleted slots are skipped
+ */
+static t_rel_slot* relation_side_find(t_rel_table* table, const uint64_t h, const char* rel) {
+    
+    size_t i;
+    const size_t mask = table->side_size - 1;
+    
+    for (i=hash_mix(h, 0) & mask; table->side_slot[i].rel != NULL; i=(i+1) & mask)
+        if (table->side_slot[i].rel != REL_SLOT_DELETED && strcmp(table->side_slot[i].rel, rel) == 0)
+            return &table->side_slot[i];
+    
+    return NULL;
+}
+
+/*
+ * A created relation takes back its slot of the perfect hash if that one was emptied,
+ * else it goes to the first deleted or empty slot of the side table. The name is not in the table yet
+ */
+static void relation_hash_insert(t_rel_table* table, t_rel_cold* cold) {
+    
+    size_t i;
+    uint64_t h;
+    t_rel_slot* slot;
+    t_rel_slot* free_slot = NULL;
+    const size_t mask = table->side_size - 1;
+    
+    if (table->hash_valid) {
+        h = hash_string(cold->rel);
+        slot = relation_hash_slot(table, h);
+        if (slot->rel == NULL)                              // emptied by a removed relation
+            table->hash_changes--;
+        else {
+            for (i=hash_mix(h, 0) & mask; table->side_slot[i].rel != NULL; i=(i+1) & mask)
+                if (free_slot == NULL && table->side_slot[i].rel == REL_SLOT_DELETED)
+                    free_slot = &table->side_slot[i];
+            if (free_slot == NULL) {                        // a new slot of the side table is used
+                free_slot = &table->side_slot[i];
+                table->hash_changes++;
+            }
+            slot = free_slot;
+        }
+        slot->rel = cold->rel;
+        slot->cold = cold;
+    }
+    
+    relation_hash_check(table);
+}
+
+/*
+ * Empty the slot of the relation in the perfect hash, or delete it from the side table.
+ * Relation array may be inconsistent, a rebuild has to be checked once it is not
+ */
+static void relation_hash_remove(t_rel_table* table, t_rel_cold* cold) {
+    
+    uint64_t h;
+    t_rel_slot* slot;
+    
+    if (!table->hash_valid)
+        return;
+    
+    h = hash_string(cold->rel);
+    slot = relation_hash_slot(table, h);
+    if (slot->cold == cold) {
+        slot->rel = NULL;
+        slot->cold = NULL;
+        table->hash_changes++;
+    }
+    else if ((slot = relation_side_find(table, h, cold->rel)) != NULL) {     // its side slot stays used
+        slot->rel = REL_SLOT_DELETED;
+        slot->cold = NULL;
+    }
+}
+
+/*
+ * Rebuild when the perfect hash is missing or half of the side table is used
+ */
+static inline void relation_hash_check(t_rel_table* table) {
+    
+    if (!table->hash_valid || table->hash_changes >= table->side_size >> 1)
+        build_relation_hash(table);
+}
+
+/*
+ * Create relation structure when a new relation is introduced
+ * Allocate and fill relation name
+ */
+static void fill_rel_str(t_rel_str* el, char* rel) {
+    
+    // copy name of relation into the cold part
+    el->cold = mem_alloc(sizeof(t_rel_cold));
+    el->cold->rel = name_new(rel, strlen(rel));     // exact size, any length
+    
+    el->n_most_dest = 0;
+    el->most_dest_arr = mem_calloc(MOST_DESTINATION_ARRAY_SIZE, sizeof(char*)); // create most destination array
+    el->most_dest_count = 0;
+    el->cold->most_dest_size = MOST_DESTINATION_ARRAY_SIZE;
+    
+    el->dest_arr = mem_calloc(DESTINATION_ARRAY_SIZE, sizeof(char*));           // create destination arrays
+    el->dest_of_count = mem_calloc(DESTINATION_ARRAY_SIZE, sizeof(uint32_t));
+    el->dest_of = mem_calloc(DESTINATION_ARRAY_SIZE, sizeof(t_dest_str));
+    el->dest_count = 0; 
+    el->cold->dest_size = DESTINATION_ARRAY_SIZE;
+    el->cold->rank_arr = NULL;                                                  // built at first top k request
+    el->cold->rank_pos = NULL;
+    el->cold->rank_ge = NULL;
+    el->cold->reported = NULL;                                                  // printed at next delta report
+    
+    el->summary = NULL;                                                         // formatted at next snapshot
+}
+
+/*
+ * Insert element into relation array in order. 
+ * Do not check for boundaries nor membership.
+ * Return position of new element, element count is not updated.
+ */
+static int insert_relation_element(t_rel_str* arr, char* new_elem, size_t elem_count) {
+    
+    int i, target;
+    
+    for (i=0; (i<elem_count) && (strcmp(arr[i].cold->rel, new_elem)<0); i++);   // find place where to insert new element
+
+    target = i;
+    for (i=elem_count-1; i>=target; i--) {                                      // shift right than fill it
+        memmove(&arr[i+1], &arr[i], sizeof(t_rel_str));
+        arr[i+1].cold->pos = i+1;
+    }
+    fill_rel_str(&arr[target], new_elem);
+    arr[target].cold->pos = target;
+    
+    return target;
+}
+
+/*
+ * Reallocate relation array with double the size
+ * Realloc does not keep cache line alignment, so copy into a new aligned block
+ */
+static inline void realloc_rel_array(t_rel_table* table) {
+    
+    t_rel_str* new_arr = mem_aligned((table->rel_size << 1) * sizeof(t_rel_str));
+    
+    memcpy(new_arr, table->rel_arr, table->rel_size * sizeof(t_rel_str));
+    mem_free(table->rel_arr);
+    table->rel_arr = new_arr;
+    table->rel_size = table->rel_size << 1;                   // double the size
+}
+
+
+/*
+ * Reallocate destination arrays with double the size
+ */
+static inline void realloc_dest_array(t_rel_str* rel_str) {
+    
+    const uint32_t size = rel_str->cold->dest_size = rel_str->cold->dest_size << 1;        // double the size
+    
+    rel_str->dest_arr = mem_realloc(rel_str->dest_arr, size * sizeof(char*));
+    rel_str->dest_of_count = mem_realloc(rel_str->dest_of_count, size * sizeof(uint32_t));
+    rel_str->dest_of = mem_realloc(rel_str->dest_of, size * sizeof(t_dest_str));
+    
+    if (rel_str->cold->rank_arr != NULL) {
+        rel_str->cold->rank_arr = mem_realloc(rel_str->cold->rank_arr, size * sizeof(char*));
+        rel_str->cold->rank_pos = mem_realloc(rel_str->cold->rank_pos, size * sizeof(uint32_t));
+    }
+}
+
+/*
+ * Create destination structure when a new destination for a relation is introduced
+ * Fill destination name with the pointer to entity name
+ */
+static void fill_dest_str(t_rel_str* rel_str, const int pos, char* dest) {
+         
+    rel_str->dest_arr[pos] = dest;                                          // copy pointer of name of destination   
+    rel_str->dest_of_count[pos] = 0;
+    
+    rel_str->dest_of[pos].dest_of = mem_calloc(DESTINATION_OF_SIZE, sizeof(char*));      // create destination_of array
+    rel_str->dest_of[pos].dest_of_size = DESTINATION_OF_SIZE;
+    rel_str->dest_of[pos].is_hash = 0;
+}
+
+/*
+ * Insert element into destination arrays in order. 
+ * Do not check for boundaries nor membership.
+ * Return position of the new element.
+ */
+static int insert_dest_element(t_rel_str* rel_str, char* new_elem) {
+    
+    int i;
+    const size_t n = rel_str->dest_count;
+    
+    for (i=0; (i<n) && (strcmp(rel_str->dest_arr[i], new_elem)<0); i++);       // find place where to insert new element
+
+    if (i < n) {                                                                // shift right every array, than fill it
+        memmove(&rel_str->dest_arr[i+1], &rel_str->dest_arr[i], (n-i) * sizeof(char*));
+        memmove(&rel_str->dest_of_count[i+1], &rel_str->dest_of_count[i], (n-i) * sizeof(uint32_t));
+        memmove(&rel_str->dest_of[i+1], &rel_str->dest_of[i], (n-i) * sizeof(t_dest_str));
+        if (rel_str->cold->rank_arr != NULL)
+            memmove(&rel_str->cold->rank_pos[i+1], &rel_str->cold->rank_pos[i], (n-i) * sizeof(uint32_t));
+    }
+    fill_dest_str(rel_str, i, new_elem);
+    rel_str->dest_count++;
+    
+    if (rel_str->cold->rank_arr != NULL) {                                      // no relation received yet, last in rank
+        rel_str->cold->rank_arr[n] = new_elem;
+        rel_str->cold->rank_pos[i] = n;
+    }
+    
+    return i;
+}
+
+/*
+ * Update destination_of array with the new origin 
+ */
+static void update_dest_of(t_dest_str* dest_str, uint32_t* dest_of_count, char* orig) {
+    
+    if (dest_str->is_hash) {                                                // no order to keep
+        origin_hash_insert(dest_str, *dest_of_count, orig);
+        (*dest_of_count)++;
+        return;
+    }
+    if (*dest_of_count == ORIGIN_HASH_MIN) {                                // array too big to shift, switch to hash set
+        origin_to_hash(dest_str, *dest_of_count);
+        origin_hash_insert(dest_str, *dest_of_count, orig);
+        (*dest_of_count)++;
+        return;
+    }
+      
+    if (*dest_of_count == dest_str->dest_of_size)                           // if it's full, double the size
+        dest_str->dest_of = realloc_string_array(dest_str->dest_of, &dest_str->dest_of_size);
+
+    int i, target;
+    
+    for (i=0; (i<*dest_of_count) && (strcmp(dest_str->dest_of[i], orig)<0); i++);      // find place where to insert new element
+
+    if (i == *dest_of_count)                                                // if it's last, just insert
+        dest_str->dest_of[i] = orig;
+    else {
+        target = i;
+        for (i=*dest_of_count-1; i>=target; i--)                            // else, shift right the remaining array
+            dest_str->dest_of[i+1] = dest_str->dest_of[i];
+        dest_str->dest_of[target] = orig;                       
+    }
+    
+    (*dest_of_count)++;
+}
+
+/*
+ * Update relation structure
+ * Most_dest_arr is not sorted, will be sorted by report
+ */
+static inline void update_rel_str(t_rel_str* rel_str, char* dest, const uint32_t dest_of_count) {
+    
+    if (rel_str->n_most_dest < dest_of_count) {             // if new dest receives more relation 
+        
+        rel_str->most_dest_arr[0] = dest;
+        rel_str->most_dest_count = 1;
+        rel_str->n_most_dest = dest_of_count;
+    }
+    else if (rel_str->n_most_dest == dest_of_count) {       // if new dest receives same amount of relation
+        
+        if (rel_str->most_dest_count == rel_str->cold->most_dest_size) 
+            rel_str->most_dest_arr = realloc_string_array(rel_str->most_dest_arr, &rel_str->cold->most_dest_size);
+        rel_str->most_dest_arr[rel_str->most_dest_count++] = dest;
+    }
+}
+
+/*
+ * Add new relation between two entity. 
+ * Entities are resolved here, relation is updated by the shard owning it or by the engine table
+ */
+static void add_rel(t_monitor* monitor, char* orig, char* dest, char* rel) {
+    
+    char* dest_ent = search_entity(monitor, dest);
+    char* orig_ent = search_entity(monitor, orig);
+    
+    // if one of the entity is not registered, return
+    if (dest_ent == NULL || orig_ent == NULL)     
+        return;
+    
+    if (monitor->shard_count > 0)
+        shard_push(shard_of(monitor, rel), SHARD_ADD_REL, orig_ent, dest_ent, rel);
+    else
+        insert_rel(&monitor->rel_table, orig_ent, dest_ent, rel);
+}
+
+/*
+ * Add new relation between two registered entity into relation table. 
+ * Entities are pointers to the entity dictionary
+ */
+static void insert_rel(t_rel_table* table, char* orig, char* dest, char* rel) {
+    
+    int pos;
+    t_rel_str* rel_str;
+    t_dest_str* dest_str;
+    
+    // step 1: check if relation is present to use its destination array. If new, create new relation structure
+    pos = search_relation(table, rel);
+    
+    if (pos == -1) {                    // if not already in relation array
+        
+        if (table->rel_count == table->rel_size)                                          // resize relation array if full
+            realloc_rel_array(table);
+        
+        pos = insert_relation_element(table->rel_arr, rel, table->rel_count);         // insert new relation structure 
+        table->rel_count++;
+        relation_hash_insert(table, table->rel_arr[pos].cold);                   // set of relation changed
+        rel_str = &table->rel_arr[pos];
+    }
+    else
+        rel_str = &table->rel_arr[pos];
+    
+    // step 2: check if destination of relation is present in destination array. If not, create new destination structure.
+    pos = search_string_array(rel_str->dest_arr, rel_str->dest_count, dest);
+    
+    if (pos == -1) {                    // if not already in destination array
+        
+        if (rel_str->dest_count == rel_str->cold->dest_size)               // resize destination arrays if full
+            realloc_dest_array(rel_str);
+        
+        pos = insert_dest_element(rel_str, dest);                       // insert new destination structure
+    }
+    dest_str = &rel_str->dest_of[pos];
+    
+    // step 3: update dest of, src of and rel_str
+    if (origin_search(dest_str, rel_str->dest_of_count[pos], orig) == -1) {      // search if dest is already destination of orig. if not, update
+        drop_summary(rel_str);
+        update_dest_of(dest_str, &rel_str->dest_of_count[pos], orig);
+        update_rel_str(rel_str, dest, rel_str->dest_of_count[pos]);
+        if (rel_str->cold->rank_arr != NULL)
+            rank_increment(rel_str, pos, rel_str->dest_of_count[pos]);
+    }
+}
+
+/*
+ * Delete passed relation structure and fix relation array order
+ */
+static void remove_rel_str(t_rel_table* table, t_rel_str* rel_str, const int rel_pos) {
+    int i;
+    
+    relation_hash_remove(table, rel_str->cold);                             // set of relation changed, name still owned
+    note_removed(table, rel_str);
+    free_rel_str(rel_str);                                                  // free elements in relation structure
+    table->rel_count--;
+    for (i=rel_pos; i<table->rel_count; i++) {
+        memmove(&table->rel_arr[i], &table->rel_arr[i+1], sizeof(t_rel_str));             // fix relation array shifting left
+        table->rel_arr[i].cold->pos = i;
+    }
+    relation_hash_check(table);
+}
+
+/*
+ * Delete passed destination structure and fix destination arrays order
+ */
+static void remove_dest_str(t_rel_str* rel_str, const int dest_pos) {
+    
+    const size_t n = rel_str->dest_count - dest_pos - 1;
+    
+    mem_free(rel_str->dest_of[dest_pos].dest_of);                  // clean dest_str and fix destination arrays
+    memmove(&rel_str->dest_arr[dest_pos], &rel_str->dest_arr[dest_pos+1], n * sizeof(char*));
+    memmove(&rel_str->dest_of_count[dest_pos], &rel_str->dest_of_count[dest_pos+1], n * sizeof(uint32_t));
+    memmove(&rel_str->dest_of[dest_pos], &rel_str->dest_of[dest_pos+1], n * sizeof(t_dest_str));
+    if (rel_str->cold->rank_arr != NULL)
+        memmove(&rel_str->cold->rank_pos[dest_pos], &rel_str->cold->rank_pos[dest_pos+1], n * sizeof(uint32_t));
+    rel_str->dest_count--;
+}
+
+/*
+ * Update destination of count. If only one origin is present, removes dest_str 
+ */
+static void update_dest_of_count(t_rel_str* rel_str, const int dest_pos, const int orig_pos) {
+
+    int i;
+    char** dest_of = rel_str->dest_of[dest_pos].dest_of;
+    
+    if (rel_str->cold->rank_arr != NULL)
+        rank_decrement(rel_str, dest_pos, rel_str->dest_of_count[dest_pos]);
+    
+    if (rel_str->dest_of_count[dest_pos] == 1)                 // if only 1 origin is in the array      
+        remove_dest_str(rel_str, dest_pos);
+    
+    else if (rel_str->dest_of[dest_pos].is_hash) {             // hash set, orig_pos is its slot
+        origin_hash_delete(&rel_str->dest_of[dest_pos], rel_str->dest_of_count[dest_pos], orig_pos);
+        rel_str->dest_of_count[dest_pos]--;
+    }
+    
+    else {
+        for (i=orig_pos; i<rel_str->dest_of_count[dest_pos]-1; i++)     // remove the origin and fix dest_of_arr
+            dest_of[i] = dest_of[i+1];
+        rel_str->dest_of_count[dest_pos]--;
+    }
+}
+
+/*
+ * Recompute which entities receives most number of relation and updates most_dest_arr
+ * Two passes over the counts array: maximum, then collection of the ties in destination order
+ */
+static void recompute_most_dest(t_rel_str* rel_str) {
+    
+    uint32_t max;
+    
+    rel_str->most_dest_count = 0;                   
+    
+#ifdef SIMD_SCAN
+    if (use_avx2) {
+        max = max_count_avx2(rel_str->dest_of_count, rel_str->dest_count);
+        rel_str->n_most_dest = max;
+        collect_most_dest_avx2(rel_str, max);
+        return;
+    }
+#endif
+    
+    max = max_count_scalar(rel_str->dest_of_count, rel_str->dest_count);
+    rel_str->n_most_dest = max;
+    collect_most_dest_scalar(rel_str, max);
+}
+
+/*
+ * Find the maximum of the counts array
+ */
+static uint32_t max_count_scalar(const uint32_t* count, const size_t n) {
+    
+    int i;
+    uint32_t max = 0;
+    
+    for (i=0; i<n; i++)
+        if (count[i] > max)
+            max = count[i];
+    
+    return max;
+}
+
+/*
+ * Collect destinations whose count is equal to max into most_dest_arr
+ */
+static void collect_most_dest_scalar(t_rel_str* rel_str, const uint32_t max) {
+    
+    int i;
+    
+    for (i=0; i<rel_str->dest_count; i++)
+        if (rel_str->dest_of_count[i] == max) {
+            if (rel_str->most_dest_count == rel_str->cold->most_dest_size) 
+                rel_str->most_dest_arr = realloc_string_array(rel_str->most_dest_arr, &rel_str->cold->most_dest_size);
+            rel_str->most_dest_arr[rel_str->most_dest_count++] = rel_str->dest_arr[i];
+        }
+}
+
+#ifdef SIMD_SCAN
+/*
+ * Find the maximum of the counts array, 8 counts at a time
+ */
+__attribute__((target("avx2")))
+static uint32_t max_count_avx2(const uint32_t* count, const size_t n) {
+    
+    size_t i;
+    uint32_t max, lane[8];
+    __m256i vmax = _mm256_setzero_si256();
+    
+    for (i=0; i+8<=n; i+=8) 
+        vmax = _mm256_max_epu32(vmax, _mm256_loadu_si256((const __m256i*)&count[i]));
+    
+    // reduce the 8 lanes, then the tail
+    _mm256_storeu_si256((__m256i*)lane, vmax);
+    max = max_count_scalar(lane, 8);
+    for (; i<n; i++)
+        if (count[i] > max)
+            max = count[i];
+    
+    return max;
+}
+
+/*
+ * Collect destinations whose count is equal to max into most_dest_arr, 8 counts at a time.
+ * The compare mask gives directly the positions of the ties.
+ */
+__attribute__((target("avx2")))
+static void collect_most_dest_avx2(t_rel_str* rel_str, const uint32_t max) {
+    
+    size_t i;
+    unsigned int mask;
+    const size_t n = rel_str->dest_count;
+    const __m256i vmax = _mm256_set1_epi32(max);
+    __m256i eq;
+    
+    for (i=0; i+8<=n; i+=8) {
+        eq = _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i*)&rel_str->dest_of_count[i]), vmax);
+        mask = _mm256_movemask_ps(_mm256_castsi256_ps(eq));
+        if (mask == 0)
+            continue;
+        
+        while (rel_str->most_dest_count + 8 > rel_str->cold->most_dest_size)          // room for the whole block
+            rel_str->most_dest_arr = realloc_string_array(rel_str->most_dest_arr, &rel_str->cold->most_dest_size);
+        
+        for (; mask; mask &= mask - 1)                                          // compress ties
+            rel_str->most_dest_arr[rel_str->most_dest_count++] = rel_str->dest_arr[i + __builtin_ctz(mask)];
+    }
+    
+    for (; i<n; i++)                                                            // tail
+        if (rel_str->dest_of_count[i] == max) {
+            if (rel_str->most_dest_count == rel_str->cold->most_dest_size) 
+                rel_str->most_dest_arr = realloc_string_array(rel_str->most_dest_arr, &rel_str->cold->most_dest_size);
+            rel_str->most_dest_arr[rel_str->most_dest_count++] = rel_str->dest_arr[i];
+        }
+}
+#endif
+
+/*
+ * Search position of target in most destination array. Return position if found, -1 else
+ */
+static inline int search_most_dest(char** arr, size_t count, char* target) {
+    
+    int i;
+    for (i=count-1; i>=0 && strcmp(arr[i], target)!=0; i--);
+        
+    return i;
+} 
+
+/*
+ * Fix most destination array shifting left. Return new count
+ */
+static inline int update_most_dest(char** arr, size_t count, const int pos) {
+    
+    int i;
+    for (i=pos; i<count; i++)              // fix most_dest_arr
+        arr[i] = arr[i+1];
+    
+    return --count;
+}
+
+/*
+ * Delete, if exists, passed relation. 
+ * Shards receive entities resolved, since command buffer is reused before they read it
+ */
+static void del_rel(t_monitor* monitor, char* orig, char* dest, char* rel) {
+    
+    char* dest_ent;
+    char* orig_ent;
+    
+    if (monitor->shard_count == 0) {
+        remove_rel(&monitor->rel_table, orig, dest, rel);
+        return;
+    }
+    
+    dest_ent = search_entity(monitor, dest);
+    orig_ent = search_entity(monitor, orig);
+    if (dest_ent == NULL || orig_ent == NULL)           // no relation can exist with a missing entity
+        return;
+    
+    shard_push(shard_of(monitor, rel), SHARD_DEL_REL, orig_ent, dest_ent, rel);
+}
+
+/*
+ * Delete, if exists, passed relation from relation table
+ */
+static void remove_rel(t_rel_table* table, char* orig, char* dest, char* rel) {
+    
+    int rel_pos = search_relation(table, rel);             // find relation structure
+    if (rel_pos == -1)
+        return;
+    t_rel_str* rel_str = &table->rel_arr[rel_pos];
+    
+    int dest_pos = search_string_array(rel_str->dest_arr, rel_str->dest_count, dest);       // find destination structure
+    if (dest_pos == -1)
+        return;
+    t_dest_str* dest_str = &rel_str->dest_of[dest_pos];
+    
+    int orig_pos = origin_search(dest_str, rel_str->dest_of_count[dest_pos], orig);     // find position in destination_of
+    if (orig_pos == -1)
+        return;
+    
+    drop_summary(rel_str);                                                  // relation is changing
+    
+    int most_dest_pos = search_most_dest(rel_str->most_dest_arr, rel_str->most_dest_count, dest);           // find position in most_dest_arr
+    
+    // if it's the only relation for this relation, remove its relation structure 
+    if (rel_str->dest_count == 1 && rel_str->dest_of_count[dest_pos] == 1) 
+        remove_rel_str(table, rel_str, rel_pos);
+    
+    // if dest it's not in the most_dest_arr, update it's dest_of_count
+    else if (most_dest_pos == -1) 
+        update_dest_of_count(rel_str, dest_pos, orig_pos);
+    
+    // if dest it's in the most_dest_arr
+    else {
+        
+        // if most_dest_count > 1, remove the relation and update it's dest_of_count
+        if (rel_str->most_dest_count > 1) { 
+            
+            rel_str->most_dest_count = update_most_dest(rel_str->most_dest_arr, rel_str->most_dest_count, most_dest_pos);            
+            update_dest_of_count(rel_str, dest_pos, orig_pos);
+        }
+        // if most_dest_count == 1, update dest_of_count and recompute most_dest_arr
+        else {
+            update_dest_of_count(rel_str, dest_pos, orig_pos);
+            recompute_most_dest(rel_str);
+        }
+    }
+}
+
+/*
+ * Delete relations of a registered entity. 
+ * Every shard may own relations of the entity, so the command is broadcast and the caller can release the name
+ * only once all of them applied it
+ */
+static void del_ent(t_monitor* monitor, char* ent) {
+    
+    int i;
+    
+    if (monitor->shard_count > 0) {
+        for (i=0; i<monitor->shard_count; i++)
+            shard_push(&monitor->shard_arr[i], SHARD_DEL_ENT, ent, NULL, NULL);
+        shard_barrier(monitor);
+    }
+    else
+        remove_ent(&monitor->rel_table, ent);
+}
+
+/*
+ * Remove every relation of a registered entity from relation table. Recompute each most_dest_arr when necessary
+ */
+static void remove_ent(t_rel_table* table, char* ent) {
+    
+    int i, j;
+    int recompute;
+    int dest_pos, dest_of_pos, most_dest_pos; 
+    t_rel_str* rel_str;
+    t_dest_str* dest_str;
+    
+    for (i=0; i<table->rel_count; i++) {                   // for each relation structure
+        rel_str = &table->rel_arr[i];
+        dest_pos = -1;
+        recompute = 0;
+        
+        mem_prefetch(rel_str->dest_arr, rel_str->dest_count * sizeof(char*));           // every destination is visited
+        mem_prefetch(rel_str->dest_of_count, rel_str->dest_count * sizeof(uint32_t));
+        mem_prefetch(rel_str->dest_of, rel_str->dest_count * sizeof(t_dest_str));
+        
+        for (j=0; j<rel_str->dest_count; j++) {         // for each destination structure
+            dest_str = &rel_str->dest_of[j];
+            
+            if (strcmp(rel_str->dest_arr[j], ent) == 0)     // if it's dest_str of ent, save position    
+                dest_pos = j;
+            
+            else {
+                dest_of_pos = origin_search(dest_str, rel_str->dest_of_count[j], ent);
+                
+                if (dest_of_pos >= 0) {                     // if it's in dest_of
+                    drop_summary(rel_str);
+                    most_dest_pos = search_most_dest(rel_str->most_dest_arr, rel_str->most_dest_count, rel_str->dest_arr[j]);
+                    
+                    // if it's the only relation for this relation, remove its relation structure 
+                    if (rel_str->dest_count == 1 && rel_str->dest_of_count[j] == 1) { 
+                        remove_rel_str(table, rel_str, i);
+                        recompute = 0;
+                        i -= 1;
+                        break;                              // rel_str is gone, stop looking at its destinations
+                    }
+
+                    // if dest it's not in the most_dest_arr and we have only 1 dest_of, update it's dest_of_count
+                    else if (most_dest_pos == -1 && rel_str->dest_of_count[j] == 1) {
+                        update_dest_of_count(rel_str, j, dest_of_pos);
+                        j -= 1;                             // if it's the only origin for this destination, it will be eliminated dest_str, so to j-1 to not skip element in j loop
+                    }
+                    
+                    // if dest it's not in the most_dest_arr, update it's dest_of_count
+                    else if (most_dest_pos == -1) 
+                        update_dest_of_count(rel_str, j, dest_of_pos);
+
+                    // if dest it's in the most_dest_arr
+                    else {
+
+                        // if most_dest_count > 1 and we have only 1 dest_of, remove the relation and update it's dest_of_count
+                        if (rel_str->most_dest_count > 1 && rel_str->dest_of_count[j] == 1) { 
+
+                            rel_str->most_dest_count = update_most_dest(rel_str->most_dest_arr, rel_str->most_dest_count, most_dest_pos);            
+                            update_dest_of_count(rel_str, j, dest_of_pos);
+                            j -= 1;
+                        }
+                        // if most_dest_count > 1, remove the relation and update it's dest_of_count
+                        else if (rel_str->most_dest_count > 1) { 
+
+                            rel_str->most_dest_count = update_most_dest(rel_str->most_dest_arr, rel_str->most_dest_count, most_dest_pos);            
+                            update_dest_of_count(rel_str, j, dest_of_pos);
+                        }
+                        // if most_dest_count == 1, update dest_of_count and recompute most_dest_arr
+                        else {
+                            if (rel_str->dest_of_count[j] == 1) {
+                                update_dest_of_count(rel_str, j, dest_of_pos);
+                                j -= 1;
+                            }
+                            else
+                                update_dest_of_count(rel_str, j, dest_of_pos);
+                            recompute = 1;
+                        }
+                    }
+                }
+            }
+        }
+        
+        // entity had a destination structure
+        if (dest_pos >= 0) {
+            drop_summary(rel_str);
+            if (rel_str->dest_count == 1) {             // if entity is the only destination for relation, remove relation structure
+                remove_rel_str(table, rel_str, i);
+                recompute = 0;
+                i -= 1;
+            }         
+            else {                                      // if there are more destinations
+                
+                if (rel_str->most_dest_count==1 && strcmp(rel_str->most_dest_arr[0], ent)==0)             // if entity is the only most dest, recompute         
+                    recompute = 1;   
+                
+                else {     
+                    most_dest_pos = search_most_dest(rel_str->most_dest_arr, rel_str->most_dest_count, ent);         // find position in most_dest_arr
+                    
+                    if (most_dest_pos >= 0)                         // if entity is in most_dest_arr, remove it and fix it
+                        rel_str->most_dest_count = update_most_dest(rel_str->most_dest_arr, rel_str->most_dest_count, most_dest_pos);
+                }
+                
+                if (rel_str->cold->rank_arr != NULL)
+                    rank_remove(rel_str, dest_pos);
+                remove_dest_str(rel_str, dest_pos);       // remove dest_str associated to entity
+            }
+        } 
+        
+        // need to recompute most dest array
+        if (recompute == 1)                             
+            recompute_most_dest(rel_str);
+    }
+}
+
+/*
+ * Buffer addrel or delrel until next barrier. 
+ * Entities are resolved now: delent is a barrier, so an entity found here still exists at flush.
+ * Commands on missing entities do nothing and are dropped.
+ */
+static void batch_rel(t_monitor* monitor, char* orig, char* dest, char* rel, const int add) {
+    
+    t_batch_op* op;
+    char* orig_ent = search_entity(monitor, orig);
+    char* dest_ent = search_entity(monitor, dest);
+    
+    if (orig_ent == NULL || dest_ent == NULL)
+        return;
+    
+    if (monitor->batch_count == monitor->batch_size) {  // double size if full
+        monitor->batch_size = monitor->batch_size << 1;
+        monitor->batch_arr = realloc(monitor->batch_arr, monitor->batch_size * sizeof(t_batch_op));
+    }
+    
+    op = &monitor->batch_arr[monitor->batch_count++];
+    op->orig = orig_ent;
+    op->dest = dest_ent;
+    name_copy_set(&op->rel, rel, strlen(rel));          // freed when the batch is flushed
+    op->seq = monitor->batch_seq++;
+    op->add = add;
+}
+
+/*
+ * Compare function for qsort for buffered commands
+ * Order by relation, destination, origin and arrival
+ */
+static int batch_compare(const void* a, const void* b) {
+    
+    const t_batch_op* x = (const t_batch_op*)a;
+    const t_batch_op* y = (const t_batch_op*)b;
+    int c;
+    
+    if ((c = name_copy_compare(&x->rel, &y->rel)) != 0)
+        return c;
+    if (x->dest != y->dest)                             // names are shared, same pointer means same entity
+        return strcmp(x->dest, y->dest);
+    if (x->orig != y->orig)
+        return strcmp(x->orig, y->orig);
+    
+    return (x->seq < y->seq) ? -1 : (x->seq > y->seq);
+}
+
+/*
+ * Apply every buffered command. 
+ * Only the last command for each edge matters, then each relation is merged in one linear pass
+ * and its most_dest_arr is recomputed once. Relations with few commands compared to their
+ * destinations are updated command by command instead.
+ */
+static void flush_batch(t_monitor* monitor) {
+    
+    size_t i, j, n;
+    int pos, has_add;
+    t_rel_str* rel_str;
+    t_rel_table* table = &monitor->rel_table;       // batch mode is not sharded
+    
+    if (monitor->batch_count == 0)
+        return;
+    
+    // step 1: sort and keep last command of each edge
+    qsort(monitor->batch_arr, monitor->batch_count, sizeof(t_batch_op), batch_compare);
+    for (i=0, n=0; i<monitor->batch_count; i++) {
+        if (i+1 < monitor->batch_count && monitor->batch_arr[i+1].orig == monitor->batch_arr[i].orig && monitor->batch_arr[i+1].dest == monitor->batch_arr[i].dest 
+                && name_copy_compare(&monitor->batch_arr[i+1].rel, &monitor->batch_arr[i].rel) == 0) {
+            name_copy_free(&monitor->batch_arr[i].rel);
+            continue;
+        }
+        monitor->batch_arr[n++] = monitor->batch_arr[i];
+    }
+    monitor->batch_count = n;
+    
+    // step 2: create missing relations that receive at least one addrel
+    for (i=0; i<monitor->batch_count; i=j) {
+        for (j=i, has_add=0; j<monitor->batch_count && name_copy_compare(&monitor->batch_arr[j].rel, &monitor->batch_arr[i].rel) == 0; j++)
+            has_add |= monitor->batch_arr[j].add;
+        
+        if (has_add && search_relation(table, name_copy_str(&monitor->batch_arr[i].rel)) == -1) {
+            if (table->rel_count == table->rel_size)                                      // resize relation array if full
+                realloc_rel_array(table);
+            pos = insert_relation_element(table->rel_arr, name_copy_str(&monitor->batch_arr[i].rel), table->rel_count);
+            table->rel_count++;
+            relation_hash_insert(table, table->rel_arr[pos].cold);
+        }
+    }
+    
+    // step 3: apply each relation group
+    for (i=0; i<monitor->batch_count; i=j) {
+        for (j=i; j<monitor->batch_count && name_copy_compare(&monitor->batch_arr[j].rel, &monitor->batch_arr[i].rel) == 0; j++);
+        
+        pos = search_relation(table, name_copy_str(&monitor->batch_arr[i].rel));
+        if (pos == -1)                                      // only delrel on a missing relation
+            continue;
+        rel_str = &table->rel_arr[pos];
+        
+        if ((j-i) * BATCH_MERGE_RATIO < rel_str->dest_count) {             // few commands, apply one by one
+            for (n=i; n<j; n++) {
+                if (monitor->batch_arr[n].add)
+                    insert_rel(table, monitor->batch_arr[n].orig, monitor->batch_arr[n].dest, name_copy_str(&monitor->batch_arr[n].rel));
+                else
+                    remove_rel(table, monitor->batch_arr[n].orig, monitor->batch_arr[n].dest, name_copy_str(&monitor->batch_arr[n].rel));
+            }
+        }
+        else {
+            drop_summary(rel_str);
+            merge_rel_str(rel_str, &monitor->batch_arr[i], j-i);
+            recompute_most_dest(rel_str);
+        }
+    }
+    
+    // step 4: remove relations left without destinations, check hash once
+    for (i=0, n=0; i<table->rel_count; i++) {
+        if (table->rel_arr[i].dest_count == 0) {
+            relation_hash_remove(table, table->rel_arr[i].cold);
+            note_removed(table, &table->rel_arr[i]);
+            free_rel_str(&table->rel_arr[i]);
+        }
+        else {
+            table->rel_arr[n] = table->rel_arr[i];
+            table->rel_arr[n].cold->pos = n;
+            n++;
+        }
+    }
+    table->rel_count = n;
+    relation_hash_check(table);
+    
+    for (i=0; i<monitor->batch_count; i++)
+        name_copy_free(&monitor->batch_arr[i].rel);
+    monitor->batch_count = 0;
+}
+
+/*
+ * Merge sorted buffered commands of one relation into its destination arrays.
+ * Destination arrays are rebuilt in one pass, most_dest_arr has to be recomputed after.
+ */
+static void merge_rel_str(t_rel_str* rel_str, t_batch_op* ops, const size_t n) {
+    
+    size_t i = 0, k = 0, j, count = 0;
+    int c;
+    uint32_t size = rel_str->cold->dest_size;
+    t_dest_str dest_str;
+    uint32_t dest_of_count;
+    
+    while (size < rel_str->dest_count + n)                  // enough room for every new destination
+        size = size << 1;
+    
+    char** dest_arr = mem_alloc(size * sizeof(char*));
+    uint32_t* dest_of_count_arr = mem_alloc(size * sizeof(uint32_t));
+    t_dest_str* dest_of = mem_alloc(size * sizeof(t_dest_str));
+    
+    while (i < rel_str->dest_count || k < n) {
+        
+        c = (i == rel_str->dest_count) ? 1 : (k == n) ? -1 : strcmp(rel_str->dest_arr[i], ops[k].dest);
+        
+        if (c < 0) {                                        // destination without commands, copy it
+            dest_arr[count] = rel_str->dest_arr[i];
+            dest_of_count_arr[count] = rel_str->dest_of_count[i];
+            dest_of[count++] = rel_str->dest_of[i++];
+            continue;
+        }
+        
+        for (j=k; j<n && ops[j].dest == ops[k].dest; j++);  // commands for this destination
+        
+        if (c == 0) {                                       // existing destination
+            dest_str = rel_str->dest_of[i];
+            dest_of_count = rel_str->dest_of_count[i++];
+        }
+        else {                                              // new destination
+            dest_str.dest_of = NULL;
+            dest_str.dest_of_size = DESTINATION_OF_SIZE;
+            dest_str.is_hash = 0;
+            dest_of_count = 0;
+        }
+        
+        dest_of_count = merge_dest_of(&dest_str, dest_of_count, &ops[k], j-k);
+        if (dest_of_count > 0) {
+            dest_arr[count] = ops[k].dest;
+            dest_of_count_arr[count] = dest_of_count;
+            dest_of[count++] = dest_str;
+        }
+        else                                                // every origin removed
+            mem_free(dest_str.dest_of);
+        
+        k = j;
+    }
+    
+    mem_free(rel_str->dest_arr);
+    mem_free(rel_str->dest_of_count);
+    mem_free(rel_str->dest_of);
+    rank_free(rel_str->cold);                               // rebuilt at next top k request
+    rel_str->dest_arr = dest_arr;
+    rel_str->dest_of_count = dest_of_count_arr;
+    rel_str->dest_of = dest_of;
+    rel_str->dest_count = count;
+    rel_str->cold->dest_size = size;
+}
+
+/*
+ * Merge sorted buffered commands of one destination into its origin set. 
+ * Return new number of origins
+ */
+static uint32_t merge_dest_of(t_dest_str* dest_str, const uint32_t count, t_batch_op* ops, const size_t n) {
+    
+    size_t i = 0, k = 0;
+    uint32_t new_count = 0;
+    uint32_t size = dest_str->dest_of_size;
+    char** old = dest_str->dest_of;
+    char** dest_of;
+    int pos;
+    
+    if (dest_str->is_hash) {                                // no order to merge, apply each command
+        new_count = count;
+        for (k=0; k<n; k++) {
+            pos = origin_search(dest_str, new_count, ops[k].orig);
+            if (ops[k].add && pos == -1)
+                update_dest_of(dest_str, &new_count, ops[k].orig);
+            else if (!ops[k].add && pos >= 0 && dest_str->is_hash)
+                origin_hash_delete(dest_str, new_count--, pos);
+            else if (!ops[k].add && pos >= 0) {                 // set went back to a sorted array
+                memmove(&dest_str->dest_of[pos], &dest_str->dest_of[pos+1], (new_count - pos - 1) * sizeof(char*));
+                new_count--;
+            }
+        }
+        return new_count;
+    }
+    
+    while (size < count + n)                                // enough room for every new origin
+        size = size << 1;
+    dest_of = mem_alloc(size * sizeof(char*));
+    
+    while (i < count || k < n) {
+        if (k == n || (i < count && strcmp(old[i], ops[k].orig) < 0))          // origin without commands
+            dest_of[new_count++] = old[i++];
+        else {
+            if (i < count && old[i] == ops[k].orig)                             // edge already present
+                i++;
+            if (ops[k].add)                                                     // present after the command
+                dest_of[new_count++] = ops[k].orig;
+            k++;
+        }
+    }
+    
+    mem_free(old);
+    dest_str->dest_of = dest_of;
+    dest_str->dest_of_size = size;
+    
+    if (new_count >= ORIGIN_HASH_MIN)                       // too big to shift on next inserts
+        origin_to_hash(dest_str, new_count);
+    
+    return new_count;
+}
+
+/*
+ * Send addrel or delrel to the engine
+ */
+static void apply_rel(t_monitor* monitor, char* orig, char* dest, char* rel, const int add) {
+    
+    monitor->engine->rel(monitor, orig, dest, rel, add);
+}
+
+/*
+ * Send delent to the engine, then drop the entity from the dictionary
+ */
+static void apply_del_ent(t_monitor* monitor, char* ent) {
+    
+    char* ent_name = search_entity(monitor, ent);
+    
+    // if entity to delete is not in entity dictionary, return
+    if (ent_name == NULL)
+        return;
+    
+    monitor->engine->del_ent(monitor, ent_name);
+    remove_entity(monitor, ent_name);
+}
+
+/*
+ * Set up the sorted array engine: one relation table, or one for each shard
+ */
+static void array_init(t_monitor* monitor) {
+    
+    if (monitor->shard_count > 0)
+        start_shards(monitor);
+    else
+        init_rel_table(&monitor->rel_table);
+}
+
+/*
+ * Release the relation table, or every shard with its own
+ */
+static void array_free(t_monitor* monitor) {
+    
+    if (monitor->shard_count > 0)
+        stop_shards(monitor);
+    else
+        free_rel_table(&monitor->rel_table);
+}
+
+/*
+ * Send addrel or delrel by names to the sorted array engine, buffered if in batch mode
+ */
+static void array_rel(t_monitor* monitor, char* orig, char* dest, char* rel, const int add) {
+    
+    if (monitor->batch_mode)
+        batch_rel(monitor, orig, dest, rel, add);
+    else if (add)
+        add_rel(monitor, orig, dest, rel);
+    else
+        del_rel(monitor, orig, dest, rel);
+}
+
+/*
+ * Send addrel or delrel of entities already resolved to the shard owning the relation or to the relation table.
+ * Not used in batch mode
+ */
+static void array_edge(t_monitor* monitor, char* orig, char* dest, char* rel, const int add) {
+    
+    if (monitor->shard_count > 0)
+        shard_push(shard_of(monitor, rel), add ? SHARD_ADD_REL : SHARD_DEL_REL, orig, dest, rel);
+    else if (add)
+        insert_rel(&monitor->rel_table, orig, dest, rel);
+    else
+        remove_rel(&monitor->rel_table, orig, dest, rel);
+}
+
+/*
+ * Remove every relation of a registered entity, applying buffered commands first
+ */
+static void array_del_ent(t_monitor* monitor, char* ent) {
+    
+    if (monitor->batch_mode)
+        flush_batch(monitor);
+    del_ent(monitor, ent);
+}
+
+/*
+ * Apply commands buffered by batch mode and wait for the shards
+ */
+static void array_flush(t_monitor* monitor) {
+    
+    flush_batch(monitor);
+    if (monitor->shard_count > 0)
+        shard_barrier(monitor);
+}
+
+/*
+ * Format the report of the sorted array engine, only changes since previous report in delta mode
+ */
+static void array_report(t_monitor* monitor) {
+    
+    if (monitor->delta_mode) {
+        array_flush(monitor);
+        delta_report(monitor);
+    }
+    else {
+        if (monitor->batch_mode)
+            flush_batch(monitor);
+        report(monitor);
+    }
+}
+
+/*
+ * Print statistics of the sorted array engine, summed over every relation table
+ */
+static void array_stats(t_monitor* monitor, FILE* out) {
+    
+    int i;
+    size_t rel_count = 0, rebuilds = 0;
+    double time = 0;
+    t_rel_table* table;
+    
+    for (i=0; i<(monitor->shard_count > 0 ? monitor->shard_count : 1); i++) { // sum every relation table
+        table = (monitor->shard_count > 0) ? &monitor->shard_arr[i].table : &monitor->rel_table;
+        rel_count += table->rel_count;
+        rebuilds += table->hash_rebuilds;
+        time += table->hash_time;
+    }
+    
+    fprintf(out, "relations: %zu\n", rel_count);
+    fprintf(out, "relation hash rebuilds: %zu, total %.3f ms, avg %.3f us\n", rebuilds, time*1e3, 
+            rebuilds ? time*1e6/rebuilds : 0.0);
+    if (monitor->shard_count > 0)
+        fprintf(out, "shards: %d\n", monitor->shard_count);
+}
+
+/*
+ * Print every relation structure of the sorted array engine
+ */
+static void array_dump(t_monitor* monitor, FILE* out) {
+    
+    int i;
+    
+    if (monitor->shard_count > 0)
+        for (i=0; i<monitor->shard_count; i++)
+            print_rel_arr(out, &monitor->shard_arr[i].table);
+    else
+        print_rel_arr(out, &monitor->rel_table);
+}
+
+/*
+ * Write every relation of the sorted array engine, one relation table after the other
+ */
+static void array_save(t_monitor* monitor, FILE* out) {
+    
+    int i;
+    
+    if (monitor->shard_count > 0)
+        for (i=0; i<monitor->shard_count; i++)
+            save_rel_table(out, &monitor->shard_arr[i].table);
+    else
+        save_rel_table(out, &monitor->rel_table);
+}
+
+/*
+ * Write an addrel for every origin of every destination of every relation of the table
+ */
+static void save_rel_table(FILE* out, t_rel_table* table) {
+    
+    size_t i;
+    uint32_t j, k, n;
+    t_rel_str* el;
+    t_dest_str* dest_str;
+    
+    for (i=0; i<table->rel_count; i++) {
+        el = &table->rel_arr[i];
+        for (j=0; j<el->dest_count; j++) {
+            dest_str = &el->dest_of[j];
+            n = dest_str->is_hash ? dest_str->dest_of_size : el->dest_of_count[j];     // hash sets have empty slots
+            for (k=0; k<n; k++)
+                if (dest_str->dest_of[k] != NULL)
+                    fprintf(out, "addrel %s %s %s\n", dest_str->dest_of[k], el->dest_arr[j], el->cold->rel);
+        }
+    }
+}
+
+/*
+ * Find free or matching slot of a peephole hash index with linear probing. 
+ * Key is an entity name or an edge command, depending on match (0 entity, 1 edge)
+ */
+static inline int* peep_index_slot(t_monitor* monitor, int* index, const size_t size, uint64_t h, const int match, void* key) {
+    
+    size_t i = h & (size - 1);
+    t_peep_ent* ent;
+    t_peep_rel *rel, *other;
+    
+    for (; index[i] != 0; i = (i + 1) & (size - 1)) {
+        if (match == 0) {
+            ent = &monitor->peep_ent_arr[index[i] - 1];
+            if (strcmp(name_copy_str(&ent->name), (char*)key) == 0)
+                return &index[i];
+        }
+        else {
+            rel = &monitor->peep_rel_arr[index[i] - 1];
+            other = (t_peep_rel*)key;
+            if (name_copy_compare(&rel->orig, &other->orig) == 0 && name_copy_compare(&rel->dest, &other->dest) == 0 && 
+                    name_copy_compare(&rel->rel, &other->rel) == 0)
+                return &index[i];
+        }
+    }
+    
+    return &index[i];
+}
+
+/*
+ * Double the size of a peephole hash index and reinsert every entry. Return new index
+ */
+static int* peep_index_grow(t_monitor* monitor, int* index, size_t* size, const int is_rel) {
+    
+    int i;
+    uint64_t h;
+    const size_t count = is_rel ? monitor->peep_rel_count : monitor->peep_ent_count;
+    
+    free(index);
+    *size = (*size) << 1;
+    index = calloc(*size, sizeof(int));
+    
+    for (i=0; i<count; i++) {
+        h = is_rel ? hash_mix(hash_string(name_copy_str(&monitor->peep_rel_arr[i].orig)) ^ hash_string(name_copy_str(&monitor->peep_rel_arr[i].dest)), 
+                              hash_string(name_copy_str(&monitor->peep_rel_arr[i].rel))) 
+                   : hash_string(name_copy_str(&monitor->peep_ent_arr[i].name));
+        *peep_index_slot(monitor, index, *size, h, is_rel, is_rel ? (void*)&monitor->peep_rel_arr[i] : (void*)name_copy_str(&monitor->peep_ent_arr[i].name)) = i + 1;
+    }
+    
+    return index;
+}
+
+/*
+ * Find pending state of an entity. 
+ * If asked, create it from the engine state when it's not pending yet. Return NULL if not found
+ */
+static t_peep_ent* peep_find_ent(t_monitor* monitor, char* name, const int create) {
+    
+    int* slot = peep_index_slot(monitor, monitor->peep_ent_index, monitor->peep_ent_index_size, hash_string(name), 0, name);
+    t_peep_ent* ent;
+    
+    if (*slot != 0)
+        return &monitor->peep_ent_arr[*slot - 1];
+    if (!create)
+        return NULL;
+    
+    if (monitor->peep_ent_count == monitor->peep_ent_size) {        // double size if full
+        monitor->peep_ent_size = monitor->peep_ent_size << 1;
+        monitor->peep_ent_arr = realloc(monitor->peep_ent_arr, monitor->peep_ent_size * sizeof(t_peep_ent));
+    }
+    
+    ent = &monitor->peep_ent_arr[monitor->peep_ent_count];
+    name_copy_set(&ent->name, name, strlen(name));                  // freed when the window is emptied
+    ent->base = ent->exists = (search_entity(monitor, name) != NULL);
+    ent->wiped = 0;
+    ent->del_seq = 0;
+    *slot = ++monitor->peep_ent_count;
+    
+    if (monitor->peep_ent_count << 1 > monitor->peep_ent_index_size) // keep load under one half
+        monitor->peep_ent_index = peep_index_grow(monitor, monitor->peep_ent_index, &monitor->peep_ent_index_size, 0);
+    
+    return ent;
+}
+
+/*
+ * Find pending command of an edge, creating an empty one if asked. Return NULL if not found
+ */
+static t_peep_rel* peep_find_rel(t_monitor* monitor, char* orig, char* dest, char* rel, const int create) {
+    
+    t_peep_rel* el;
+    int* slot;
+    
+    if (monitor->peep_rel_count == monitor->peep_rel_size) {        // double size if full, last element is used as key
+        monitor->peep_rel_size = monitor->peep_rel_size << 1;
+        monitor->peep_rel_arr = realloc(monitor->peep_rel_arr, monitor->peep_rel_size * sizeof(t_peep_rel));
+    }
+    
+    el = &monitor->peep_rel_arr[monitor->peep_rel_count];
+    name_copy_set(&el->orig, orig, strlen(orig));                   // kept only if a new edge is created
+    name_copy_set(&el->dest, dest, strlen(dest));
+    name_copy_set(&el->rel, rel, strlen(rel));
+    slot = peep_index_slot(monitor, monitor->peep_rel_index, monitor->peep_rel_index_size, hash_mix(hash_string(orig) ^ hash_string(dest), hash_string(rel)), 1, el);
+    
+    if (*slot != 0 || !create) {
+        name_copy_free(&el->orig);
+        name_copy_free(&el->dest);
+        name_copy_free(&el->rel);
+        return (*slot != 0) ? &monitor->peep_rel_arr[*slot - 1] : NULL;
+    }
+    
+    *slot = ++monitor->peep_rel_count;
+    if (monitor->peep_rel_count << 1 > monitor->peep_rel_index_size) // keep load under one half
+        monitor->peep_rel_index = peep_index_grow(monitor, monitor->peep_rel_index, &monitor->peep_rel_index_size, 1);
+    
+    return el;
+}
+
+/*
+ * Tell if an entity exists once pending commands are applied
+ */
+static inline int peep_exists(t_monitor* monitor, char* name) {
+    
+    t_peep_ent* ent = peep_find_ent(monitor, name, 0);
+    
+    return (ent != NULL) ? ent->exists : (search_entity(monitor, name) != NULL);
+}
+
+/*
+ * Add entity through the peephole optimizer
+ */
+static void peep_add_ent(t_monitor* monitor, char* ent) {
+    
+    monitor->peep_in++;
+    peep_find_ent(monitor, ent, 1)->exists = 1;
+}
+
+/*
+ * Delete entity through the peephole optimizer. 
+ * Every pending command on its edges becomes dead, the engine has to delete it only if it had it
+ */
+static void peep_del_ent(t_monitor* monitor, char* ent) {
+    
+    t_peep_ent* el = peep_find_ent(monitor, ent, 1);
+    
+    monitor->peep_in++;
+    if (!el->exists)                                    // nothing to delete
+        return;
+    
+    el->exists = 0;
+    el->del_seq = monitor->peep_seq++;
+    if (el->base)
+        el->wiped = 1;
+}
+
+/*
+ * Add or delete an edge through the peephole optimizer. 
+ * Commands on missing entities do nothing and are dropped, else only the last command of an edge is kept
+ */
+static void peep_rel(t_monitor* monitor, char* orig, char* dest, char* rel, const int add) {
+    
+    t_peep_rel* el;
+    
+    monitor->peep_in++;
+    if (!peep_exists(monitor, orig) || !peep_exists(monitor, dest))
+        return;
+    
+    el = peep_find_rel(monitor, orig, dest, rel, 1);
+    el->add = add;
+    el->seq = monitor->peep_seq++;
+    
+    if (monitor->peep_rel_count + monitor->peep_ent_count >= PEEP_WINDOW_SIZE) // bound memory of the window
+        flush_peephole(monitor);
+}
+
+/*
+ * Send the net effect of pending commands to the engine: 
+ * first entity deletions, then entity additions, then the last command of every edge still alive
+ */
+static void flush_peephole(t_monitor* monitor) {
+    
+    int i;
+    t_peep_ent *el, *orig_el, *dest_el;
+    t_peep_rel* rel_el;
+    
+    for (i=0; i<monitor->peep_ent_count; i++) {         // delete entities that existed in engine
+        el = &monitor->peep_ent_arr[i];
+        if (el->wiped) {
+            apply_del_ent(monitor, name_copy_str(&el->name));
+            monitor->peep_out++;
+        }
+    }
+    
+    for (i=0; i<monitor->peep_ent_count; i++) {         // add entities that engine does not have anymore or yet
+        el = &monitor->peep_ent_arr[i];
+        if (el->exists && (!el->base || el->wiped)) {
+            add_entity(monitor, name_copy_str(&el->name));
+            monitor->peep_out++;
+        }
+    }
+    
+    for (i=0; i<monitor->peep_rel_count; i++) {         // edges, skipping the ones killed by a later delent
+        rel_el = &monitor->peep_rel_arr[i];
+        orig_el = peep_find_ent(monitor, name_copy_str(&rel_el->orig), 0);
+        dest_el = peep_find_ent(monitor, name_copy_str(&rel_el->dest), 0);
+        if ((orig_el != NULL && rel_el->seq < orig_el->del_seq) || (dest_el != NULL && rel_el->seq < dest_el->del_seq))
+            continue;
+        apply_rel(monitor, name_copy_str(&rel_el->orig), name_copy_str(&rel_el->dest), name_copy_str(&rel_el->rel), rel_el->add);
+        monitor->peep_out++;
+    }
+    
+    // empty the window
+    free_peep_names(monitor);
+    if (monitor->peep_ent_count > 0)
+        memset(monitor->peep_ent_index, 0, monitor->peep_ent_index_size * sizeof(int));
+    if (monitor->peep_rel_count > 0)
+        memset(monitor->peep_rel_index, 0, monitor->peep_rel_index_size * sizeof(int));
+    monitor->peep_ent_count = monitor->peep_rel_count = 0;
+}
+
+/*
+ * Free names copied by pending entities and edges, the window is emptied by the caller
+ */
+static void free_peep_names(t_monitor* monitor) {
+    
+    int i;
+    
+    for (i=0; i<monitor->peep_ent_count; i++)
+        name_copy_free(&monitor->peep_ent_arr[i].name);
+    for (i=0; i<monitor->peep_rel_count; i++) {
+        name_copy_free(&monitor->peep_rel_arr[i].orig);
+        name_copy_free(&monitor->peep_rel_arr[i].dest);
+        name_copy_free(&monitor->peep_rel_arr[i].rel);
+    }
+}
+
+/*
+ * Format the report results into report text, one line terminated by newline
+ */
+static void report(t_monitor* monitor) {
+    
+    int i;
+    t_rel_table* table = &monitor->rel_table;
+    
+    monitor->report_text.len = 0;
+    
+    if (monitor->shard_count > 0)
+        report_shards(monitor);
+    
+    else if (table->rel_count == 0)                     // no elements, print none
+        text_append(&monitor->report_text, "none", 4);
+    
+    else {
+        mem_prefetch(table->rel_arr, table->rel_count * sizeof(t_rel_str));
+        for (i=0; i<table->rel_count; i++)              // for every element in report array
+            format_rel_str(&monitor->report_text, &table->rel_arr[i]);
+    }
+    
+    text_append(&monitor->report_text, "\n", 1);
+}
+
+/*
+ * Append a string to a text buffer
+ */
+static inline void text_append(t_text* text, const char* s, const size_t len) {
+    
+    while (text->len + len > text->size) {              // double size if full
+        text->size = text->size << 1;
+        text->buf = realloc(text->buf, text->size);
+    }
+    
+    memcpy(text->buf + text->len, s, len);
+    text->len += len;
+}
+
+/*
+ * Format one relation of the report: name, most receivers entities in order and number of relation received
+ */
+static void format_rel_str(t_text* text, t_rel_str* el) {
+    
+    int j;
+    char number[16];
+    
+    qsort(el->most_dest_arr, el->most_dest_count, sizeof(char*), string_compare);       // sorting most dest arr for printing
+    
+    text_append(text, el->cold->rel, name_len(el->cold->rel));      // first print rel name
+    text_append(text, " ", 1);
+    
+    for (j=0; j<el->most_dest_count; j++) {                         // second print most receivers entities
+        text_append(text, el->most_dest_arr[j], name_len(el->most_dest_arr[j]));
+        text_append(text, " ", 1);
+    }
+    
+    text_append(text, number, snprintf(number, sizeof(number), "%" PRIu32 "; ", el->n_most_dest));     // third print number of relation received
+}
+
+/*
+ * Start worker threads of the sharded engine, each with an empty relation table
+ */
+static void start_shards(t_monitor* monitor) {
+    
+    int i;
+    t_shard* shard;
+    
+    monitor->shard_arr = calloc(monitor->shard_count, sizeof(t_shard));
+    for (i=0; i<monitor->shard_count; i++) {
+        shard = &monitor->shard_arr[i];
+        init_rel_table(&shard->table);
+        
+        shard->queue = malloc(SHARD_QUEUE_SIZE * sizeof(t_shard_cmd));
+        shard->stage = malloc(SHARD_CHUNK_SIZE * sizeof(t_shard_cmd));
+        shard->head = shard->tail = shard->stage_count = 0;
+        pthread_mutex_init(&shard->lock, NULL);
+        pthread_cond_init(&shard->not_empty, NULL);
+        pthread_cond_init(&shard->not_full, NULL);
+        
+        shard->frag.len = 0;
+        shard->frag.size = TEXT_SIZE;
+        shard->frag.buf = malloc(shard->frag.size);
+        shard->frag_off_size = RELATION_ARRAY_SIZE;
+        shard->frag_off = malloc(shard->frag_off_size * sizeof(size_t));
+        
+        pthread_create(&shard->thread, NULL, shard_main, shard);
+    }
+}
+
+/*
+ * Stop and free worker threads of the sharded engine. Pending commands are applied first
+ */
+static void stop_shards(t_monitor* monitor) {
+    
+    int i;
+    t_shard* shard;
+    
+    for (i=0; i<monitor->shard_count; i++) {
+        shard_push(&monitor->shard_arr[i], SHARD_STOP, NULL, NULL, NULL);
+        shard_flush(&monitor->shard_arr[i]);
+    }
+    
+    for (i=0; i<monitor->shard_count; i++) {
+        shard = &monitor->shard_arr[i];
+        pthread_join(shard->thread, NULL);
+        
+        free_rel_table(&shard->table);
+        free(shard->queue);
+        free(shard->stage);
+        free(shard->frag.buf);
+        free(shard->frag_off);
+        pthread_mutex_destroy(&shard->lock);
+        pthread_cond_destroy(&shard->not_empty);
+        pthread_cond_destroy(&shard->not_full);
+    }
+    free(monitor->shard_arr);
+}
+
+/*
+ * Find the shard owning a relation, by hash of its name
+ */
+static inline t_shard* shard_of(t_monitor* monitor, char* rel) {
+    
+    return &monitor->shard_arr[hash_string(rel) % monitor->shard_count];
+}
+
+/*
+ * Stage a command for a shard. Staged commands are pushed when the chunk is full or at a barrier
+ */
+static void shard_push(t_shard* shard, const int op, char* orig, char* dest, char* rel) {
+    
+    t_shard_cmd* cmd = &shard->stage[shard->stage_count++];
+    
+    cmd->op = op;
+    cmd->orig = orig;
+    cmd->dest = dest;
+    if (rel != NULL)
+        name_copy_set(&cmd->rel, rel, strlen(rel));
+    else
+        name_copy_set(&cmd->rel, "", 0);
+    
+    if (shard->stage_count == SHARD_CHUNK_SIZE)
+        shard_flush(shard);
+}
+
+/*
+ * Move staged commands into the shard queue, waiting for room if the worker is behind. 
+ * Slots past head are never read by the worker, so they are written outside the lock
+ */
+static void shard_flush(t_shard* shard) {
+    
+    size_t i, head;
+    
+    if (shard->stage_count == 0)
+        return;
+    
+    pthread_mutex_lock(&shard->lock);
+    while (shard->head - shard->tail + shard->stage_count > SHARD_QUEUE_SIZE)
+        pthread_cond_wait(&shard->not_full, &shard->lock);
+    head = shard->head;
+    pthread_mutex_unlock(&shard->lock);
+    
+    for (i=0; i<shard->stage_count; i++)
+        shard->queue[(head + i) & (SHARD_QUEUE_SIZE - 1)] = shard->stage[i];
+    
+    pthread_mutex_lock(&shard->lock);
+    shard->head = head + shard->stage_count;
+    pthread_cond_signal(&shard->not_empty);
+    pthread_mutex_unlock(&shard->lock);
+    
+    shard->stage_count = 0;
+}
+
+/*
+ * Wait until every shard applied all its commands. 
+ * After this main thread can read shard tables until next push
+ */
+static void shard_barrier(t_monitor* monitor) {
+    
+    int i;
+    t_shard* shard;
+    
+    for (i=0; i<monitor->shard_count; i++)          // let every shard work while waiting for the first one
+        shard_flush(&monitor->shard_arr[i]);
+    
+    for (i=0; i<monitor->shard_count; i++) {
+        shard = &monitor->shard_arr[i];
+        pthread_mutex_lock(&shard->lock);
+        while (shard->tail != shard->head)
+            pthread_cond_wait(&shard->not_full, &shard->lock);
+        pthread_mutex_unlock(&shard->lock);
+    }
+}
+
+/*
+ * Body of each worker thread. 
+ * Commands are applied in place, then tail is moved forward a chunk at a time to make room
+ */
+static void* shard_main(void* arg) {
+    
+    t_shard* shard = (t_shard*)arg;
+    size_t tail, head;
+    int stop = 0;
+    
+    while (!stop) {
+        pthread_mutex_lock(&shard->lock);
+        while (shard->tail == shard->head)
+            pthread_cond_wait(&shard->not_empty, &shard->lock);
+        tail = shard->tail;
+        head = shard->head;
+        pthread_mutex_unlock(&shard->lock);
+        
+        if (head - tail > SHARD_CHUNK_SIZE)
+            head = tail + SHARD_CHUNK_SIZE;
+        for (; tail != head && !stop; tail++)
+            stop = shard_apply(shard, &shard->queue[tail & (SHARD_QUEUE_SIZE - 1)]);
+        
+        pthread_mutex_lock(&shard->lock);
+        shard->tail = tail;
+        pthread_cond_signal(&shard->not_full);
+        pthread_mutex_unlock(&shard->lock);
+    }
+    
+    return NULL;
+}
+
+/*
+ * Apply one command inside a shard. Return 1 if the worker has to stop
+ */
+static int shard_apply(t_shard* shard, t_shard_cmd* cmd) {
+    
+    switch (cmd->op) {
+        case SHARD_ADD_REL:
+            insert_rel(&shard->table, cmd->orig, cmd->dest, name_copy_str(&cmd->rel));
+            name_copy_free(&cmd->rel);
+            break;
+        case SHARD_DEL_REL:
+            remove_rel(&shard->table, cmd->orig, cmd->dest, name_copy_str(&cmd->rel));
+            name_copy_free(&cmd->rel);
+            break;
+        case SHARD_DEL_ENT:
+            remove_ent(&shard->table, cmd->orig);
+            break;
+        case SHARD_REPORT:
+            shard_format(shard);
+            break;
+        case SHARD_STOP:
+            return 1;
+    }
+    
+    return 0;
+}
+
+
+/*
+ * Format report fragment of every relation owned by a shard, same format as report
+ */
+static void shard_format(t_shard* shard) {
+    
+    int i;
+    t_rel_table* table = &shard->table;
+    
+    if (table->rel_count + 1 > shard->frag_off_size) {
+        shard->frag_off_size = table->rel_size + 1;
+        shard->frag_off = realloc(shard->frag_off, shard->frag_off_size * sizeof(size_t));
+    }
+    
+    shard->frag.len = 0;
+    for (i=0; i<table->rel_count; i++) {
+        shard->frag_off[i] = shard->frag.len;
+        format_rel_str(&shard->frag, &table->rel_arr[i]);
+    }
+    shard->frag_off[table->rel_count] = shard->frag.len;
+}
+
+/*
+ * Format the report. 
+ * Every shard formats its own relations in parallel, already in order, then fragments are merged by relation name
+ */
+static void report_shards(t_monitor* monitor) {
+    
+    int i, best;
+    size_t total = 0;
+    t_shard* shard;
+    
+    for (i=0; i<monitor->shard_count; i++)
+        shard_push(&monitor->shard_arr[i], SHARD_REPORT, NULL, NULL, NULL);
+    shard_barrier(monitor);
+    
+    for (i=0; i<monitor->shard_count; i++) {
+        monitor->shard_arr[i].frag_next = 0;
+        total += monitor->shard_arr[i].table.rel_count;
+    }
+    
+    if (total == 0)                                     // no elements, print none
+        text_append(&monitor->report_text, "none", 4);
+    
+    for (; total > 0; total--) {                        // print smallest relation among the heads of each shard
+        best = -1;
+        for (i=0; i<monitor->shard_count; i++) {
+            shard = &monitor->shard_arr[i];
+            if (shard->frag_next < shard->table.rel_count && (best == -1 || 
+                    strcmp(shard->table.rel_arr[shard->frag_next].cold->rel, 
+                           monitor->shard_arr[best].table.rel_arr[monitor->shard_arr[best].frag_next].cold->rel) < 0))
+                best = i;
+        }
+        shard = &monitor->shard_arr[best];
+        text_append(&monitor->report_text, shard->frag.buf + shard->frag_off[shard->frag_next], 
+                    shard->frag_off[shard->frag_next + 1] - shard->frag_off[shard->frag_next]);
+        shard->frag_next++;
+    }
+}
+
+/*
+ * Read commands from input until 'end' is reached, reports are printed on output. Lines have any length.
+ * Input can also be a binary trace written by trace_convert, told apart by its first line
+ */
+void monitor_execute(t_monitor* monitor, FILE* input, FILE* output) {
+    
+    char* buffer = NULL;                // buffer for each line, grown by getline
+    size_t cap = 0;                     // size of buffer
+    char command[COMMAND_SIZE];         // command
+    const char* text;                   // reply of the command
+    size_t len;
+    
+    mem_store = monitor->store;
+    if (monitor->snapshot_mode)
+        start_reporter(monitor, output);
+    
+    command[0] = '\0';
+    if (getline(&buffer, &cap, input) > 0)        // read first line
+        sscanf(buffer, "%7s", command);
+    
+    if (buffer != NULL && strcmp(buffer, TRACE_MAGIC) == 0) {     // binary trace, replayed without parsing
+        replay_trace(monitor, input, output);
+        strcpy(command, "end");
+    }
+
+    while(strcmp(command, "end") != 0) {                      // if not "end" command, continues to read
+
+        if (monitor->snapshot_mode && strcmp(command, "report") == 0) {    // printed by reporter thread while next commands are applied
+            monitor_publish(monitor);
+            reporter_push(monitor, acquire_snapshot(monitor));
+        }
+        
+        else if ((text = monitor_command(monitor, buffer, &len)) != NULL) {
+            if (monitor->snapshot_mode)                             // reports queued before must be printed first
+                reporter_wait(monitor);
+            fwrite(text, 1, len, output);
+        }
+        
+        command[0] = '\0';
+        if (getline(&buffer, &cap, input) > 0)
+            sscanf(buffer, "%7s", command);
+        else
+            break;
+    }   
+    free(buffer);
+    
+    flush_pending(monitor);                             // leave a consistent state behind
+    if (monitor->snapshot_mode)
+        stop_reporter(monitor);                         // every report is printed on return
+    monitor_checkpoint_poll(monitor, 1);                // and every checkpoint is written
+}
+
+/*
+ * Replay a binary trace. Names are read once in the dictionary and entities are resolved once per id,
+ * so records reach the engine without tokenizing nor dictionary lookups. Peephole and approximate modes
+ * keep their own state by name and get names as the text grammar would
+ */
+static void replay_trace(t_monitor* monitor, FILE* input, FILE* output) {
+    
+    t_trace_header header;
+    t_trace_record* rec = malloc(TRACE_CHUNK * sizeof(t_trace_record));
+    t_replay replay;
+    char* bytes = NULL;
+    uint64_t i, off, left;
+    size_t j, n = 0;
+    int status = 0;
+    
+    memset(&replay, 0, sizeof(replay));
+    if (fread(&header, sizeof(header), 1, input) == 1 && replay_header_valid(&header, input) &&
+        (bytes = malloc(header.names_bytes + 1)) != NULL &&
+        fread(bytes, 1, header.names_bytes, input) == header.names_bytes &&
+        (replay.name = malloc(((size_t)header.name_count + 1) * sizeof(char*))) != NULL &&
+        (replay.ent = malloc(((size_t)header.name_count + 1) * sizeof(char*))) != NULL &&
+        (replay.resolved = calloc((size_t)header.name_count + 1, sizeof(uint8_t))) != NULL) {
+        bytes[header.names_bytes] = '\0';
+        replay.name_count = header.name_count;
+        replay.direct = !monitor->peep_mode && monitor->engine->edge != NULL;
+    
+        for (i=0, off=0; i<header.name_count && off<header.names_bytes; i++) {  // split names
+            replay.name[i] = bytes + off;
+            off += strlen(bytes + off) + 1;
+        }
+        status = i < header.name_count ? -1 : 0;
+    
+        for (left=header.record_count; status == 0 && left > 0; left-=n) {
+            n = fread(rec, sizeof(t_trace_record), left < TRACE_CHUNK ? left : TRACE_CHUNK, input);
+            if (n == 0)                                 // truncated
+                status = -1;
+            for (j=0; j<n && status == 0; j++)
+                status = replay_record(monitor, &replay, &rec[j], output);
+        }
+    }
+    else
+        status = -1;
+    
+    if (status < 0)
+        fprintf(stderr, "corrupt binary trace\n");
+    
+    free(rec);
+    free(bytes);
+    free(replay.name);
+    free(replay.ent);
+    free(replay.resolved);
+}
+
+/*
+ * Every name takes at least its terminator, and names of a regular file cannot go past its end.
+ * Input that is not a regular file is only checked by reading it
+ */
+static int replay_header_valid(const t_trace_header* header, FILE* input) {
+    
+    struct stat st;
+    long pos;
+    
+    if (header->name_count > header->names_bytes || header->names_bytes >= SIZE_MAX)
+        return 0;
+    if (fstat(fileno(input), &st) == 0 && S_ISREG(st.st_mode) && (pos = ftell(input)) >= 0)
+        return header->names_bytes <= (uint64_t)(st.st_size - pos);
+    
+    return 1;
+}
+
+/*
+ * Apply one record as the matching text command. Edges between resolved entities skip the entity dictionary,
+ * batched and ttl edges go through the usual path
+ */
+static int replay_record(t_monitor* monitor, t_replay* replay, t_trace_record* rec, FILE* output) {
+    
+    uint32_t* arg = rec->arg;
+    char *orig, *dest;
+    
+    switch (rec->op) {
+    case TRACE_ADDENT:
+    case TRACE_DELENT:
+        if (arg[0] >= replay->name_count)
+            return -1;
+        if (rec->op == TRACE_ADDENT) {
+            monitor_add_entity(monitor, replay->name[arg[0]]);
+            replay->resolved[arg[0]] = 0;                   // looked up at its next edge
+        }
+        else {
+            monitor_del_entity(monitor, replay->name[arg[0]]);
+            replay->ent[arg[0]] = NULL;
+            replay->resolved[arg[0]] = 1;
+        }
+        return 0;
+    
+    case TRACE_ADDREL:
+    case TRACE_DELREL:
+        if (arg[0] >= replay->name_count || arg[1] >= replay->name_count || arg[2] >= replay->name_count)
+            return -1;
+        if (!replay->direct || monitor->batch_mode || replay->ttl > 0) {
+            if (replay->ttl > 0 && rec->op == TRACE_ADDREL)
+                monitor_add_rel_ttl(monitor, replay->name[arg[0]], replay->name[arg[1]], replay->name[arg[2]], replay->ttl);
+            else if (rec->op == TRACE_ADDREL)
+                monitor_add_rel(monitor, replay->name[arg[0]], replay->name[arg[1]], replay->name[arg[2]]);
+            else
+                monitor_del_rel(monitor, replay->name[arg[0]], replay->name[arg[1]], replay->name[arg[2]]);
+            replay->ttl = 0;
+            return 0;
+        }
+    
+        orig = replay_entity(monitor, replay, arg[0]);
+        dest = replay_entity(monitor, replay, arg[1]);
+        if (orig == NULL || dest == NULL)                   // no relation with a missing entity
+            return 0;
+        monitor->engine->edge(monitor, orig, dest, replay->name[arg[2]], rec->op == TRACE_ADDREL);
+        return 0;
+    
+    case TRACE_REPORT:
+        if (monitor->snapshot_mode) {                       // printed by reporter thread
+            monitor_publish(monitor);
+            reporter_push(monitor, acquire_snapshot(monitor));
+            return 0;
+        }
+        monitor_report(monitor, NULL, 0);
+        fwrite(monitor->report_text.buf, 1, monitor->report_text.len, output);
+        return 0;
+    
+    case TRACE_TOPK:
+        if (arg[0] == 0 || arg[0] > INT32_MAX)
+            return -1;
+        monitor_topk(monitor, arg[0], NULL, 0);
+        if (monitor->snapshot_mode)                         // reports queued before must be printed first
+            reporter_wait(monitor);
+        fwrite(monitor->report_text.buf, 1, monitor->report_text.len, output);
+        return 0;
+    
+    case TRACE_TICK:
+        monitor_tick(monitor, arg[0] | (uint64_t)arg[1] << 32);
+        return 0;
+    
+    case TRACE_TTL:
+        replay->ttl = arg[0] | (uint64_t)arg[1] << 32;
+        return 0;
+    
+    case TRACE_END:
+        return 1;
+    }
+    
+    return -1;
+}
+
+/*
+ * Entity of the engine for a dictionary id. Names in the entity dictionary do not move while the entity lives
+ */
+static inline char* replay_entity(t_monitor* monitor, t_replay* replay, const uint32_t id) {
+    
+    if (!replay->resolved[id]) {
+        replay->ent[id] = search_entity(monitor, replay->name[id]);
+        replay->resolved[id] = 1;
+    }
+    
+    return replay->ent[id];
+}
+
+/*
+ * Execute one line of the command grammar of monitor_execute. 
+ * Parse the command and manages operations related to it. Names have any length.
+ * Return the reply of report and topk, newline included, valid until next call on the monitor. NULL for other commands
+ */
+const char* monitor_command(t_monitor* monitor, const char* line, size_t* len) {
+    
+    char* token[TOKEN_COUNT];           // command and its arguments, pointing into line buffer
+    char* command;                      // command
+    char* save;
+    char* end;
+    int tokens;                         // number of tokens read
+    long k;                             // number of receivers of topk
+    uint64_t ttl;                       // ticks to live of addrel, ticks of tick
+    size_t line_len = strlen(line) + 1;
+    
+    mem_store = monitor->store;
+    if (monitor->checkpoint_pid != 0 && ++monitor->checkpoint_polls % CHECKPOINT_POLL == 0)
+        monitor_checkpoint_poll(monitor, 0);                        // end of a checkpoint is reported within a few commands
+    
+    while (line_len > monitor->line_size) {                         // double size if full
+        monitor->line_size = monitor->line_size << 1;
+        monitor->line = realloc(monitor->line, monitor->line_size);
+    }
+    memcpy(monitor->line, line, line_len);
+    
+    tokens = 0;                                                     // split on blanks, as sscanf does
+    token[0] = strtok_r(monitor->line, " \t\r\n\v\f", &save);
+    while (token[tokens] != NULL && ++tokens < TOKEN_COUNT)
+        token[tokens] = strtok_r(NULL, " \t\r\n\v\f", &save);
+    if (tokens == 0)
+        return NULL;
+    command = token[0];
+    
+    if (strcmp(command, "addent") == 0) {                           // addent
+        if (tokens >= 2)
+            monitor_add_entity(monitor, token[1]);
+    }   
+    
+    else if (strcmp(command, "delent") == 0) {                      // delent
+        if (tokens >= 2)
+            monitor_del_entity(monitor, token[1]);
+    }   
+
+    else if (strcmp(command, "addrel") == 0) {                      // addrel, optional ttl
+        if (tokens >= 5 && (ttl = strtoull(token[4], &end, 10), end != token[4]))
+            monitor_add_rel_ttl(monitor, token[1], token[2], token[3], ttl);
+        else if (tokens >= 4)
+            monitor_add_rel(monitor, token[1], token[2], token[3]);
+    }   
+    
+    else if (strcmp(command, "delrel") == 0) {                      // delrel
+        if (tokens >= 4)
+            monitor_del_rel(monitor, token[1], token[2], token[3]);
+    }   
+
+    else if (strcmp(command, "report") == 0) {                      // report
+        if (monitor->snapshot_mode) {
+            monitor_publish(monitor);
+            snapshot_text(monitor);
+        }
+        else
+            monitor_report(monitor, NULL, 0);
+        *len = monitor->report_text.len;
+        return monitor->report_text.buf;
+    }
+    
+    else if (strcmp(command, "tick") == 0) {                        // tick, one if not given
+        if (tokens < 2 || (ttl = strtoull(token[1], &end, 10), end == token[1]))
+            ttl = 1;
+        monitor_tick(monitor, ttl);
+    }
+    
+    else if (strcmp(command, "topk") == 0) {                        // topk
+        if (tokens >= 2 && (k = strtol(token[1], &end, 10), end != token[1]) && k > 0 && k <= INT32_MAX) {
+            monitor_topk(monitor, (int)k, NULL, 0);
+            *len = monitor->report_text.len;
+            return monitor->report_text.buf;
+        }
+    }
+    
+    else if (strcmp(command, "checkpoint") == 0) {                  // checkpoint, written in background
+        if (tokens >= 2)
+            monitor_checkpoint(monitor, token[1]);
+    }
+    
+    return NULL;
+}
+
+/*
+ * Add entity, its name is copied
+ */
+void monitor_add_entity(t_monitor* monitor, const char* ent) {
+    
+    mem_store = monitor->store;
+    if (monitor->peep_mode)
+        peep_add_ent(monitor, (char*)ent);
+    else
+        add_entity(monitor, (char*)ent);
+}
+
+/*
+ * Delete entity and every relation it is part of
+ */
+void monitor_del_entity(t_monitor* monitor, const char* ent) {
+    
+    mem_store = monitor->store;
+    if (monitor->peep_mode)
+        peep_del_ent(monitor, (char*)ent);
+    else
+        apply_del_ent(monitor, (char*)ent);
+}
+
+/*
+ * Add relation from orig to dest, ignored if one of the entity is missing
+ */
+void monitor_add_rel(t_monitor* monitor, const char* orig, const char* dest, const char* rel) {
+    
+    mem_store = monitor->store;
+    if (monitor->peep_mode)
+        peep_rel(monitor, (char*)orig, (char*)dest, (char*)rel, 1);
+    else
+        apply_rel(monitor, (char*)orig, (char*)dest, (char*)rel, 1);
+}
+
+/*
+ * Delete relation from orig to dest, if exists
+ */
+void monitor_del_rel(t_monitor* monitor, const char* orig, const char* dest, const char* rel) {
+    
+    mem_store = monitor->store;
+    if (monitor->peep_mode)
+        peep_rel(monitor, (char*)orig, (char*)dest, (char*)rel, 0);
+    else
+        apply_rel(monitor, (char*)orig, (char*)dest, (char*)rel, 0);
+}
+
+/*
+ * Format the report line, same text printed for the report command, newline included. 
+ * At most size - 1 characters are copied into buffer, always terminated if size > 0. 
+ * Return the length of the whole line, so that a bigger buffer can be passed again if it was cut
+ */
+size_t monitor_report(t_monitor* monitor, char* buffer, size_t size) {
+    
+    size_t len;
+    
+    mem_store = monitor->store;
+    if (monitor->snapshot_mode) {
+        monitor_publish(monitor);
+        return monitor_snapshot_report(monitor, buffer, size);
+    }
+    
+    if (monitor->peep_mode)
+        flush_peephole(monitor);
+    monitor->engine->report(monitor);
+    
+    if (buffer != NULL && size > 0) {
+        len = (monitor->report_text.len < size) ? monitor->report_text.len : size - 1;
+        memcpy(buffer, monitor->report_text.buf, len);
+        buffer[len] = '\0';
+    }
+    
+    return monitor->report_text.len;
+}
+
+/*
+ * Print entity dictionary and every relation structure, for debugging
+ */
+void monitor_dump(t_monitor* monitor, FILE* out) {
+    
+    mem_store = monitor->store;
+    flush_pending(monitor);
+    print_ent_arr(monitor, out);
+    monitor->engine->dump(monitor, out);
+}
+
+/*
+ * Start a checkpoint of the whole state into path. Pending commands are applied, then a child process is forked:
+ * it writes the state from its copy-on-write view of the memory while this one goes on with the next commands,
+ * the pages they change are copied by the kernel. Commands only wait for the flush and for the fork.
+ * Return 0 if the checkpoint started, -1 if one is still running, the engine cannot save, in out-of-core mode or fork failed
+ */
+int monitor_checkpoint(t_monitor* monitor, const char* path) {
+    
+    double start = now_seconds();
+    pid_t pid;
+    
+    if (monitor_checkpoint_poll(monitor, 0)) {                  // a finished one is reported first
+        fprintf(stderr, "checkpoint %s: %s is still being written, ignored\n", path, monitor->checkpoint_path);
+        return -1;
+    }
+    if (monitor->engine->save == NULL) {
+        fprintf(stderr, "checkpoint is not available with approximate mode, ignored\n");
+        return -1;
+    }
+    if (monitor->store != NULL) {                               // shared pages of the store are not copied on write
+        fprintf(stderr, "checkpoint is not available with out-of-core mode, ignored\n");
+        return -1;
+    }
+    
+    flush_pending(monitor);                                     // the writer reads relation tables only
+    pid = fork();
+    if (pid == 0)                                               // writer, leaves without flushing stdio buffers of the parent
+        _exit(checkpoint_write(monitor, path));
+    if (pid < 0) {
+        perror("checkpoint");
+        monitor->checkpoint_failed++;
+        return -1;
+    }
+    
+    monitor->checkpoint_faults = minor_faults();
+    monitor->checkpoint_pid = pid;
+    free(monitor->checkpoint_path);
+    monitor->checkpoint_path = strdup(path);
+    monitor->checkpoint_start = start;
+    monitor->checkpoint_pause = now_seconds() - start;
+    monitor->checkpoint_polls = 0;
+    if (monitor->checkpoint_pause > monitor->checkpoint_max_pause)
+        monitor->checkpoint_max_pause = monitor->checkpoint_pause;
+    
+    return 0;
+}
+
+/*
+ * Check if the running checkpoint is over, waiting for it if asked. When it is, print on stderr how long it took,
+ * how long commands waited for it to start and the page faults of both processes meanwhile: those of this one
+ * are mostly copies of the pages changed by commands while the writer was reading them.
+ * Return 1 if a checkpoint is still running, 0 else
+ */
+int monitor_checkpoint_poll(t_monitor* monitor, const int wait) {
+    
+    struct rusage usage;
+    int status;
+    pid_t pid;
+    
+    if (monitor->checkpoint_pid == 0)
+        return 0;
+    
+    do
+        pid = wait4(monitor->checkpoint_pid, &status, wait ? 0 : WNOHANG, &usage);
+    while (pid < 0 && errno == EINTR);
+    if (pid == 0)
+        return 1;
+    
+    if (pid < 0)
+        fprintf(stderr, "checkpoint %s: writer lost, %s\n", monitor->checkpoint_path, strerror(errno));
+    else if (WIFSIGNALED(status))
+        fprintf(stderr, "checkpoint %s: writer killed by signal %d\n", monitor->checkpoint_path, WTERMSIG(status));
+    else if (WEXITSTATUS(status) != 0)
+        fprintf(stderr, "checkpoint %s: %s\n", monitor->checkpoint_path, strerror(WEXITSTATUS(status)));
+    else
+        fprintf(stderr, "checkpoint %s: written in %.1f ms, commands paused %.3f ms, %ld page faults of the monitor "
+                "and %ld of the writer meanwhile\n", monitor->checkpoint_path, (now_seconds() - monitor->checkpoint_start) * 1e3,
+                monitor->checkpoint_pause * 1e3, minor_faults() - monitor->checkpoint_faults, usage.ru_minflt);
+    
+    if (pid > 0 && WIFEXITED(status) && WEXITSTATUS(status) == 0)
+        monitor->checkpoint_done++;
+    else
+        monitor->checkpoint_failed++;
+    monitor->checkpoint_pid = 0;
+    
+    return 0;
+}
+
+/*
+ * Write the state as commands that rebuild it when executed by an empty monitor: logical time, entities,
+ * pending expiries and relations. The file is written aside and renamed, so path always holds a whole checkpoint.
+ * Runs in the forked writer, which owns no other thread: nothing is printed. Return 0, or the error number
+ */
+static int checkpoint_write(t_monitor* monitor, const char* path) {
+    
+    size_t len = strlen(path);
+    char* tmp = malloc(len + 5);
+    int level, i, status = 0;
+    t_timer* timer;
+    FILE* out;
+    
+    memcpy(tmp, path, len);
+    memcpy(tmp + len, ".tmp", 5);
+    out = fopen(tmp, "w");
+    if (out == NULL) {
+        status = errno;
+        free(tmp);
+        return status;
+    }
+    
+    if (monitor->now > 0)                                       // ttl below count from the same tick
+        fprintf(out, "tick %" PRIu64 "\n", monitor->now);
+    save_entities(monitor, out);
+    
+    // a timer is restored with its relation removed, live relations are added again below
+    for (level=0; level<WHEEL_LEVELS; level++)
+        for (i=0; i<WHEEL_SIZE; i++)
+            for (timer=monitor->wheel[level][i]; timer!=NULL; timer=timer->next)
+                fprintf(out, "addrel %s %s %s %" PRIu64 "\ndelrel %s %s %s\n", name_copy_str(&timer->orig), 
+                        name_copy_str(&timer->dest), name_copy_str(&timer->rel), timer->expire - monitor->now,
+                        name_copy_str(&timer->orig), name_copy_str(&timer->dest), name_copy_str(&timer->rel));
+    
+    monitor->engine->save(monitor, out);
+    
+    if (fflush(out) != 0 || ferror(out) || fsync(fileno(out)) != 0)
+        status = errno ? errno : EIO;
+    if (fclose(out) != 0 && status == 0)
+        status = errno;
+    if (status == 0 && rename(tmp, path) != 0)
+        status = errno;
+    if (status != 0)
+        unlink(tmp);
+    
+    free(tmp);
+    return status;
+}
+
+/*
+ * Write an addent for every entity, in the order of the dictionary
+ */
+static void save_entities(t_monitor* monitor, FILE* out) {
+    
+    uint32_t i;
+    
+    if (monitor->ent_dict == DICT_RADIX)
+        save_radix_tree(out, monitor->radix_root);
+    else if (monitor->ent_dict == DICT_HASH)
+        intern_visit(monitor->intern, save_interned, out);
+    else
+        for (i=0; i<monitor->ent_count; i++)
+            fprintf(out, "addent %s\n", monitor->ent_arr[i]);
+}
+
+/*
+ * Write an addent for every leaf of the radix tree, in order
+ */
+static void save_radix_tree(FILE* out, void* node) {
+    
+    t_radix_node* q;
+    
+    if (node == NULL)
+        return;
+    
+    if ((uintptr_t)node & 1) {
+        q = (t_radix_node*)((uintptr_t)node - 1);
+        save_radix_tree(out, q->child[0]);
+        save_radix_tree(out, q->child[1]);
+    }
+    else
+        fprintf(out, "addent %s\n", (char*)node);
+}
+
+/*
+ * Write an addent for an interned name, arg is the output file
+ */
+static void save_interned(char* name, void* arg) {
+    
+    fprintf((FILE*)arg, "addent %s\n", name);
+}
+
+/*
+ * Seconds since an arbitrary start, monotonic
+ */
+static inline double now_seconds(void) {
+    
+    struct timespec t;
+    
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+/*
+ * Minor page faults of the whole process so far, copies of shared pages included
+ */
+static long minor_faults(void) {
+    
+    struct rusage usage;
+    
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_minflt;
+}
+
+/*
+ * Take entities and relations from the root record of the store left by a previous monitor, with its dictionary.
+ * Return 0 and close the store if that monitor did not close it, or if it was built with other structures
+ */
+static int load_store(t_monitor* monitor, const char* path) {
+    
+    t_store_state* state = store_root(monitor->store);
+    const size_t layout[4] = {sizeof(t_store_state), sizeof(t_rel_str), sizeof(t_rel_cold), sizeof(t_radix_node)};
+    
+    if (!state->clean || memcmp(state->layout, layout, sizeof(layout)) != 0) {
+        fprintf(stderr, "out-of-core file %s was not closed by its monitor or comes from another build, ignored\n", path);
+        store_close(monitor->store);
+        monitor->store = mem_store = NULL;
+        return 0;
+    }
+    
+    monitor->ent_dict = state->ent_dict;
+    monitor->ent_arr = state->ent_arr;
+    monitor->ent_count = state->ent_count;
+    monitor->ent_size = state->ent_size;
+    monitor->radix_root = state->radix_root;
+    monitor->rel_table = state->rel_table;
+    monitor->now = state->now;
+    state->clean = 0;                                       // until closed again, a crash leaves it half changed
+    
+    return 1;
+}
+
+/*
+ * Keep entities and relations in the root record of the store, then write it back and close it.
+ * Pending ttl are not kept, their relations stay
+ */
+static void save_store(t_monitor* monitor) {
+    
+    t_store_state* state = store_root(monitor->store);
+    const size_t layout[4] = {sizeof(t_store_state), sizeof(t_rel_str), sizeof(t_rel_cold), sizeof(t_radix_node)};
+    
+    memcpy(state->layout, layout, sizeof(layout));
+    state->ent_dict = monitor->ent_dict;
+    state->ent_arr = monitor->ent_arr;
+    state->ent_count = monitor->ent_count;
+    state->ent_size = monitor->ent_size;
+    state->radix_root = monitor->radix_root;
+    state->rel_table = monitor->rel_table;
+    state->now = monitor->now;
+    state->clean = 1;
+    
+    store_close(monitor->store);
+    monitor->store = mem_store = NULL;
+}
+
+/*
+ * Allocate memory of entities and relations, from the store of the monitor running on this thread if it has one
+ */
+static inline void* mem_alloc(const size_t size) {
+    
+    return (mem_store != NULL) ? store_alloc(mem_store, size) : malloc(size);
+}
+
+/*
+ * Allocate zeroed memory of entities and relations
+ */
+static inline void* mem_calloc(const size_t n, const size_t size) {
+    
+    return (mem_store != NULL) ? store_calloc(mem_store, n, size) : calloc(n, size);
+}
+
+/*
+ * Allocate cache line aligned memory of entities and relations. 
+ * Blocks of the store are aligned when bigger than STORE_SMALL_MAX, as relation arrays always are
+ */
+static inline void* mem_aligned(const size_t size) {
+    
+    return (mem_store != NULL) ? store_alloc(mem_store, size) : aligned_alloc(CACHE_LINE_SIZE, size);
+}
+
+/*
+ * Resize memory of entities and relations, allocated if p is NULL
+ */
+static inline void* mem_realloc(void* p, const size_t size) {
+    
+    return (mem_store != NULL) ? store_realloc(mem_store, p, size) : realloc(p, size);
+}
+
+/*
+ * Free memory of entities and relations
+ */
+static inline void mem_free(void* p) {
+    
+    if (mem_store != NULL)
+        store_free(mem_store, p);
+    else
+        free(p);
+}
+
+/*
+ * Ask for read ahead of an array about to be scanned, so that its pages not in memory are read in one go
+ */
+static inline void mem_prefetch(const void* p, const size_t len) {
+    
+    if (mem_store != NULL)
+        store_prefetch(mem_store, p, len);
+}
+
+/*
+ * Apply every pending command of peephole optimizer and engine, batch and shards of the sorted array one. 
+ * After this every relation table can be read from the calling thread
+ */
+static void flush_pending(t_monitor* monitor) {
+    
+    if (monitor->peep_mode)
+        flush_peephole(monitor);
+    if (monitor->engine->flush != NULL)
+        monitor->engine->flush(monitor);
+}
+
+/*
+ * Publish a snapshot of the current relations, applying pending commands first.
+ * Needs snapshot mode, must be called by the thread issuing the commands
+ */
+void monitor_publish(t_monitor* monitor) {
+    
+    if (!monitor->snapshot_mode)
+        return;
+    
+    flush_pending(monitor);
+    publish_snapshot(monitor);
+}
+
+/*
+ * Copy the report line of last published snapshot, same format as monitor_report.
+ * Can be called from any thread while the commands keep being applied
+ */
+size_t monitor_snapshot_report(t_monitor* monitor, char* buffer, size_t size) {
+    
+    size_t i, len = 0;
+    t_snapshot* snap;
+    
+    if (!monitor->snapshot_mode)
+        return 0;
+    
+    snap = acquire_snapshot(monitor);
+    
+    for (i=0; i<snap->count; i++)
+        len = copy_cut(buffer, size, len, snap->summary[i]->text, snap->summary[i]->len);
+    if (snap->count == 0)                               // no elements, print none
+        len = copy_cut(buffer, size, len, "none", 4);
+    len = copy_cut(buffer, size, len, "\n", 1);
+    
+    if (buffer != NULL && size > 0)
+        buffer[(len < size) ? len : size - 1] = '\0';
+    
+    release_snapshot(snap);
+    return len;
+}
+
+/*
+ * Copy s at position len of buffer, cutting what does not fit. Return position after s even if cut
+ */
+static inline size_t copy_cut(char* buffer, const size_t size, const size_t len, const char* s, const size_t n) {
+    
+    if (buffer != NULL && len < size)
+        memcpy(buffer + len, s, (n < size - len) ? n : size - len);
+    
+    return len + n;
+}
+
+/*
+ * Drop the summary of a changed relation, next snapshot formats it again
+ */
+static inline void drop_summary(t_rel_str* rel_str) {
+    
+    release_summary(rel_str->summary);
+    rel_str->summary = NULL;
+}
+
+/*
+ * Release a reference to a relation summary, last one frees it
+ */
+static inline void release_summary(t_rel_summary* summary) {
+    
+    if (summary != NULL && atomic_fetch_sub(&summary->refs, 1) == 1)
+        free(summary);
+}
+
+/*
+ * Take a reference to published snapshot, it stays valid until released even if a new one is published
+ */
+static t_snapshot* acquire_snapshot(t_monitor* monitor) {
+    
+    t_snapshot* snap;
+    
+    pthread_mutex_lock(&monitor->snapshot_lock);
+    snap = monitor->snapshot;
+    atomic_fetch_add(&snap->refs, 1);
+    pthread_mutex_unlock(&monitor->snapshot_lock);
+    
+    return snap;
+}
+
+/*
+ * Release a reference to a snapshot, last one frees it with its references to relation summaries
+ */
+static void release_snapshot(t_snapshot* snap) {
+    
+    size_t i;
+    
+    if (atomic_fetch_sub(&snap->refs, 1) != 1)
+        return;
+    
+    for (i=0; i<snap->count; i++)
+        release_summary(snap->summary[i]);
+    free(snap);
+}
+
+/*
+ * Build a snapshot of the current relations and publish it.
+ * Only relations changed since last snapshot are formatted, the others share their summary.
+ * Relation tables must be readable from the calling thread
+ */
+static void publish_snapshot(t_monitor* monitor) {
+    
+    int i;
+    size_t total = 0;
+    t_rel_str* rel_str;
+    t_snapshot* snap;
+    t_snapshot* old;
+    
+    for (i=0; i<monitor->shard_count; i++)
+        total += monitor->shard_arr[i].table.rel_count;
+    if (monitor->shard_count == 0)
+        total = monitor->rel_table.rel_count;
+    
+    snap = malloc(sizeof(t_snapshot) + total * sizeof(t_rel_summary*));
+    atomic_init(&snap->refs, 1);                        // reference of the published pointer
+    snap->count = 0;
+    
+    rel_rewind(monitor);
+    while ((rel_str = rel_next(monitor)) != NULL)
+        snapshot_add(monitor, snap, rel_str);
+    
+    pthread_mutex_lock(&monitor->snapshot_lock);        // swap, readers keep the old one until they release it
+    old = monitor->snapshot;
+    monitor->snapshot = snap;
+    pthread_mutex_unlock(&monitor->snapshot_lock);
+    
+    if (old != NULL)
+        release_snapshot(old);
+    monitor->snapshot_count++;
+}
+
+/*
+ * Add summary of a relation to a snapshot, formatting it only if the relation changed since last snapshot
+ */
+static void snapshot_add(t_monitor* monitor, t_snapshot* snap, t_rel_str* rel_str) {
+    
+    t_rel_summary* summary = rel_str->summary;
+    
+    if (summary == NULL)
+        summary = rel_str->summary = build_summary(monitor, rel_str);
+    
+    atomic_fetch_add(&summary->refs, 1);
+    snap->summary[snap->count++] = summary;
+}
+
+/*
+ * Start reporter thread printing queued snapshots on output
+ */
+static void start_reporter(t_monitor* monitor, FILE* output) {
+    
+    monitor->report_out = output;
+    monitor->report_head = monitor->report_tail = 0;
+    pthread_mutex_init(&monitor->report_lock, NULL);
+    pthread_cond_init(&monitor->report_not_empty, NULL);
+    pthread_cond_init(&monitor->report_not_full, NULL);
+    
+    pthread_create(&monitor->reporter, NULL, reporter_main, monitor);
+}
+
+/*
+ * Wait until every queued snapshot is printed and stop reporter thread
+ */
+static void stop_reporter(t_monitor* monitor) {
+    
+    reporter_push(monitor, NULL);
+    pthread_join(monitor->reporter, NULL);
+    
+    pthread_mutex_destroy(&monitor->report_lock);
+    pthread_cond_destroy(&monitor->report_not_empty);
+    pthread_cond_destroy(&monitor->report_not_full);
+}
+
+/*
+ * Queue a snapshot for the reporter thread, waits only if the queue is full
+ */
+static void reporter_push(t_monitor* monitor, t_snapshot* snap) {
+    
+    pthread_mutex_lock(&monitor->report_lock);
+    while (monitor->report_head - monitor->report_tail == REPORT_QUEUE_SIZE)
+        pthread_cond_wait(&monitor->report_not_full, &monitor->report_lock);
+    
+    monitor->report_queue[monitor->report_head & (REPORT_QUEUE_SIZE - 1)] = snap;
+    monitor->report_head++;
+    pthread_cond_signal(&monitor->report_not_empty);
+    pthread_mutex_unlock(&monitor->report_lock);
+}
+
+/*
+ * Body of the reporter thread: print each queued snapshot in order and release it
+ */
+static void* reporter_main(void* arg) {
+    
+    t_monitor* monitor = (t_monitor*)arg;
+    t_snapshot* snap;
+    size_t i;
+    
+    while (1) {
+        pthread_mutex_lock(&monitor->report_lock);
+        while (monitor->report_tail == monitor->report_head)
+            pthread_cond_wait(&monitor->report_not_empty, &monitor->report_lock);
+        snap = monitor->report_queue[monitor->report_tail & (REPORT_QUEUE_SIZE - 1)];
+        pthread_mutex_unlock(&monitor->report_lock);
+    
+        if (snap == NULL)                               // stop request, every snapshot before it was printed
+            break;
+    
+        for (i=0; i<snap->count; i++)
+            fwrite(snap->summary[i]->text, 1, snap->summary[i]->len, monitor->report_out);
+        if (snap->count == 0)                           // no elements, print none
+            fwrite("none", 1, 4, monitor->report_out);
+        fwrite("\n", 1, 1, monitor->report_out);
+        release_snapshot(snap);
+    
+        pthread_mutex_lock(&monitor->report_lock);
+        monitor->report_tail++;
+        pthread_cond_signal(&monitor->report_not_full);
+        pthread_mutex_unlock(&monitor->report_lock);
+    }
+    
+    return NULL;
+}
+
+/*
+ * Format top k receivers of every relation into buffer, like monitor_report.
+ * Each relation is printed with its k destinations receiving the most, by decreasing count then name, each followed by its count
+ */
+size_t monitor_topk(t_monitor* monitor, const int k, char* buffer, size_t size) {
+    
+    size_t len;
+    
+    mem_store = monitor->store;
+    flush_pending(monitor);
+    monitor->engine->topk(monitor, k);
+    
+    if (buffer != NULL && size > 0) {
+        len = (monitor->report_text.len < size) ? monitor->report_text.len : size - 1;
+        memcpy(buffer, monitor->report_text.buf, len);
+        buffer[len] = '\0';
+    }
+    
+    return monitor->report_text.len;
+}
+
+/*
+ * Format top k receivers of every relation into report text, one line terminated by newline.
+ * Relation tables must be readable from the calling thread
+ */
+static void topk(t_monitor* monitor, const int k) {
+    
+    t_rel_str* rel_str;
+    
+    monitor->report_text.len = 0;
+    
+    rel_rewind(monitor);
+    while ((rel_str = rel_next(monitor)) != NULL)
+        format_topk(monitor, rel_str, k);
+    
+    if (monitor->report_text.len == 0)                  // no elements, print none
+        text_append(&monitor->report_text, "none", 4);
+    text_append(&monitor->report_text, "\n", 1);
+}
+
+/*
+ * Format top k receivers of one relation: name, then each destination followed by its count.
+ * Buckets of equal count are read from the rank array, only the names of a tie that are printed are selected,
+ * keeping the smallest ones in a max heap of at most k names, then sorted
+ */
+static void format_topk(t_monitor* monitor, t_rel_str* rel_str, const int k) {
+    
+    uint32_t c, n, m, i, left = k, start, end;
+    char number[16];
+    char** heap;
+    t_rel_cold* cold = rel_str->cold;
+    
+    if (cold->rank_arr == NULL)                         // first request on this relation
+        rank_build(rel_str);
+    
+    m = (left < rel_str->dest_count) ? left : rel_str->dest_count;
+    if (monitor->topk_size < m) {                       // scratch for the printed names of one bucket
+        monitor->topk_size = m;
+        monitor->topk_arr = realloc(monitor->topk_arr, monitor->topk_size * sizeof(char*));
+    }
+    heap = monitor->topk_arr;
+    
+    text_append(&monitor->report_text, cold->rel, name_len(cold->rel));
+    
+    for (c=rel_str->n_most_dest; c>0 && left>0; c--) {  // buckets by decreasing count
+        start = cold->rank_ge[c+1];
+        end = cold->rank_ge[c];
+        if (start == end)
+            continue;
+    
+        m = (end - start < left) ? end - start : left;  // names of this bucket that are printed
+        memcpy(heap, &cold->rank_arr[start], m * sizeof(char*));
+        if (m < end - start) {                          // keep the m smallest names, O(b log m) for a bucket of b
+            for (i=m/2; i>0; i--)
+                topk_sift_down(heap, m, i - 1);
+            for (i=start+m; i<end; i++)
+                if (name_compare(cold->rank_arr[i], heap[0]) < 0) {
+                    heap[0] = cold->rank_arr[i];
+                    topk_sift_down(heap, m, 0);
+                }
+        }
+        qsort(heap, m, sizeof(char*), string_compare);
+    
+        for (n=0; n<m; n++, left--) {
+            text_append(&monitor->report_text, " ", 1);
+            text_append(&monitor->report_text, heap[n], name_len(heap[n]));
+            text_append(&monitor->report_text, number, snprintf(number, sizeof(number), " %" PRIu32, c));
+        }
+    }
+    
+    text_append(&monitor->report_text, "; ", 2);
+}
+
+/*
+ * Sift name in position i down the max heap of n names, greatest name on top
+ */
+static void topk_sift_down(char** heap, const uint32_t n, uint32_t i) {
+    
+    uint32_t child;
+    char* name = heap[i];
+    
+    while ((child = 2*i + 1) < n) {
+        if (child + 1 < n && name_compare(heap[child+1], heap[child]) > 0)
+            child++;                                    // greater child
+        if (name_compare(heap[child], name) <= 0)
+            break;
+        heap[i] = heap[child];
+        i = child;
+    }
+    heap[i] = name;
+}
+
+/*
+ * Build rank array of a relation with a counting sort on destination counts, then every change keeps it up to date
+ */
+static void rank_build(t_rel_str* rel_str) {
+    
+    uint32_t i, c, pass;
+    t_rel_cold* cold = rel_str->cold;
+    
+    cold->rank_arr = mem_alloc(cold->dest_size * sizeof(char*));
+    cold->rank_pos = mem_alloc(cold->dest_size * sizeof(uint32_t));
+    cold->rank_ge_size = RANK_COUNT_SIZE;
+    while (cold->rank_ge_size < rel_str->n_most_dest + 2)
+        cold->rank_ge_size = cold->rank_ge_size << 1;
+    cold->rank_ge = mem_alloc(cold->rank_ge_size * sizeof(uint32_t));
+    
+    for (pass=0; pass<2; pass++) {
+        memset(cold->rank_ge, 0, cold->rank_ge_size * sizeof(uint32_t));
+        for (i=0; i<rel_str->dest_count; i++)           // histogram of counts
+            cold->rank_ge[rel_str->dest_of_count[i]]++;
+        for (c=rel_str->n_most_dest; c>0; c--)          // suffix sums, destinations receiving at least c
+            cold->rank_ge[c] += cold->rank_ge[c+1];
+    
+        if (pass == 1)                                  // second pass restores the bounds moved by the placement
+            break;
+        for (i=0; i<rel_str->dest_count; i++) {         // fill each bucket from its end
+            cold->rank_pos[i] = --cold->rank_ge[rel_str->dest_of_count[i]];
+            cold->rank_arr[cold->rank_pos[i]] = rel_str->dest_arr[i];
+        }
+    }
+}
+
+/*
+ * Stop maintaining the rank array of a relation, rebuilt at next top k request
+ */
+static void rank_free(t_rel_cold* cold) {
+    
+    mem_free(cold->rank_arr);
+    mem_free(cold->rank_pos);
+    mem_free(cold->rank_ge);
+    cold->rank_arr = NULL;
+    cold->rank_pos = NULL;
+    cold->rank_ge = NULL;
+}
+
+/*
+ * Swap two positions of the rank array, dest_pos is the destination position of the one at p
+ */
+static inline void rank_swap(t_rel_str* rel_str, const int dest_pos, const uint32_t p, const uint32_t q) {
+    
+    t_rel_cold* cold = rel_str->cold;
+    char* other = cold->rank_arr[q];
+    
+    if (p == q)
+        return;
+    
+    cold->rank_pos[search_string_array(rel_str->dest_arr, rel_str->dest_count, other)] = p;
+    cold->rank_arr[p] = other;
+    cold->rank_arr[q] = rel_str->dest_arr[dest_pos];
+    cold->rank_pos[dest_pos] = q;
+}
+
+/*
+ * Move a destination whose count just became c to the bucket above: it swaps with the first of its old bucket
+ */
+static void rank_increment(t_rel_str* rel_str, const int dest_pos, const uint32_t c) {
+    
+    t_rel_cold* cold = rel_str->cold;
+    
+    if (c + 1 >= cold->rank_ge_size) {                  // room for count c and for the empty bucket above it
+        cold->rank_ge = mem_realloc(cold->rank_ge, (cold->rank_ge_size << 1) * sizeof(uint32_t));
+        memset(&cold->rank_ge[cold->rank_ge_size], 0, cold->rank_ge_size * sizeof(uint32_t));
+        cold->rank_ge_size = cold->rank_ge_size << 1;
+    }
+    
+    rank_swap(rel_str, dest_pos, cold->rank_pos[dest_pos], cold->rank_ge[c]);
+    cold->rank_ge[c]++;
+}
+
+/*
+ * Move a destination whose count is going to drop from c to the bucket below: it swaps with the last of its bucket
+ */
+static void rank_decrement(t_rel_str* rel_str, const int dest_pos, const uint32_t c) {
+    
+    t_rel_cold* cold = rel_str->cold;
+    
+    rank_swap(rel_str, dest_pos, cold->rank_pos[dest_pos], cold->rank_ge[c] - 1);
+    cold->rank_ge[c]--;
+}
+
+/*
+ * Move a destination about to be removed to the end of the rank array
+ */
+static void rank_remove(t_rel_str* rel_str, const int dest_pos) {
+    
+    uint32_t c;
+    
+    for (c=rel_str->dest_of_count[dest_pos]; c>0; c--)
+        rank_decrement(rel_str, dest_pos, c);
+}
+
+/*
+ * Rewind the cursors used to visit every relation in name order
+ */
+static void rel_rewind(t_monitor* monitor) {
+    
+    int i;
+    
+    monitor->rel_cursor = 0;
+    for (i=0; i<monitor->shard_count; i++)
+        monitor->shard_arr[i].frag_next = 0;
+}
+
+/*
+ * Return next relation in name order, among every shard if sharded. NULL after the last one.
+ * Relation tables must be readable from the calling thread
+ */
+static t_rel_str* rel_next(t_monitor* monitor) {
+    
+    int i, best = -1;
+    t_shard* shard;
+    
+    if (monitor->shard_count == 0)
+        return (monitor->rel_cursor < monitor->rel_table.rel_count) ? &monitor->rel_table.rel_arr[monitor->rel_cursor++] : NULL;
+    
+    for (i=0; i<monitor->shard_count; i++) {            // smallest relation among the heads of each shard
+        shard = &monitor->shard_arr[i];
+        if (shard->frag_next < shard->table.rel_count && (best == -1 ||
+                strcmp(shard->table.rel_arr[shard->frag_next].cold->rel,
+                       monitor->shard_arr[best].table.rel_arr[monitor->shard_arr[best].frag_next].cold->rel) < 0))
+            best = i;
+    }
+    if (best == -1)
+        return NULL;
+    
+    shard = &monitor->shard_arr[best];
+    return &shard->table.rel_arr[shard->frag_next++];
+}
+
+/*
+ * Wait until the reporter thread printed every queued snapshot
+ */
+static void reporter_wait(t_monitor* monitor) {
+    
+    pthread_mutex_lock(&monitor->report_lock);
+    while (monitor->report_tail != monitor->report_head)
+        pthread_cond_wait(&monitor->report_not_full, &monitor->report_lock);
+    pthread_mutex_unlock(&monitor->report_lock);
+}
+
+/*
+ * Format last published snapshot into report text, for callers that need the line instead of the reporter thread
+ */
+static void snapshot_text(t_monitor* monitor) {
+    
+    size_t i;
+    t_snapshot* snap = acquire_snapshot(monitor);
+    
+    monitor->report_text.len = 0;
+    for (i=0; i<snap->count; i++)
+        text_append(&monitor->report_text, snap->summary[i]->text, snap->summary[i]->len);
+    if (snap->count == 0)                               // no elements, print none
+        text_append(&monitor->report_text, "none", 4);
+    text_append(&monitor->report_text, "\n", 1);
+    
+    release_snapshot(snap);
+}
+
+/*
+ * Format the report text of one relation into a new summary, referenced once by the caller
+ */
+static t_rel_summary* build_summary(t_monitor* monitor, t_rel_str* rel_str) {
+    
+    t_rel_summary* summary;
+    
+    monitor->summary_text.len = 0;
+    format_rel_str(&monitor->summary_text, rel_str);
+    
+    summary = malloc(sizeof(t_rel_summary) + monitor->summary_text.len);
+    atomic_init(&summary->refs, 1);
+    summary->len = monitor->summary_text.len;
+    memcpy(summary->text, monitor->summary_text.buf, summary->len);
+    monitor->summary_count++;
+    
+    return summary;
+}
+
+/*
+ * Format the delta report into report text: relations whose report text changed since previous report,
+ * and relations reported before that were removed, printed with count 0. All in name order, none if nothing changed.
+ * Relation tables must be readable from the calling thread
+ */
+static void delta_report(t_monitor* monitor) {
+    
+    int i, pos;
+    size_t j, n = 0, t = 0;
+    t_rel_table* table;
+    t_rel_str* rel_str;
+    
+    monitor->report_text.len = 0;
+    
+    // step 1: gather removed relations of every table, they are owned by the scratch now
+    for (i=0; i<(monitor->shard_count > 0 ? monitor->shard_count : 1); i++) {
+        table = (monitor->shard_count > 0) ? &monitor->shard_arr[i].table : &monitor->rel_table;
+        if (table->removed_count == 0)
+            continue;
+        if (n + table->removed_count > monitor->delta_size) {
+            monitor->delta_size = n + table->removed_count;
+            monitor->delta_arr = realloc(monitor->delta_arr, monitor->delta_size * sizeof(t_removed_rel));
+        }
+        memcpy(&monitor->delta_arr[n], table->removed, table->removed_count * sizeof(t_removed_rel));
+        n += table->removed_count;
+        table->removed_count = 0;
+    }
+    
+    // step 2: a relation created again takes back its last printed text, so that it is printed only if changed. 
+    // A name appears once, a new relation is not reported yet so it can't be removed again
+    if (n > 0)
+        qsort(monitor->delta_arr, n, sizeof(t_removed_rel), removed_compare);
+    for (j=0; j<n; j++) {
+        table = (monitor->shard_count > 0) ? &shard_of(monitor, monitor->delta_arr[j].rel)->table : &monitor->rel_table;
+        pos = search_relation(table, monitor->delta_arr[j].rel);
+        if (pos >= 0) {
+            table->rel_arr[pos].cold->reported = monitor->delta_arr[j].reported;
+            name_free(monitor->delta_arr[j].rel);
+        }
+        else
+            monitor->delta_arr[t++] = monitor->delta_arr[j];
+    }
+    n = t;
+    t = 0;
+    
+    // step 3: merge changed relations and removed ones in name order
+    rel_rewind(monitor);
+    while ((rel_str = rel_next(monitor)) != NULL) {
+        for (; t<n && strcmp(monitor->delta_arr[t].rel, rel_str->cold->rel) < 0; t++) {
+            text_append(&monitor->report_text, monitor->delta_arr[t].rel, name_len(monitor->delta_arr[t].rel));
+            text_append(&monitor->report_text, " 0; ", 4);
+        }
+        delta_rel(monitor, rel_str);
+    }
+    for (; t<n; t++) {
+        text_append(&monitor->report_text, monitor->delta_arr[t].rel, name_len(monitor->delta_arr[t].rel));
+        text_append(&monitor->report_text, " 0; ", 4);
+    }
+    
+    for (t=0; t<n; t++) {
+        name_free(monitor->delta_arr[t].rel);
+        release_summary(monitor->delta_arr[t].reported);
+    }
+    
+    if (monitor->report_text.len == 0)                  // nothing changed, print none
+        text_append(&monitor->report_text, "none", 4);
+    text_append(&monitor->report_text, "\n", 1);
+}
+
+/*
+ * Format one relation of the delta report if its report text changed.
+ * A relation untouched since last report still points to the reported summary and is skipped without formatting
+ */
+static void delta_rel(t_monitor* monitor, t_rel_str* rel_str) {
+    
+    t_rel_cold* cold = rel_str->cold;
+    t_rel_summary* summary = rel_str->summary;
+    
+    if (summary != NULL && summary == cold->reported)
+        return;
+    
+    if (summary == NULL)                                // relation changed, its maximum may be the same
+        summary = rel_str->summary = build_summary(monitor, rel_str);
+    
+    if (cold->reported == NULL || cold->reported->len != summary->len || memcmp(cold->reported->text, summary->text, summary->len) != 0)
+        text_append(&monitor->report_text, summary->text, summary->len);
+    
+    release_summary(cold->reported);
+    atomic_fetch_add(&summary->refs, 1);
+    cold->reported = summary;
+}
+
+/*
+ * Remember a removed relation for the next delta report, only if it was printed by a previous one.
+ * Its name and last printed text are moved out of the relation, that is going to be freed
+ */
+static void note_removed(t_rel_table* table, t_rel_str* rel_str) {
+    
+    if (rel_str->cold->reported == NULL)
+        return;
+    
+    if (table->removed_count == table->removed_size) {
+        table->removed_size = table->removed_size ? table->removed_size << 1 : RELATION_ARRAY_SIZE;
+        table->removed = realloc(table->removed, table->removed_size * sizeof(t_removed_rel));
+    }
+    table->removed[table->removed_count].rel = rel_str->cold->rel;
+    table->removed[table->removed_count++].reported = rel_str->cold->reported;
+    rel_str->cold->rel = NULL;
+    rel_str->cold->reported = NULL;
+}
+
+/*
+ * Compare function for qsort for removed relations, by name
+ */
+static int removed_compare(const void* a, const void* b) {
+    
+    return name_compare(((t_removed_rel*)a)->rel, ((t_removed_rel*)b)->rel);
+}
+
+/*
+ * Add relation from orig to dest that expires ttl ticks from now, as if a delrel was issued then.
+ * A ttl of 0 adds a relation that never expires
+ */
+void monitor_add_rel_ttl(t_monitor* monitor, const char* orig, const char* dest, const char* rel, const uint64_t ttl) {
+    
+    t_timer* timer;
+    
+    monitor_add_rel(monitor, orig, dest, rel);
+    if (ttl == 0)
+        return;
+    
+    if (monitor->timer_free != NULL) {                  // reuse a fired timer
+        timer = monitor->timer_free;
+        monitor->timer_free = timer->next;
+    }
+    else
+        timer = malloc(sizeof(t_timer));
+    
+    name_copy_set(&timer->orig, orig, strlen(orig));    // names by value, entities may be deleted before expiry
+    name_copy_set(&timer->dest, dest, strlen(dest));
+    name_copy_set(&timer->rel, rel, strlen(rel));
+    timer->expire = monitor->now + ttl;
+    
+    timer_insert(monitor, timer);
+    monitor->timer_count++;
+}
+
+/*
+ * Advance logical time by n ticks, deleting every relation whose ttl ends meanwhile.
+ * Ticks where no slot of the wheel can hold a timer are skipped, so the cost follows the timers and not n
+ */
+void monitor_tick(t_monitor* monitor, const uint64_t n) {
+    
+    int level;
+    uint64_t skip;
+    uint64_t left = n;
+    
+    mem_store = monitor->store;
+    while (left > 0) {
+        for (level=0; level<WHEEL_LEVELS && monitor->timer_level_count[level]==0; level++);
+        
+        if (level == WHEEL_LEVELS) {                    // nothing can expire, jump
+            monitor->now += left;
+            return;
+        }
+        
+        // nothing happens before next slot of lowest level with timers, jump right before it
+        skip = (((monitor->now >> (WHEEL_BITS * level)) + 1) << (WHEEL_BITS * level)) - monitor->now - 1;
+        if (skip >= left) {
+            monitor->now += left;
+            return;
+        }
+        monitor->now += skip;
+        left -= skip + 1;
+        timer_advance(monitor);
+    }
+}
+
+/*
+ * Insert a timer in the wheel level whose span covers its distance from now.
+ * Level l has WHEEL_SIZE slots of WHEEL_SIZE^l ticks each, timers beyond the last level wait in it and are moved again
+ */
+static void timer_insert(t_monitor* monitor, t_timer* timer) {
+    
+    int level;
+    uint64_t delta = timer->expire - monitor->now;
+    uint64_t expire = timer->expire;
+    
+    for (level=0; level<WHEEL_LEVELS-1; level++)
+        if (delta < ((uint64_t)1 << (WHEEL_BITS * (level + 1))))
+            break;
+    
+    if (level == WHEEL_LEVELS-1 && delta >= ((uint64_t)1 << (WHEEL_BITS * WHEEL_LEVELS)))
+        expire = monitor->now + ((uint64_t)1 << (WHEEL_BITS * WHEEL_LEVELS)) - 1;      // farthest slot, cascaded again later
+    
+    timer->next = monitor->wheel[level][(expire >> (WHEEL_BITS * level)) & (WHEEL_SIZE - 1)];
+    monitor->wheel[level][(expire >> (WHEEL_BITS * level)) & (WHEEL_SIZE - 1)] = timer;
+    monitor->timer_level_count[level]++;
+}
+
+/*
+ * Advance logical time by one tick: move down the timers of higher levels whose slot starts now,
+ * then delete the relation of each timer of the current slot of level 0
+ */
+static void timer_advance(t_monitor* monitor) {
+    
+    int level;
+    t_timer* timer;
+    t_timer* next;
+    t_timer** slot;
+    
+    monitor->now++;
+    
+    for (level=WHEEL_LEVELS-1; level>0; level--) {      // highest first, so that cascaded timers can move down again
+        if ((monitor->now & (((uint64_t)1 << (WHEEL_BITS * level)) - 1)) != 0)
+            continue;
+        slot = &monitor->wheel[level][(monitor->now >> (WHEEL_BITS * level)) & (WHEEL_SIZE - 1)];
+        timer = *slot;
+        *slot = NULL;
+        for (; timer != NULL; timer = next) {
+            next = timer->next;
+            monitor->timer_level_count[level]--;
+            timer_insert(monitor, timer);
+        }
+    }
+    
+    slot = &monitor->wheel[0][monitor->now & (WHEEL_SIZE - 1)];
+    timer = *slot;
+    *slot = NULL;
+    for (; timer != NULL; timer = next) {               // same path as delrel, through peephole, batch and shards
+        next = timer->next;
+        monitor_del_rel(monitor, name_copy_str(&timer->orig), name_copy_str(&timer->dest), name_copy_str(&timer->rel));
+        name_copy_free(&timer->orig);
+        name_copy_free(&timer->dest);
+        name_copy_free(&timer->rel);
+    
+        timer->next = monitor->timer_free;
+        monitor->timer_free = timer;
+        monitor->timer_level_count[0]--;
+        monitor->timer_count--;
+        monitor->timer_expired++;
+    }
+}
+
+/*
+ * Free every timer, pending or fired
+ */
+static void free_timers(t_monitor* monitor) {
+    
+    int level, i;
+    t_timer* timer;
+    
+    for (level=0; level<WHEEL_LEVELS; level++)
+        for (i=0; i<WHEEL_SIZE; i++)
+            while ((timer = monitor->wheel[level][i]) != NULL) {
+                monitor->wheel[level][i] = timer->next;
+                name_copy_free(&timer->orig);
+                name_copy_free(&timer->dest);
+                name_copy_free(&timer->rel);
+                free(timer);
+            }
+    
+    while ((timer = monitor->timer_free) != NULL) {
+        monitor->timer_free = timer->next;
+        free(timer);
+    }
+}
+
+/*
+ * FNV-1a hash of an entity name, reduced to a slot of a set of passed size.
+ * Hashed by content since deletes may pass names not yet resolved in the dictionary
+ */
+static inline size_t origin_hash(const char* orig, const uint32_t size) {
+    
+    uint32_t h = 2166136261u;
+    
+    for (; *orig != '\0'; orig++)
+        h = (h ^ (unsigned char)*orig) * 16777619u;
+    
+    return h & (size - 1);
+}
+
+/*
+ * Search an origin in the origin set. Return its position, array index or hash slot, -1 if missing
+ */
+static int origin_search(t_dest_str* dest_str, const uint32_t count, char* orig) {
+    
+    size_t i;
+    
+    if (!dest_str->is_hash)
+        return search_string_array(dest_str->dest_of, count, orig);
+    
+    for (i=origin_hash(orig, dest_str->dest_of_size); dest_str->dest_of[i] != NULL; i=(i+1) & (dest_str->dest_of_size-1))
+        if (dest_str->dest_of[i] == orig || strcmp(dest_str->dest_of[i], orig) == 0)
+            return i;
+    
+    return -1;
+}
+
+/*
+ * Insert a missing origin into the hash set, growing it when half full
+ */
+static void origin_hash_insert(t_dest_str* dest_str, const uint32_t count, char* orig) {
+    
+    size_t i;
+    
+    if ((count + 1) * 2 > dest_str->dest_of_size)
+        origin_rehash(dest_str, count, dest_str->dest_of_size << 1);
+    
+    for (i=origin_hash(orig, dest_str->dest_of_size); dest_str->dest_of[i] != NULL; i=(i+1) & (dest_str->dest_of_size-1));
+    dest_str->dest_of[i] = orig;
+}
+
+/*
+ * Remove the origin in slot pos of the hash set, moving back the following ones of the probe sequence. 
+ * Shrink the set, or go back to a sorted array, once it gets sparse
+ */
+static void origin_hash_delete(t_dest_str* dest_str, const uint32_t count, size_t pos) {
+    
+    size_t i, home;
+    const size_t mask = dest_str->dest_of_size - 1;
+    
+    for (i=(pos+1) & mask; dest_str->dest_of[i] != NULL; i=(i+1) & mask) {
+        home = origin_hash(dest_str->dest_of[i], dest_str->dest_of_size);
+        if (((i - home) & mask) >= ((i - pos) & mask)) {        // its home is not between pos and i, fill the hole
+            dest_str->dest_of[pos] = dest_str->dest_of[i];
+            pos = i;
+        }
+    }
+    dest_str->dest_of[pos] = NULL;
+    
+    if (count - 1 < ORIGIN_HASH_MIN / 4)
+        origin_to_array(dest_str, count - 1);
+    else if ((count - 1) * 8 < dest_str->dest_of_size)
+        origin_rehash(dest_str, count - 1, dest_str->dest_of_size >> 1);
+}
+
+/*
+ * Move every origin of the hash set into a new one of the passed size
+ */
+static void origin_rehash(t_dest_str* dest_str, const uint32_t count, const uint32_t size) {
+    
+    size_t i, j;
+    char** old = dest_str->dest_of;
+    const uint32_t old_size = dest_str->dest_of_size;
+    
+    dest_str->dest_of = mem_calloc(size, sizeof(char*));
+    dest_str->dest_of_size = size;
+    
+    for (i=0; i<old_size; i++) {
+        if (old[i] == NULL)
+            continue;
+        for (j=origin_hash(old[i], size); dest_str->dest_of[j] != NULL; j=(j+1) & (size-1));
+        dest_str->dest_of[j] = old[i];
+    }
+    mem_free(old);
+}
+
+/*
+ * Turn a sorted origin array that got too big into a hash set, filled to a quarter
+ */
+static void origin_to_hash(t_dest_str* dest_str, const uint32_t count) {
+    
+    uint32_t size = ORIGIN_HASH_MIN;
+    
+    while (size < count * 4)
+        size = size << 1;
+    
+    dest_str->is_hash = 1;
+    dest_str->dest_of_size = count;                     // rehash reads every old slot, all taken
+    origin_rehash(dest_str, count, size);
+}
+
+/*
+ * Turn a sparse hash set back into a sorted origin array
+ */
+static void origin_to_array(t_dest_str* dest_str, const uint32_t count) {
+    
+    size_t i, n = 0;
+    char** arr = mem_alloc(ORIGIN_HASH_MIN * sizeof(char*));
+    
+    for (i=0; i<dest_str->dest_of_size; i++)
+        if (dest_str->dest_of[i] != NULL)
+            arr[n++] = dest_str->dest_of[i];
+    qsort(arr, n, sizeof(char*), string_compare);
+    
+    mem_free(dest_str->dest_of);
+    dest_str->dest_of = arr;
+    dest_str->dest_of_size = ORIGIN_HASH_MIN;
+    dest_str->is_hash = 0;
+}
+
+/*
+ * Print the error guarantee of approximate mode, nothing for exact counts
+ */
+void monitor_print_guarantee(t_monitor* monitor, FILE* out) {
+    
+    t_sketch* probe;
+    
+    if (monitor->sketch_eps <= 0)
+        return;
+    
+    probe = sketch_create(monitor->sketch_eps, monitor->sketch_delta);
+    fprintf(out, "approximate mode: each reported count is at least the true one and at most %g * N above it "
+                 "with probability %g, N relations of that type\n", monitor->sketch_eps, 1 - monitor->sketch_delta);
+    fprintf(out, "approximate mode: receivers are the largest among %zu candidates, %zu bytes for each relation type, "
+                 "%zu bytes of edge filter for %zu relations\n", sketch_candidates(monitor->sketch_eps), sketch_bytes(probe),
+                 sketch_filter_bytes(monitor->sketch_filter), monitor->sketch_edges);
+    fprintf(out, "approximate mode: about %.2g of new relations are taken as repeated once the filter is full, "
+                 "delent of an origin does not lower the counts of its destinations\n", pow(1 - exp(-(double)SKETCH_FILTER_HASHES / 10), SKETCH_FILTER_HASHES));
+    sketch_destroy(probe);
+}
+
+/*
+ * Append the key of an entity in a relation sketch: name, its terminator and its generation, 
+ * so that counts left by a deleted entity do not go to a new one with the same name. Return its length
+ */
+static size_t sketch_ent_key(t_monitor* monitor, t_text* key, const char* ent) {
+    
+    size_t len = strlen(ent) + 1;
+    uint32_t gen = monitor->sketch_gen[origin_hash(ent, SKETCH_GEN_SIZE)];
+    
+    text_append(key, ent, len);
+    text_append(key, (const char*)&gen, sizeof(uint32_t));
+    
+    return len + sizeof(uint32_t);
+}
+
+/*
+ * Check that an entity key still names a live entity of the same generation
+ */
+static int sketch_key_alive(t_monitor* monitor, const char* key) {
+    
+    uint32_t gen;
+    
+    if (search_entity(monitor, (char*)key) == NULL)
+        return 0;
+    
+    memcpy(&gen, key + strlen(key) + 1, sizeof(uint32_t));
+    return gen == monitor->sketch_gen[origin_hash(key, SKETCH_GEN_SIZE)];
+}
+
+/*
+ * Find the sketch of a relation by binary search, creating it if asked. Return NULL if missing
+ */
+static t_sketch* sketch_of(t_monitor* monitor, const char* rel, const int create) {
+    
+    int cmp;
+    size_t lo = 0, hi = monitor->sketch_count, mid;
+    
+    while (lo < hi) {
+        mid = (lo + hi) / 2;
+        cmp = strcmp(monitor->sketch_arr[mid].rel, rel);
+        if (cmp == 0)
+            return monitor->sketch_arr[mid].sketch;
+        if (cmp < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (!create)
+        return NULL;
+    
+    if (monitor->sketch_count == monitor->sketch_size) {        // double size if full
+        monitor->sketch_size = monitor->sketch_size << 1;
+        monitor->sketch_arr = realloc(monitor->sketch_arr, monitor->sketch_size * sizeof(t_sketch_rel));
+    }
+    memmove(&monitor->sketch_arr[lo+1], &monitor->sketch_arr[lo], (monitor->sketch_count - lo) * sizeof(t_sketch_rel));
+    monitor->sketch_count++;
+    
+    monitor->sketch_arr[lo].rel = name_new(rel, strlen(rel));
+    monitor->sketch_arr[lo].sketch = sketch_create(monitor->sketch_eps, monitor->sketch_delta);
+    
+    return monitor->sketch_arr[lo].sketch;
+}
+
+/*
+ * Apply addrel or delrel in approximate mode. The edge filter stands for the set of relations, 
+ * so repeated addrel and delrel of a missing relation do not move the counts
+ */
+static void sketch_apply_rel(t_monitor* monitor, char* orig, char* dest, char* rel, const int add) {
+    
+    char* edge;
+    size_t orig_len, dest_len, rel_len = strlen(rel) + 1;
+    t_sketch* sketch;
+    
+    if (search_entity(monitor, orig) == NULL || search_entity(monitor, dest) == NULL)
+        return;
+    
+    monitor->sketch_key.len = 0;                                            // origin, destination, relation
+    orig_len = sketch_ent_key(monitor, &monitor->sketch_key, orig);
+    dest_len = sketch_ent_key(monitor, &monitor->sketch_key, dest);
+    text_append(&monitor->sketch_key, rel, rel_len);
+    edge = monitor->sketch_key.buf;
+    
+    if (add && sketch_filter_add(monitor->sketch_filter, edge, orig_len + dest_len + rel_len))
+        sketch_update(sketch_of(monitor, rel, 1), edge + orig_len, dest_len, 1);
+    else if (add)
+        monitor->sketch_repeated++;
+    
+    else if (sketch_filter_del(monitor->sketch_filter, edge, orig_len + dest_len + rel_len)) {
+        sketch = sketch_of(monitor, rel, 0);
+        if (sketch != NULL)
+            sketch_update(sketch, edge + orig_len, dest_len, -1);
+    }
+}
+
+/*
+ * Delete a registered entity in approximate mode. Its counts as destination are dropped by moving it to a new generation,
+ * its relations as origin stay in the counts of their destinations
+ */
+static void sketch_del_ent(t_monitor* monitor, char* ent) {
+    
+    size_t i, len;
+    
+    monitor->sketch_key.len = 0;
+    len = sketch_ent_key(monitor, &monitor->sketch_key, ent);
+    for (i=0; i<monitor->sketch_count; i++)
+        sketch_forget(monitor->sketch_arr[i].sketch, monitor->sketch_key.buf, len);
+    
+    monitor->sketch_gen[origin_hash(ent, SKETCH_GEN_SIZE)]++;
+}
+
+/*
+ * Format the report from relation sketches into report text, same line as the exact report.
+ * Receivers are the live candidates with the biggest estimate
+ */
+static void sketch_report(t_monitor* monitor) {
+    
+    size_t i, j, n;
+    uint32_t max;
+    char number[16];
+    
+    monitor->report_text.len = 0;
+    
+    for (i=0; i<monitor->sketch_count; i++) {
+        n = sketch_top(monitor->sketch_arr[i].sketch, monitor->sketch_keys, monitor->sketch_counts, monitor->sketch_cand);
+        max = 0;
+    
+        for (j=0; j<n && monitor->sketch_counts[j]>0 && (max==0 || monitor->sketch_counts[j]==max); j++) {
+            if (!sketch_key_alive(monitor, monitor->sketch_keys[j]))
+                continue;
+            if (max == 0) {                             // first live one has the biggest estimate
+                max = monitor->sketch_counts[j];
+                text_append(&monitor->report_text, monitor->sketch_arr[i].rel, name_len(monitor->sketch_arr[i].rel));
+                text_append(&monitor->report_text, " ", 1);
+            }
+            text_append(&monitor->report_text, monitor->sketch_keys[j], strlen(monitor->sketch_keys[j]));
+            text_append(&monitor->report_text, " ", 1);
+        }
+    
+        if (max > 0)
+            text_append(&monitor->report_text, number, snprintf(number, sizeof(number), "%" PRIu32 "; ", max));
+    }
+    
+    if (monitor->report_text.len == 0)                  // no elements, print none
+        text_append(&monitor->report_text, "none", 4);
+    text_append(&monitor->report_text, "\n", 1);
+}
+
+/*
+ * Format top k receivers of every relation from their sketch into report text, like topk
+ */
+static void sketch_topk(t_monitor* monitor, const int k) {
+    
+    size_t i, j, n, start;
+    int left;
+    char number[16];
+    
+    monitor->report_text.len = 0;
+    
+    for (i=0; i<monitor->sketch_count; i++) {
+        n = sketch_top(monitor->sketch_arr[i].sketch, monitor->sketch_keys, monitor->sketch_counts, monitor->sketch_cand);
+        start = monitor->report_text.len;
+        left = k;
+    
+        for (j=0; j<n && monitor->sketch_counts[j]>0 && left>0; j++) {
+            if (!sketch_key_alive(monitor, monitor->sketch_keys[j]))
+                continue;
+            if (left == k)
+                text_append(&monitor->report_text, monitor->sketch_arr[i].rel, name_len(monitor->sketch_arr[i].rel));
+            text_append(&monitor->report_text, " ", 1);
+            text_append(&monitor->report_text, monitor->sketch_keys[j], strlen(monitor->sketch_keys[j]));
+            text_append(&monitor->report_text, number, snprintf(number, sizeof(number), " %" PRIu32, monitor->sketch_counts[j]));
+            left--;
+        }
+    
+        if (monitor->report_text.len > start)
+            text_append(&monitor->report_text, "; ", 2);
+    }
+    
+    if (monitor->report_text.len == 0)                  // no elements, print none
+        text_append(&monitor->report_text, "none", 4);
+    text_append(&monitor->report_text, "\n", 1);
+}
+
+/*
+ * Set up approximate mode, memory is fixed here except for one sketch per relation type
+ */
+static void sketch_init(t_monitor* monitor) {
+    
+    monitor->sketch_count = 0;
+    monitor->sketch_size = SKETCH_ARRAY_SIZE;
+    monitor->sketch_arr = malloc(monitor->sketch_size * sizeof(t_sketch_rel));
+    monitor->sketch_filter = sketch_filter_create(monitor->sketch_edges);
+    monitor->sketch_gen = calloc(SKETCH_GEN_SIZE, sizeof(uint32_t));
+    monitor->sketch_cand = sketch_candidates(monitor->sketch_eps);
+    monitor->sketch_keys = malloc(monitor->sketch_cand * sizeof(char*));
+    monitor->sketch_counts = malloc(monitor->sketch_cand * sizeof(uint32_t));
+    monitor->sketch_key.len = 0;
+    monitor->sketch_key.size = TEXT_SIZE;
+    monitor->sketch_key.buf = malloc(monitor->sketch_key.size);
+    monitor->sketch_repeated = 0;
+}
+
+/*
+ * Free every relation sketch and the edge filter
+ */
+static void free_sketches(t_monitor* monitor) {
+    
+    size_t i;
+    
+    for (i=0; i<monitor->sketch_count; i++) {
+        sketch_destroy(monitor->sketch_arr[i].sketch);
+        name_free(monitor->sketch_arr[i].rel);
+    }
+    free(monitor->sketch_arr);
+    free(monitor->sketch_key.buf);
+    free(monitor->sketch_keys);
+    free(monitor->sketch_counts);
+    free(monitor->sketch_gen);
+    sketch_filter_destroy(monitor->sketch_filter);
+}
+
+/*
+ * Print statistics of approximate mode
+ */
+static void sketch_stats(t_monitor* monitor, FILE* out) {
+    
+    fprintf(out, "sketches: %zu relation types, %zu addrel taken as repeated, edge filter false positives %.3g\n", 
+            monitor->sketch_count, monitor->sketch_repeated, sketch_filter_fp(monitor->sketch_filter));
+}
+
+/*
+ * Print every relation sketch with its number of relations
+ */
+static void sketch_dump(t_monitor* monitor, FILE* out) {
+    
+    size_t i;
+    
+    for (i=0; i<monitor->sketch_count; i++)
+        fprintf(out, "sketch %s: %" PRIu64 " relations\n", monitor->sketch_arr[i].rel, sketch_total(monitor->sketch_arr[i].sketch));
+}
+
+/*
+ * Set up the hash engine with an empty relation table
+ */
+static void hash_init(t_monitor* monitor) {
+    
+    monitor->hash_rel_size = HASH_REL_SIZE;
+    monitor->hash_rel_arr = calloc(monitor->hash_rel_size, sizeof(t_hash_rel));
+    monitor->hash_rel_count = monitor->hash_rel_used = 0;
+    monitor->hash_resizes = 0;
+    monitor->hash_order_size = monitor->hash_dests_size = HASH_SET_SIZE;
+    monitor->hash_order = malloc(monitor->hash_order_size * sizeof(t_hash_rel*));
+    monitor->hash_dests = malloc(monitor->hash_dests_size * sizeof(t_hash_dest*));
+}
+
+/*
+ * Free every relation of the hash engine with its destinations. Entities are pointers to the dictionary, not freed
+ */
+static void hash_free(t_monitor* monitor) {
+    
+    uint32_t i, j;
+    t_hash_rel* rel;
+    
+    for (i=0; i<monitor->hash_rel_size; i++) {
+        rel = &monitor->hash_rel_arr[i];
+        if (rel->rel == NULL || rel->rel == HASH_DELETED)
+            continue;
+        for (j=0; j<rel->dest_size; j++)
+            if (rel->dest[j].dest != NULL && rel->dest[j].dest != HASH_DELETED)
+                free(rel->dest[j].orig);
+        free(rel->dest);
+        name_free(rel->rel);
+    }
+    
+    free(monitor->hash_rel_arr);
+    free(monitor->hash_order);
+    free(monitor->hash_dests);
+}
+
+/*
+ * Send addrel or delrel by names to the hash engine. Delrel of a missing relation type is dropped before resolving entities
+ */
+static void hash_apply_rel(t_monitor* monitor, char* orig, char* dest, char* rel, const int add) {
+    
+    char* dest_ent;
+    char* orig_ent;
+    
+    if (!add && hash_find_rel(monitor, rel, 0) == NULL)
+        return;
+    
+    dest_ent = search_entity(monitor, dest);
+    orig_ent = search_entity(monitor, orig);
+    if (dest_ent == NULL || orig_ent == NULL)           // no relation can exist with a missing entity
+        return;
+    
+    hash_edge(monitor, orig_ent, dest_ent, rel, add);
+}
+
+/*
+ * Add or delete a relation between two registered entities. 
+ * Biggest count is raised on the way up, and left to be recomputed when a destination at the top goes down
+ */
+static void hash_edge(t_monitor* monitor, char* orig, char* dest, char* rel, const int add) {
+    
+    t_hash_rel* rel_el = hash_find_rel(monitor, rel, add);
+    t_hash_dest* dest_el;
+    
+    if (rel_el == NULL)
+        return;
+    dest_el = hash_find_dest(monitor, rel_el, dest, add);
+    if (dest_el == NULL)
+        return;
+    
+    if (add) {
+        if (hash_add_orig(monitor, dest_el, orig) && rel_el->max != 0 && dest_el->count > rel_el->max)
+            rel_el->max = dest_el->count;
+        return;
+    }
+    
+    if (!hash_del_orig(dest_el, orig))
+        return;
+    if (dest_el->count + 1 == rel_el->max)
+        rel_el->max = 0;
+    if (dest_el->count == 0)
+        hash_drop_dest(monitor, rel_el, dest_el);
+}
+
+/*
+ * Remove every relation of a registered entity: its destination slot in each relation type,
+ * then the entity from the origin set of every other destination
+ */
+static void hash_del_ent(t_monitor* monitor, char* ent) {
+    
+    uint32_t i, j;
+    t_hash_rel* rel;
+    t_hash_dest* dest;
+    
+    for (i=0; i<monitor->hash_rel_size; i++) {
+        rel = &monitor->hash_rel_arr[i];
+        if (rel->rel == NULL || rel->rel == HASH_DELETED)
+            continue;
+    
+        dest = hash_find_dest(monitor, rel, ent, 0);
+        if (dest != NULL) {
+            if (dest->count == rel->max)
+                rel->max = 0;
+            hash_drop_dest(monitor, rel, dest);
+        }
+    
+        for (j=0; rel->rel != HASH_DELETED && j<rel->dest_size; j++) {     // stop if relation went with its last destination
+            dest = &rel->dest[j];
+            if (dest->dest == NULL || dest->dest == HASH_DELETED || !hash_del_orig(dest, ent))
+                continue;
+            if (dest->count + 1 == rel->max)
+                rel->max = 0;
+            if (dest->count == 0)
+                hash_drop_dest(monitor, rel, dest);
+        }
+    }
+}
+
+/*
+ * Format the report of the hash engine into report text, same line as the sorted array engine.
+ * Relations are sorted by name at each report, receivers with the biggest count are collected and sorted by name
+ */
+static void hash_report(t_monitor* monitor) {
+    
+    size_t i, j, n, m;
+    char number[16];
+    t_hash_rel* rel;
+    
+    monitor->report_text.len = 0;
+    n = hash_sorted(monitor);
+    
+    if (n == 0)                                         // no elements, print none
+        text_append(&monitor->report_text, "none", 4);
+    
+    for (i=0; i<n; i++) {
+        rel = monitor->hash_order[i];
+        if (rel->max == 0)
+            hash_max(rel);
+        m = hash_collect(monitor, rel, rel->max);
+        qsort(monitor->hash_dests, m, sizeof(t_hash_dest*), hash_dest_compare);
+    
+        text_append(&monitor->report_text, rel->rel, name_len(rel->rel));
+        text_append(&monitor->report_text, " ", 1);
+        for (j=0; j<m; j++) {
+            text_append(&monitor->report_text, monitor->hash_dests[j]->dest, name_len(monitor->hash_dests[j]->dest));
+            text_append(&monitor->report_text, " ", 1);
+        }
+        text_append(&monitor->report_text, number, snprintf(number, sizeof(number), "%" PRIu32 "; ", rel->max));
+    }
+    
+    text_append(&monitor->report_text, "\n", 1);
+}
+
+/*
+ * Format top k receivers of every relation of the hash engine into report text, like topk.
+ * Destinations of each relation are sorted by decreasing count then name
+ */
+static void hash_topk(t_monitor* monitor, const int k) {
+    
+    size_t i, j, n, m;
+    char number[16];
+    t_hash_rel* rel;
+    
+    monitor->report_text.len = 0;
+    n = hash_sorted(monitor);
+    
+    for (i=0; i<n; i++) {
+        rel = monitor->hash_order[i];
+        m = hash_collect(monitor, rel, 1);
+        qsort(monitor->hash_dests, m, sizeof(t_hash_dest*), hash_dest_compare);
+    
+        text_append(&monitor->report_text, rel->rel, name_len(rel->rel));
+        for (j=0; j<m && j<(size_t)k; j++) {
+            text_append(&monitor->report_text, " ", 1);
+            text_append(&monitor->report_text, monitor->hash_dests[j]->dest, name_len(monitor->hash_dests[j]->dest));
+            text_append(&monitor->report_text, number, snprintf(number, sizeof(number), " %" PRIu32, monitor->hash_dests[j]->count));
+        }
+        text_append(&monitor->report_text, "; ", 2);
+    }
+    
+    if (monitor->report_text.len == 0)                  // no elements, print none
+        text_append(&monitor->report_text, "none", 4);
+    text_append(&monitor->report_text, "\n", 1);
+}
+
+/*
+ * Print statistics of the hash engine
+ */
+static void hash_stats(t_monitor* monitor, FILE* out) {
+    
+    fprintf(out, "relations: %" PRIu32 "\n", monitor->hash_rel_count);
+    fprintf(out, "hash tables: %" PRIu32 " relation slots, %" PRIu32 " deleted, %zu resizes\n", monitor->hash_rel_size,
+            monitor->hash_rel_used - monitor->hash_rel_count, monitor->hash_resizes);
+}
+
+/*
+ * Print every relation of the hash engine in name order, destinations and origins in slot order
+ */
+static void hash_dump(t_monitor* monitor, FILE* out) {
+    
+    size_t i, n = hash_sorted(monitor);
+    uint32_t j, o;
+    t_hash_rel* rel;
+    t_hash_dest* dest;
+    
+    for (i=0; i<n; i++) {
+        rel = monitor->hash_order[i];
+        if (rel->max == 0)
+            hash_max(rel);
+        fprintf(out, "rel_elem[%zu] -> %s\n", i, rel->rel);
+        fprintf(out, "\tmax rel received: %" PRIu32 "\n", rel->max);
+        fprintf(out, "\tcurr total dest: %" PRIu32 " in %" PRIu32 " slots\n", rel->dest_count, rel->dest_size);
+        for (j=0; j<rel->dest_size; j++) {
+            dest = &rel->dest[j];
+            if (dest->dest == NULL || dest->dest == HASH_DELETED)
+                continue;
+            fprintf(out, "\tdest slot %" PRIu32 " -> %s\n\t\tdest of count: %" PRIu32 "\n\t\tdest of arr ->", j, dest->dest, dest->count);
+            for (o=0; o<dest->orig_size; o++)
+                if (dest->orig[o] != NULL && dest->orig[o] != HASH_DELETED)
+                    fprintf(out, " %s ", dest->orig[o]);
+            fprintf(out, "\n");
+        }
+    }
+    
+    fprintf(out, "\n");
+}
+
+/*
+ * Write an addrel for every origin of every destination of the hash engine, in slot order
+ */
+static void hash_save(t_monitor* monitor, FILE* out) {
+    
+    uint32_t i, j, o;
+    t_hash_rel* rel;
+    t_hash_dest* dest;
+    
+    for (i=0; i<monitor->hash_rel_size; i++) {
+        rel = &monitor->hash_rel_arr[i];
+        if (rel->rel == NULL || rel->rel == HASH_DELETED)
+            continue;
+        for (j=0; j<rel->dest_size; j++) {
+            dest = &rel->dest[j];
+            if (dest->dest == NULL || dest->dest == HASH_DELETED)
+                continue;
+            for (o=0; o<dest->orig_size; o++)
+                if (dest->orig[o] != NULL && dest->orig[o] != HASH_DELETED)
+                    fprintf(out, "addrel %s %s %s\n", dest->orig[o], dest->dest, rel->rel);
+        }
+    }
+}
+
+/*
+ * Find a relation by name with double hashing, creating it if asked. Return NULL if missing.
+ * A new relation takes the first deleted slot met on its path, or the free one ending it
+ */
+static t_hash_rel* hash_find_rel(t_monitor* monitor, const char* rel, const int create) {
+    
+    const size_t len = strlen(rel);
+    const uint64_t h = hash_string(rel);
+    uint32_t size = monitor->hash_rel_size;
+    uint32_t pos = h % size, step = 1 + h % (size - 1), free_pos = UINT32_MAX;
+    t_hash_rel* slot;
+    
+    for (slot = &monitor->hash_rel_arr[pos]; slot->rel != NULL; slot = &monitor->hash_rel_arr[pos]) {
+        if (slot->rel == HASH_DELETED) {
+            if (free_pos == UINT32_MAX)
+                free_pos = pos;
+        }
+        else if (slot->hash == h && name_compare_len(slot->rel, rel, len) == 0)
+            return slot;
+        pos = (pos + step < size) ? pos + step : pos + step - size;
+    }
+    
+    if (!create)
+        return NULL;
+    
+    if (free_pos == UINT32_MAX) {                       // takes a free slot, resize first if too many are used
+        if ((uint64_t)(monitor->hash_rel_used + 1) * 100 > (uint64_t)size * HASH_LOAD_PERCENTAGE) {
+            hash_resize_rels(monitor);
+            return hash_find_rel(monitor, rel, create);
+        }
+        monitor->hash_rel_used++;
+        free_pos = pos;
+    }
+    
+    slot = &monitor->hash_rel_arr[free_pos];
+    slot->rel = name_new(rel, len);
+    slot->hash = h;
+    slot->dest_size = HASH_SET_SIZE;
+    slot->dest = calloc(slot->dest_size, sizeof(t_hash_dest));
+    slot->dest_count = slot->dest_used = 0;
+    slot->max = 0;
+    monitor->hash_rel_count++;
+    
+    return slot;
+}
+
+/*
+ * Find a destination of a relation, creating it with an empty origin set if asked. Return NULL if missing
+ */
+static t_hash_dest* hash_find_dest(t_monitor* monitor, t_hash_rel* rel, char* dest, const int create) {
+    
+    int found;
+    uint32_t new_size;
+    const uint64_t h = hash_ptr(dest);
+    uint32_t pos = hash_probe(rel->dest, sizeof(t_hash_dest), rel->dest_size, dest, h, &found);
+    t_hash_dest* slot;
+    
+    if (found)
+        return &rel->dest[pos];
+    if (!create)
+        return NULL;
+    
+    if (rel->dest[pos].dest == NULL) {                  // takes a free slot, resize first if too many are used
+        if ((uint64_t)(rel->dest_used + 1) * 100 > (uint64_t)rel->dest_size * HASH_LOAD_PERCENTAGE) {
+            new_size = hash_next_size(rel->dest_count, rel->dest_size);
+            rel->dest = hash_rehash(rel->dest, sizeof(t_hash_dest), rel->dest_size, new_size);
+            rel->dest_size = new_size;
+            rel->dest_used = rel->dest_count;
+            monitor->hash_resizes++;
+            pos = hash_probe(rel->dest, sizeof(t_hash_dest), rel->dest_size, dest, h, &found);
+        }
+        rel->dest_used++;
+    }
+    
+    slot = &rel->dest[pos];
+    slot->dest = dest;
+    slot->count = 0;
+    slot->orig_used = 0;
+    slot->orig_size = HASH_SET_SIZE;
+    slot->orig = calloc(slot->orig_size, sizeof(char*));
+    rel->dest_count++;
+    
+    return slot;
+}
+
+/*
+ * Add an origin to the set of a destination. Return 1 if it was missing
+ */
+static int hash_add_orig(t_monitor* monitor, t_hash_dest* dest, char* orig) {
+    
+    int found;
+    uint32_t new_size;
+    const uint64_t h = hash_ptr(orig);
+    uint32_t pos = hash_probe(dest->orig, sizeof(char*), dest->orig_size, orig, h, &found);
+    
+    if (found)
+        return 0;
+    
+    if (dest->orig[pos] == NULL) {                      // takes a free slot, resize first if too many are used
+        if ((uint64_t)(dest->orig_used + 1) * 100 > (uint64_t)dest->orig_size * HASH_LOAD_PERCENTAGE) {
+            new_size = hash_next_size(dest->count, dest->orig_size);
+            dest->orig = hash_rehash(dest->orig, sizeof(char*), dest->orig_size, new_size);
+            dest->orig_size = new_size;
+            dest->orig_used = dest->count;
+            monitor->hash_resizes++;
+            pos = hash_probe(dest->orig, sizeof(char*), dest->orig_size, orig, h, &found);
+        }
+        dest->orig_used++;
+    }
+    
+    dest->orig[pos] = orig;
+    dest->count++;
+    
+    return 1;
+}
+
+/*
+ * Remove an origin from the set of a destination, leaving a deleted slot so that probe paths stay whole.
+ * Return 1 if it was there
+ */
+static int hash_del_orig(t_hash_dest* dest, char* orig) {
+    
+    int found;
+    uint32_t pos = hash_probe(dest->orig, sizeof(char*), dest->orig_size, orig, hash_ptr(orig), &found);
+    
+    if (!found)
+        return 0;
+    
+    dest->orig[pos] = HASH_DELETED;
+    dest->count--;
+    
+    return 1;
+}
+
+/*
+ * Remove a destination without origins left. A relation without destinations left is removed too
+ */
+static void hash_drop_dest(t_monitor* monitor, t_hash_rel* rel, t_hash_dest* dest) {
+    
+    free(dest->orig);
+    dest->dest = HASH_DELETED;
+    rel->dest_count--;
+    
+    if (rel->dest_count > 0)
+        return;
+    
+    free(rel->dest);
+    name_free(rel->rel);
+    rel->rel = HASH_DELETED;
+    monitor->hash_rel_count--;
+}
+
+/*
+ * Find a key in a table keyed by pointers with double hashing, as the hash table prototype: attempt i looks at
+ * (h mod m + i * (1 + h mod (m-1))) mod m, which visits every slot since m is prime.
+ * Slots start with their key and are stride bytes apart. Return the slot of key and set found, 
+ * else the first deleted slot met or the free one ending the path
+ */
+static uint32_t hash_probe(const void* slots, const size_t stride, const uint32_t size, const char* key, const uint64_t h, int* found) {
+    
+    uint32_t pos = h % size, step = 1 + h % (size - 1), free_pos = UINT32_MAX;
+    const char* slot;
+    
+    for (;;) {
+        slot = *(char* const*)((const char*)slots + (size_t)pos * stride);
+        if (slot == key) {
+            *found = 1;
+            return pos;
+        }
+        if (slot == NULL)
+            break;
+        if (slot == HASH_DELETED && free_pos == UINT32_MAX)
+            free_pos = pos;
+        pos = (pos + step < size) ? pos + step : pos + step - size;
+    }
+    
+    *found = 0;
+    return (free_pos == UINT32_MAX) ? pos : free_pos;
+}
+
+/*
+ * Move every live slot of a table keyed by pointers into a new table of new_size slots, the old one is freed.
+ * Return the new table, without deleted slots
+ */
+static void* hash_rehash(void* slots, const size_t stride, const uint32_t size, const uint32_t new_size) {
+    
+    int found;
+    uint32_t i, pos;
+    char* key;
+    char* new_slots = calloc(new_size, stride);
+    
+    for (i=0; i<size; i++) {
+        key = *(char**)((char*)slots + (size_t)i * stride);
+        if (key == NULL || key == HASH_DELETED)
+            continue;
+        pos = hash_probe(new_slots, stride, new_size, key, hash_ptr(key), &found);
+        memcpy(new_slots + (size_t)pos * stride, (char*)slots + (size_t)i * stride, stride);
+    }
+    
+    free(slots);
+    return new_slots;
+}
+
+/*
+ * Move every live relation into a new relation table, hashes are kept in the slots so names are not read
+ */
+static void hash_resize_rels(t_monitor* monitor) {
+    
+    uint32_t i, pos, step;
+    uint32_t size = hash_next_size(monitor->hash_rel_count, monitor->hash_rel_size);
+    t_hash_rel* old = monitor->hash_rel_arr;
+    t_hash_rel* arr = calloc(size, sizeof(t_hash_rel));
+    
+    for (i=0; i<monitor->hash_rel_size; i++) {
+        if (old[i].rel == NULL || old[i].rel == HASH_DELETED)
+            continue;
+        pos = old[i].hash % size;
+        step = 1 + old[i].hash % (size - 1);
+        while (arr[pos].rel != NULL)
+            pos = (pos + step < size) ? pos + step : pos + step - size;
+        arr[pos] = old[i];
+    }
+    
+    free(old);
+    monitor->hash_rel_arr = arr;
+    monitor->hash_rel_size = size;
+    monitor->hash_rel_used = monitor->hash_rel_count;
+    monitor->hash_resizes++;
+}
+
+/*
+ * Size of a table that ran out of free slots: next prime after twice the size if live keys use more than
+ * half the load factor, same size else since deleted slots are enough to make room
+ */
+static inline uint32_t hash_next_size(const uint32_t count, const uint32_t size) {
+    
+    if ((uint64_t)count * 200 > (uint64_t)size * HASH_LOAD_PERCENTAGE)
+        return next_prime(2 * size);
+    return size;
+}
+
+/*
+ * Hash of an entity by its pointer, names in the entity dictionary do not move while the entity lives
+ */
+static inline uint64_t hash_ptr(const char* ent) {
+    
+    return hash_mix((uint64_t)(uintptr_t)ent, 0);
+}
+
+/*
+ * Recompute the biggest count of a relation scanning its destinations
+ */
+static void hash_max(t_hash_rel* rel) {
+    
+    uint32_t i;
+    
+    rel->max = 0;
+    for (i=0; i<rel->dest_size; i++)
+        if (rel->dest[i].dest != NULL && rel->dest[i].dest != HASH_DELETED && rel->dest[i].count > rel->max)
+            rel->max = rel->dest[i].count;
+}
+
+/*
+ * Collect every live relation into the relations scratch, sorted by name. Return their number
+ */
+static size_t hash_sorted(t_monitor* monitor) {
+    
+    uint32_t i;
+    size_t n = 0;
+    
+    if (monitor->hash_order_size < monitor->hash_rel_count) {
+        monitor->hash_order_size = monitor->hash_rel_count;
+        monitor->hash_order = realloc(monitor->hash_order, monitor->hash_order_size * sizeof(t_hash_rel*));
+    }
+    
+    for (i=0; i<monitor->hash_rel_size; i++)
+        if (monitor->hash_rel_arr[i].rel != NULL && monitor->hash_rel_arr[i].rel != HASH_DELETED)
+            monitor->hash_order[n++] = &monitor->hash_rel_arr[i];
+    
+    qsort(monitor->hash_order, n, sizeof(t_hash_rel*), hash_rel_compare);
+    
+    return n;
+}
+
+/*
+ * Collect destinations of a relation receiving at least min relations into the destinations scratch. Return their number
+ */
+static size_t hash_collect(t_monitor* monitor, t_hash_rel* rel, const uint32_t min) {
+    
+    uint32_t i;
+    size_t n = 0;
+    t_hash_dest* dest;
+    
+    if (monitor->hash_dests_size < rel->dest_count) {
+        monitor->hash_dests_size = rel->dest_count;
+        monitor->hash_dests = realloc(monitor->hash_dests, monitor->hash_dests_size * sizeof(t_hash_dest*));
+    }
+    
+    for (i=0; i<rel->dest_size; i++) {
+        dest = &rel->dest[i];
+        if (dest->dest != NULL && dest->dest != HASH_DELETED && dest->count >= min)
+            monitor->hash_dests[n++] = dest;
+    }
+    
+    return n;
+}
+
+/*
+ * Compare function for qsort for relations of the hash engine, by name
+ */
+static int hash_rel_compare(const void* a, const void* b) {
+    
+    return name_compare((*(t_hash_rel* const*)a)->rel, (*(t_hash_rel* const*)b)->rel);
+}
+
+/*
+ * Compare function for qsort for destinations of the hash engine, by decreasing count then name
+ */
+static int hash_dest_compare(const void* a, const void* b) {
+    
+    const t_hash_dest* x = *(t_hash_dest* const*)a;
+    const t_hash_dest* y = *(t_hash_dest* const*)b;
+    
+    if (x->count != y->count)
+        return (x->count < y->count) ? 1 : -1;
+    return name_compare(x->dest, y->dest);
+}
+
+/*
+ * Calculate a^n mod m, m below 2^32 so that products fit
+ */
+static uint64_t power_mod(uint64_t a, uint64_t n, const uint64_t m) {
+    
+    uint64_t result = 1;
+    
+    a %= m;
+    while (n) {
+        if (n & 1)
+            result = (result * a) % m;
+        a = (a * a) % m;
+        n >>= 1;
+    }
+    
+    return result;
+}
+
+/*
+ * Miller-Rabin round of n with base a, n-1 = 2^s * d with d odd. Return 0 if a proves n composite
+ */
+static int witness(const uint64_t n, uint32_t s, const uint64_t d, const uint64_t a) {
+    
+    uint64_t x = power_mod(a, d, n);
+    uint64_t y = x;
+    
+    while (s--) {
+        y = (x * x) % n;
+        if (y == 1 && x != 1 && x != n-1)
+            return 0;
+        x = y;
+    }
+    
+    return y == 1;
+}
+
+/*
+ * Miller-Rabin primality test. Bases 2, 3, 5 and 7 are enough below 3,215,031,751
+ */
+static int is_prime(const uint32_t n) {
+    
+    uint32_t d = n - 1, s = 0;
+    
+    if (n < 11)
+        return n == 2 || n == 3 || n == 5 || n == 7;
+    if (n % 2 == 0 || n % 3 == 0 || n % 5 == 0 || n % 7 == 0)
+        return 0;
+    
+    while (!(d & 1)) {
+        d >>= 1;
+        s++;
+    }
+    
+    return witness(n, s, d, 2) && witness(n, s, d, 3) && witness(n, s, d, 5) && witness(n, s, d, 7);
+}
+
+/*
+ * Find next prime number after x
+ */
+static uint32_t next_prime(uint32_t x) {
+    
+    while (!is_prime(++x));
+    
+    return x;
+}
@@ -0,0 +1,106 @@
+#ifndef MONITOR_H
+#define MONITOR_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// DEFINES
+
+#define MONITOR_DICT_ARRAY 0                    // entity dictionary as sorted array of fixed size names
+#define MONITOR_DICT_RADIX 1                    // entity dictionary as compressed radix tree (crit-bit)
+#define MONITOR_DICT_HASH 2                     // entity dictionary as concurrent interning hash table
+
+#define MONITOR_ENGINE_ARRAY 0                  // relations in sorted arrays with a perfect hash over their names
+#define MONITOR_ENGINE_HASH 1                   // relations in open addressing hash tables with double hashing
+
+// END OF DEFINES
+
+// Relationship monitor. Every instance is independent, one instance must be used by one thread at a time,
+// only monitor_snapshot_report can be called by other threads meanwhile
+typedef struct monitor t_monitor;
+
+// Options of a monitor, fixed at creation
+typedef struct monitor_config {
+    
+    int ent_dict;                       // entity dictionary, MONITOR_DICT_ARRAY, MONITOR_DICT_RADIX or MONITOR_DICT_HASH
+    int engine;                         // relation storage, MONITOR_ENGINE_ARRAY or MONITOR_ENGINE_HASH, same reports from both
+    int batch_mode;                     // 1 if addrel and delrel are buffered until report or delent
+    int peep_mode;                      // 1 if commands go through the peephole optimizer
+    int shard_count;                    // number of worker threads owning the relations, 0 if not sharded
+    int snapshot_mode;                  // 1 if reports are published as immutable snapshots, printed by a reporter thread
+    int delta_mode;                     // 1 if a report lists only relations changed since previous one, removed ones with count 0
+    double sketch_eps;                  // 0 for exact counts, else approximate mode: fixed memory, counts off by at most eps * relations of the type
+    double sketch_delta;                // probability that an approximate count goes beyond its error
+    size_t sketch_edges;                // live relations expected in approximate mode, sizes the filter of repeated relations
+    const char* store_path;             // NULL to keep entities and relations on the heap, else out-of-core mode: they live in
+                                        // this file mapped in memory and are found there again by the next monitor opening it
+    
+} t_monitor_config;
+
+// FUNCTION PROTOTYPES
+
+// Fill passed options with the default ones
+void monitor_default_config(t_monitor_config* config);
+
+// Create a monitor with the passed options, default ones if NULL
+t_monitor* monitor_create(const t_monitor_config* config);
+
+// Release all memory of the monitor. In out-of-core mode entities and relations stay in the store file, pending ttl are dropped
+void monitor_destroy(t_monitor* monitor);
+
+// Add entity, names have any length and are copied
+void monitor_add_entity(t_monitor* monitor, const char* ent);
+
+// Delete entity and every relation it is part of
+void monitor_del_entity(t_monitor* monitor, const char* ent);
+
+// Add relation from orig to dest, relation names have any length and are copied
+void monitor_add_rel(t_monitor* monitor, const char* orig, const char* dest, const char* rel);
+
+// Add relation from orig to dest deleted after ttl ticks, never if ttl is 0
+void monitor_add_rel_ttl(t_monitor* monitor, const char* orig, const char* dest, const char* rel, const uint64_t ttl);
+
+// Advance logical time by n ticks, deleting expired relations
+void monitor_tick(t_monitor* monitor, const uint64_t n);
+
+// Delete relation from orig to dest
+void monitor_del_rel(t_monitor* monitor, const char* orig, const char* dest, const char* rel);
+
+// Format the report line into buffer, only changes since previous report in delta mode. Return its whole length, like snprintf
+size_t monitor_report(t_monitor* monitor, char* buffer, size_t size);
+
+// Publish a snapshot of the relations, snapshot mode only. Called by the thread issuing the commands
+void monitor_publish(t_monitor* monitor);
+
+// Format the report line of last published snapshot into buffer, like monitor_report. Any thread can call it
+size_t monitor_snapshot_report(t_monitor* monitor, char* buffer, size_t size);
+
+// Format top k receivers of every relation with their counts into buffer, like monitor_report
+size_t monitor_topk(t_monitor* monitor, const int k, char* buffer, size_t size);
+
+// Read commands from input until 'end', printing reports on output. Input is text or a binary trace of trace.h
+void monitor_execute(t_monitor* monitor, FILE* input, FILE* output);
+
+// Execute one command line of monitor_execute grammar. Return reply of report and topk, valid until next call, NULL for others
+const char* monitor_command(t_monitor* monitor, const char* line, size_t* len);
+
+// Print statistics of the monitor
+void monitor_print_stats(t_monitor* monitor, FILE* out);
+
+// Print the error guarantee of approximate mode, nothing for exact counts
+void monitor_print_guarantee(t_monitor* monitor, FILE* out);
+
+// Print entity dictionary and every relation structure, for debugging
+void monitor_dump(t_monitor* monitor, FILE* out);
+
+// Write entities and relations to path as commands that rebuild them, from a forked copy of the process while
+// commands go on. Return 0 if started, -1 if another one is running, in approximate or out-of-core mode or if fork failed
+int monitor_checkpoint(t_monitor* monitor, const char* path);
+
+// Report on stderr the end of the running checkpoint, waiting for it if wait is set. Return 1 while it is running, 0 else
+int monitor_checkpoint_poll(t_monitor* monitor, const int wait);
+
+// END OF FUNCTION PROTOTYPES
+
+#endif
@@ -0,0 +1,397 @@
+#define _GNU_SOURCE                     // accept4
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+
+#include "server.h"
+
+// DEFINES
+
+#define CLIENT_INPUT_SIZE 65536                 // initial size of received bytes of a client, doubled for a longer line
+#define CLIENT_LINE_MAX (1 << 24)               // size of received bytes a line may grow to, longer lines are cut
+#define CLIENT_OUTPUT_SIZE 4096                 // initial size of pending replies of a client
+#define CLIENT_OUTPUT_MAX (1 << 20)             // pending reply bytes of a client before its commands wait
+
+// END OF DEFINES
+
+// Connection of a local client, lines are executed as soon as they are complete
+typedef struct client {
+
+    int fd;                             // socket of the connection
+    char* in;                           // received bytes not yet executed
+    size_t in_len;                      // number of received bytes
+    size_t in_size;                     // size of received bytes buffer, one byte is kept for the terminator
+    int cutting;                        // 1 while the rest of a line too long is dropped
+    char* out;                          // replies not yet sent
+    size_t out_len;                     // number of reply bytes
+    size_t out_sent;                    // reply bytes already sent
+    size_t out_size;                    // size of replies buffer
+    int ended;                          // 1 after 'end' or end of stream, closed once replies are sent
+    struct client* prev;                // previous connected client
+    struct client* next;                // next connected client
+
+} t_client;
+
+// FUNCTION PROTOTYPES
+
+// Ask the event loop to stop, signal handler
+static void request_stop(int sig);
+
+// Create, bind and listen the socket at path
+static int open_socket(const char* path);
+
+// Accept every pending connection
+static void accept_clients(const int epoll_fd, const int listen_fd, t_client** clients);
+
+// Read what a client sent
+static void client_read(t_client* client);
+
+// Execute every complete line a client sent, stopping at 'end' or when its replies are too many
+static void client_execute(t_monitor* monitor, t_client* client);
+
+// Execute one line of a client
+static void client_line(t_monitor* monitor, t_client* client, char* line);
+
+// Check if a client has a line to execute and room for its reply
+static int client_ready(t_client* client);
+
+// Queue a reply for a client
+static void client_reply(t_client* client, const char* text, const size_t len);
+
+// Send pending replies of a client
+static void client_flush(t_client* client);
+
+// Wait for the events the client needs next, close it if it is done
+static void client_update(const int epoll_fd, t_client* client, t_client** clients);
+
+// Close a client connection
+static void client_close(const int epoll_fd, t_client* client, t_client** clients);
+
+// END OF FUNCTION PROTOTYPES
+
+// GLOBAL VARIABLES
+
+static volatile sig_atomic_t stop_requested;    // set by SIGINT and SIGTERM
+
+// END OF GLOBAL VARIABLES
+
+/*
+ * Serve local clients on a unix domain socket with an epoll loop, every client shares the same monitor.
+ * Commands of different clients interleave line by line, the state stays warm between connections
+ */
+int monitor_serve(t_monitor* monitor, const char* path) {
+    
+    int i, n, epoll_fd, listen_fd;
+    struct epoll_event ev, events[SERVER_MAX_EVENTS];
+    struct sigaction sa;
+    t_client* client;
+    t_client* clients = NULL;                           // connected clients
+    
+    listen_fd = open_socket(path);
+    if (listen_fd < 0)
+        return -1;
+    
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL;                                 // listening socket is the only one without client
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &ev);
+    
+    memset(&sa, 0, sizeof(sa));                         // no SA_RESTART, epoll_wait returns on signals
+    sa.sa_handler = request_stop;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);                           // clients leaving early are seen as write errors
+    stop_requested = 0;
+    
+    while (!stop_requested) {
+        n = epoll_wait(epoll_fd, events, SERVER_MAX_EVENTS, -1);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0) {
+            perror("epoll_wait");
+            break;
+        }
+    
+        for (i=0; i<n; i++) {
+            client = events[i].data.ptr;
+            if (client == NULL) {
+                accept_clients(epoll_fd, listen_fd, &clients);
+                continue;
+            }
+    
+            if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+                client_read(client);
+            do {                                        // lines wait while the client does not take its replies
+                client_execute(monitor, client);
+                client_flush(client);
+            } while (client_ready(client));
+            client_update(epoll_fd, client, &clients);
+        }
+    }
+    
+    while (clients != NULL)                             // clients still connected are dropped
+        client_close(epoll_fd, clients, &clients);
+    close(epoll_fd);
+    close(listen_fd);
+    unlink(path);
+    
+    return 0;
+}
+
+/*
+ * Signal handler, the loop checks the flag after epoll_wait is interrupted
+ */
+static void request_stop(int sig) {
+    
+    stop_requested = 1;
+}
+
+/*
+ * Create a non blocking socket bound at path. A stale socket left by a previous server is replaced
+ */
+static int open_socket(const char* path) {
+    
+    int fd;
+    struct sockaddr_un addr;
+    struct stat st;
+    
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "socket path too long: %s\n", path);
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    
+    if (stat(path, &st) == 0 && S_ISSOCK(st.st_mode))
+        unlink(path);
+    
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0 || bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(fd, SERVER_BACKLOG) < 0) {
+        perror(path);
+        if (fd >= 0)
+            close(fd);
+        return -1;
+    }
+    
+    return fd;
+}
+
+/*
+ * Accept pending connections until none is left, each one is watched for input
+ */
+static void accept_clients(const int epoll_fd, const int listen_fd, t_client** clients) {
+    
+    int fd;
+    struct epoll_event ev;
+    t_client* client;
+    
+    while ((fd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+        client = calloc(1, sizeof(t_client));
+        client->fd = fd;
+        client->out_size = CLIENT_OUTPUT_SIZE;
+        client->out = malloc(client->out_size);
+        client->in_size = CLIENT_INPUT_SIZE;
+        client->in = malloc(client->in_size);
+        client->next = *clients;                        // push on the list of connected clients
+        if (*clients != NULL)
+            (*clients)->prev = client;
+        *clients = client;
+    
+        ev.events = EPOLLIN;
+        ev.data.ptr = client;
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+    }
+}
+
+/*
+ * Read from a client until nothing is left or its input buffer is full. End of stream or an error end it.
+ * Buffer grows only while it holds a single unfinished line, so complete lines keep the usual backpressure
+ */
+static void client_read(t_client* client) {
+    
+    ssize_t n;
+    
+    while (!client->ended) {
+        if (client->in_len == client->in_size - 1) {
+            if (client->in_size == CLIENT_LINE_MAX || memchr(client->in, '\n', client->in_len) != NULL)
+                break;
+            client->in_size = client->in_size << 1;     // double size, line is longer than the buffer
+            client->in = realloc(client->in, client->in_size);
+        }
+        n = read(client->fd, client->in + client->in_len, client->in_size - 1 - client->in_len);
+        if (n > 0)
+            client->in_len += n;
+        else if (n < 0 && errno == EINTR)
+            continue;
+        else {
+            if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK))
+                client->ended = 1;
+            break;
+        }
+    }
+}
+
+/*
+ * Execute every complete line of a client in order. A buffer grown to CLIENT_LINE_MAX without newline is a line
+ * too long: it is cut like fgets would and the rest until next newline is dropped. Last line may miss its newline
+ */
+static void client_execute(t_monitor* monitor, t_client* client) {
+    
+    size_t start = 0;
+    char* nl;
+    
+    while (start < client->in_len && client->out_len - client->out_sent < CLIENT_OUTPUT_MAX) {
+        nl = memchr(client->in + start, '\n', client->in_len - start);
+    
+        if (nl == NULL && start == 0 && client->in_len == CLIENT_LINE_MAX - 1) {
+            if (!client->cutting) {                     // execute what fits, drop the rest
+                client->in[client->in_len] = '\0';
+                client_line(monitor, client, client->in);
+                client->cutting = 1;
+            }
+            start = client->in_len;
+            break;
+        }
+        if (nl == NULL && client->ended) {
+            client->in[client->in_len] = '\0';           // stream over without newline
+            nl = client->in + client->in_len;
+        }
+        else if (nl == NULL)
+            break;
+    
+        *nl = '\0';
+        if (client->cutting)                            // tail of a line too long
+            client->cutting = 0;
+        else
+            client_line(monitor, client, client->in + start);
+        start = nl - client->in + 1;
+    
+        if (client->in_len == 0)                        // 'end' dropped the rest
+            return;
+        if (start > client->in_len)                     // last line had no newline
+            start = client->in_len;
+    }
+    
+    memmove(client->in, client->in + start, client->in_len - start);
+    client->in_len -= start;
+}
+
+/*
+ * Execute one line, 'end' closes the stream of the client and drops what it sent after
+ */
+static void client_line(t_monitor* monitor, t_client* client, char* line) {
+    
+    size_t len;
+    const char* text;
+    char command[8];
+    
+    if (sscanf(line, "%7s", command) == 1 && strcmp(command, "end") == 0) {
+        client->ended = 1;                              // end of this client stream, the server goes on
+        client->in_len = 0;
+        return;
+    }
+    
+    if ((text = monitor_command(monitor, line, &len)) != NULL)
+        client_reply(client, text, len);
+}
+
+/*
+ * Check if a client has a complete line waiting and its replies are not too many
+ */
+static int client_ready(t_client* client) {
+    
+    return client->out_len - client->out_sent < CLIENT_OUTPUT_MAX && client->in_len > 0 &&
+           (client->ended || memchr(client->in, '\n', client->in_len) != NULL);
+}
+
+/*
+ * Append a reply to pending ones of a client
+ */
+static void client_reply(t_client* client, const char* text, const size_t len) {
+    
+    while (client->out_len + len > client->out_size) {  // double size if full
+        client->out_size = client->out_size << 1;
+        client->out = realloc(client->out, client->out_size);
+    }
+    
+    memcpy(client->out + client->out_len, text, len);
+    client->out_len += len;
+}
+
+/*
+ * Send pending replies until the socket is full. A client that cannot receive is ended
+ */
+static void client_flush(t_client* client) {
+    
+    ssize_t n;
+    
+    while (client->out_sent < client->out_len) {
+        n = send(client->fd, client->out + client->out_sent, client->out_len - client->out_sent, MSG_NOSIGNAL);
+        if (n > 0)
+            client->out_sent += n;
+        else if (n < 0 && errno == EINTR)
+            continue;
+        else {
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                client->ended = 1;                      // gone, drop what is left
+                client->out_sent = client->out_len;
+            }
+            break;
+        }
+    }
+    
+    if (client->out_sent == client->out_len)
+        client->out_sent = client->out_len = 0;
+}
+
+/*
+ * Watch a client for output while replies are pending, for input while it can take more commands.
+ * A client whose stream ended is closed once its replies are sent
+ */
+static void client_update(const int epoll_fd, t_client* client, t_client** clients) {
+    
+    struct epoll_event ev;
+    size_t pending = client->out_len - client->out_sent;
+    
+    if (client->ended && pending == 0 && client->in_len == 0) {
+        client_close(epoll_fd, client, clients);
+        return;
+    }
+    
+    ev.events = 0;
+    if (pending > 0)
+        ev.events |= EPOLLOUT;
+    if (!client->ended && pending < CLIENT_OUTPUT_MAX)
+        ev.events |= EPOLLIN;
+    ev.data.ptr = client;
+    epoll_ctl(epoll_fd, EPOLL_CTL_MOD, client->fd, &ev);
+}
+
+/*
+ * Close a client connection and free it
+ */
+static void client_close(const int epoll_fd, t_client* client, t_client** clients) {
+    
+    if (client->prev != NULL)                           // unlink from connected clients
+        client->prev->next = client->next;
+    else
+        *clients = client->next;
+    if (client->next != NULL)
+        client->next->prev = client->prev;
+    
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, client->fd, NULL);
+    close(client->fd);
+    free(client->in);
+    free(client->out);
+    free(client);
+}
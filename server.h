@@ -0,0 +1,22 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include "monitor.h"
+
+// DEFINES
+
+#define SERVER_MAX_EVENTS 64                    // events taken from epoll at each wait
+#define SERVER_BACKLOG 64                       // connections waiting to be accepted
+
+// END OF DEFINES
+
+// FUNCTION PROTOTYPES
+
+// Keep the monitor resident and serve local clients on a unix domain socket at path, until SIGINT or SIGTERM.
+// Each client sends lines of monitor_execute grammar, replies of its report and topk go back on its connection,
+// 'end' or closing its side ends its stream. Return 0, -1 if the socket cannot be set up
+int monitor_serve(t_monitor* monitor, const char* path);
+
+// END OF FUNCTION PROTOTYPES
+
+#endif
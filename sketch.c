@@ -0,0 +1,578 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <math.h>
+
+#include "sketch.h"
+
+// Candidate heavy hitter, its count is the sketch estimate at last update
+typedef struct sketch_cand {
+
+    uint64_t hash;                      // hash of the key
+    uint32_t count;                     // estimated count
+    uint32_t heap;                      // position in the min heap
+    uint32_t len;                       // length of the key
+    union {
+        char key[SKETCH_KEY_SIZE + 1];  // bytes of the key, terminated, if len is at most SKETCH_KEY_SIZE
+        char* long_key;                 // bytes of a longer key on the heap, terminated
+    };
+
+} t_sketch_cand;
+
+struct sketch {
+
+    uint32_t width;                     // counters of each row, power of 2
+    uint32_t depth;                     // rows, one hash function each
+    uint32_t* counter;                  // depth rows of width counters
+    uint64_t total;                     // sum of every count
+
+    t_sketch_cand* cand;                // candidate heavy hitters
+    uint32_t cand_count;                // number of candidates
+    uint32_t cand_size;                 // length of candidates array
+    uint32_t* heap;                     // candidates by increasing count, the first one is replaced by a bigger key
+    uint32_t* index;                    // hash index over candidates, position + 1, 0 if empty
+    uint32_t index_size;                // length of candidates index, power of 2
+    t_sketch_cand** order;              // scratch to sort candidates
+
+};
+
+struct sketch_filter {
+
+    size_t size;                        // number of cells, power of 2
+    size_t used;                        // cells not 0
+    uint8_t cell[];                     // number of keys on each cell, stuck once it reaches 255
+
+};
+
+// DEFINES
+
+#define CELL_STUCK 255                          // cell count that is never decremented again
+
+// END OF DEFINES
+
+// FUNCTION PROTOTYPES
+
+// Hash a key with FNV-1a and a final mix, low and high halves are the two hashes of double hashing
+static inline uint64_t hash_key(const char* key, const size_t len);
+
+// Smallest power of 2 not less than n
+static inline size_t round_pow2(const size_t n);
+
+// Estimated count of a key by its hash
+static inline uint32_t estimate(t_sketch* sketch, const uint64_t h);
+
+// Find a candidate. Return its position, -1 if missing
+static int cand_find(t_sketch* sketch, const char* key, const size_t len, const uint64_t h);
+
+// Find the index slot of a candidate
+static size_t index_slot(t_sketch* sketch, const uint32_t c);
+
+// Insert a candidate in the index
+static void index_insert(t_sketch* sketch, const uint32_t c);
+
+// Remove the candidate in passed slot from the index
+static void index_delete(t_sketch* sketch, size_t pos);
+
+// Move a heap element up until its parent is not bigger
+static void heap_up(t_sketch* sketch, uint32_t pos);
+
+// Move a heap element down until its children are not smaller
+static void heap_down(t_sketch* sketch, uint32_t pos);
+
+// Remove a candidate from index, heap and array
+static void cand_remove(t_sketch* sketch, const uint32_t c);
+
+// Compare two candidates by decreasing count, then by key
+static int cand_compare(const void* a, const void* b);
+
+// Bytes of the key of a candidate
+static inline const char* cand_key(const t_sketch_cand* cand);
+
+// Store the key of a candidate, spilled to the heap if long
+static inline void cand_set_key(t_sketch_cand* cand, const char* key, const size_t len);
+
+// Free the key of a candidate if it was spilled to the heap
+static inline void cand_free_key(t_sketch_cand* cand);
+
+// END OF FUNCTION PROTOTYPES
+
+/*
+ * Create an empty sketch. Rows are e/eps counters wide, rounded up to a power of 2, and ln(1/delta) deep.
+ * One candidate is kept for each 1/eps, so every key above eps * total fits
+ */
+t_sketch* sketch_create(const double eps, const double delta) {
+    
+    t_sketch* sketch = calloc(1, sizeof(t_sketch));
+    
+    sketch->width = round_pow2((size_t)ceil(M_E / eps));
+    sketch->depth = (uint32_t)ceil(log(1 / delta));
+    if (sketch->depth < 1)
+        sketch->depth = 1;
+    sketch->counter = calloc((size_t)sketch->width * sketch->depth, sizeof(uint32_t));
+    sketch->total = 0;
+    
+    sketch->cand_size = sketch_candidates(eps);
+    sketch->cand_count = 0;
+    sketch->cand = malloc(sketch->cand_size * sizeof(t_sketch_cand));
+    sketch->heap = malloc(sketch->cand_size * sizeof(uint32_t));
+    sketch->index_size = round_pow2(sketch->cand_size * 2);
+    sketch->index = calloc(sketch->index_size, sizeof(uint32_t));
+    sketch->order = malloc(sketch->cand_size * sizeof(t_sketch_cand*));
+    
+    return sketch;
+}
+
+/*
+ * Free the sketch
+ */
+void sketch_destroy(t_sketch* sketch) {
+    
+    uint32_t i;
+    
+    for (i=0; i<sketch->cand_count; i++)
+        cand_free_key(&sketch->cand[i]);
+    free(sketch->counter);
+    free(sketch->cand);
+    free(sketch->heap);
+    free(sketch->index);
+    free(sketch->order);
+    free(sketch);
+}
+
+/*
+ * Add n to the count of a key, n negative removes. Counters never go below 0.
+ * A key that is not a candidate takes the place of the smallest one when its estimate gets bigger
+ */
+void sketch_update(t_sketch* sketch, const char* key, const size_t len, const int n) {
+    
+    uint32_t i, c, est;
+    int found;
+    uint32_t* cell;
+    const uint64_t h = hash_key(key, len);
+    
+    for (i=0; i<sketch->depth; i++) {
+        cell = &sketch->counter[(size_t)i * sketch->width + (((uint32_t)h + i * (uint32_t)((h >> 32) | 1)) & (sketch->width - 1))];
+        if (n >= 0)
+            *cell += n;
+        else
+            *cell = (*cell >= (uint32_t)-n) ? *cell + n : 0;
+    }
+    if (n >= 0)
+        sketch->total += n;
+    else
+        sketch->total = (sketch->total >= (uint64_t)-(int64_t)n) ? sketch->total + n : 0;
+    
+    est = estimate(sketch, h);
+    found = cand_find(sketch, key, len, h);
+    
+    if (found >= 0) {                                   // candidate already, move it in the heap
+        sketch->cand[found].count = est;
+        heap_up(sketch, sketch->cand[found].heap);
+        heap_down(sketch, sketch->cand[found].heap);
+        return;
+    }
+    if (n <= 0)
+        return;
+    
+    if (sketch->cand_count < sketch->cand_size) {       // free place
+        c = sketch->cand_count++;
+        sketch->cand[c].heap = c;
+        sketch->heap[c] = c;
+    }
+    else if (est > sketch->cand[sketch->heap[0]].count) {      // replace smallest candidate
+        c = sketch->heap[0];
+        index_delete(sketch, index_slot(sketch, c));
+        cand_free_key(&sketch->cand[c]);
+    }
+    else
+        return;
+    
+    sketch->cand[c].hash = h;
+    sketch->cand[c].count = est;
+    cand_set_key(&sketch->cand[c], key, len);
+    index_insert(sketch, c);
+    heap_up(sketch, sketch->cand[c].heap);
+    heap_down(sketch, sketch->cand[c].heap);
+}
+
+/*
+ * Estimated count of a key, the minimum of its counters
+ */
+uint32_t sketch_estimate(t_sketch* sketch, const char* key, const size_t len) {
+    
+    return estimate(sketch, hash_key(key, len));
+}
+
+/*
+ * Drop a key from the candidates. Its counters are left as they are, they cannot be told apart from other keys
+ */
+void sketch_forget(t_sketch* sketch, const char* key, const size_t len) {
+    
+    int c = cand_find(sketch, key, len, hash_key(key, len));
+    
+    if (c >= 0)
+        cand_remove(sketch, c);
+}
+
+/*
+ * Refresh estimates of every candidate, other keys may have moved their counters since their last update.
+ * Point keys and counts to at most size candidates by decreasing estimate, then key. Return the number filled
+ */
+size_t sketch_top(t_sketch* sketch, const char** keys, uint32_t* counts, const size_t size) {
+    
+    uint32_t i;
+    size_t n = (sketch->cand_count < size) ? sketch->cand_count : size;
+    
+    for (i=0; i<sketch->cand_count; i++) {
+        sketch->cand[i].count = estimate(sketch, sketch->cand[i].hash);
+        sketch->order[i] = &sketch->cand[i];
+    }
+    for (i=sketch->cand_count/2; i>0; i--)              // estimates changed, heapify again
+        heap_down(sketch, i - 1);
+    
+    qsort(sketch->order, sketch->cand_count, sizeof(t_sketch_cand*), cand_compare);
+    
+    for (i=0; i<n; i++) {
+        keys[i] = cand_key(sketch->order[i]);
+        counts[i] = sketch->order[i]->count;
+    }
+    
+    return n;
+}
+
+/*
+ * Sum of every count
+ */
+uint64_t sketch_total(t_sketch* sketch) {
+    
+    return sketch->total;
+}
+
+/*
+ * Bytes used by the sketch
+ */
+size_t sketch_bytes(t_sketch* sketch) {
+    
+    return sizeof(t_sketch) + (size_t)sketch->width * sketch->depth * sizeof(uint32_t) +
+           sketch->cand_size * (sizeof(t_sketch_cand) + sizeof(uint32_t) + sizeof(t_sketch_cand*)) +
+           sketch->index_size * sizeof(uint32_t);
+}
+
+/*
+ * Number of candidates kept for passed error, 1/eps capped to SKETCH_MAX_CANDIDATES
+ */
+size_t sketch_candidates(const double eps) {
+    
+    double n = ceil(1 / eps);
+    
+    return (n < 1) ? 1 : (n > SKETCH_MAX_CANDIDATES) ? SKETCH_MAX_CANDIDATES : (size_t)n;
+}
+
+/*
+ * Create an empty filter with SKETCH_FILTER_CELLS_PER_KEY cells for each expected key
+ */
+t_sketch_filter* sketch_filter_create(const size_t keys) {
+    
+    size_t size = round_pow2(keys * SKETCH_FILTER_CELLS_PER_KEY);
+    t_sketch_filter* filter = calloc(1, sizeof(t_sketch_filter) + size);
+    
+    filter->size = size;
+    filter->used = 0;
+    
+    return filter;
+}
+
+/*
+ * Free the filter
+ */
+void sketch_filter_destroy(t_sketch_filter* filter) {
+    
+    free(filter);
+}
+
+/*
+ * Insert a key, unless each of its cells is already taken
+ */
+int sketch_filter_add(t_sketch_filter* filter, const char* key, const size_t len) {
+    
+    int i;
+    size_t pos[SKETCH_FILTER_HASHES];
+    const uint64_t h = hash_key(key, len);
+    int present = 1;
+    
+    for (i=0; i<SKETCH_FILTER_HASHES; i++) {
+        pos[i] = ((uint32_t)h + i * (uint32_t)((h >> 32) | 1)) & (filter->size - 1);
+        present &= filter->cell[pos[i]] != 0;
+    }
+    if (present)
+        return 0;
+    
+    for (i=0; i<SKETCH_FILTER_HASHES; i++) {
+        if (filter->cell[pos[i]] == 0)
+            filter->used++;
+        if (filter->cell[pos[i]] != CELL_STUCK)
+            filter->cell[pos[i]]++;
+    }
+    
+    return 1;
+}
+
+/*
+ * Remove a key if each of its cells is taken. Cells that reached CELL_STUCK stay taken
+ */
+int sketch_filter_del(t_sketch_filter* filter, const char* key, const size_t len) {
+    
+    int i;
+    size_t pos[SKETCH_FILTER_HASHES];
+    const uint64_t h = hash_key(key, len);
+    
+    for (i=0; i<SKETCH_FILTER_HASHES; i++) {
+        pos[i] = ((uint32_t)h + i * (uint32_t)((h >> 32) | 1)) & (filter->size - 1);
+        if (filter->cell[pos[i]] == 0)
+            return 0;
+    }
+    
+    for (i=0; i<SKETCH_FILTER_HASHES; i++) {
+        if (filter->cell[pos[i]] != CELL_STUCK)
+            filter->cell[pos[i]]--;
+        if (filter->cell[pos[i]] == 0)
+            filter->used--;
+    }
+    
+    return 1;
+}
+
+/*
+ * False positive probability, chance that every cell of a missing key is taken
+ */
+double sketch_filter_fp(t_sketch_filter* filter) {
+    
+    return pow((double)filter->used / filter->size, SKETCH_FILTER_HASHES);
+}
+
+/*
+ * Bytes used by the filter
+ */
+size_t sketch_filter_bytes(t_sketch_filter* filter) {
+    
+    return sizeof(t_sketch_filter) + filter->size;
+}
+
+/*
+ * Hash a key with FNV-1a and a final mix
+ */
+static inline uint64_t hash_key(const char* key, const size_t len) {
+    
+    size_t i;
+    uint64_t h = 14695981039346656037ULL;
+    
+    for (i=0; i<len; i++)
+        h = (h ^ (unsigned char)key[i]) * 1099511628211ULL;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    
+    return h;
+}
+
+/*
+ * Smallest power of 2 not less than n
+ */
+static inline size_t round_pow2(const size_t n) {
+    
+    size_t size = 1;
+    
+    while (size < n)
+        size = size << 1;
+    
+    return size;
+}
+
+/*
+ * Estimated count of a key, minimum of its counter in each row
+ */
+static inline uint32_t estimate(t_sketch* sketch, const uint64_t h) {
+    
+    uint32_t i, c, min = UINT32_MAX;
+    
+    for (i=0; i<sketch->depth; i++) {
+        c = sketch->counter[(size_t)i * sketch->width + (((uint32_t)h + i * (uint32_t)((h >> 32) | 1)) & (sketch->width - 1))];
+        if (c < min)
+            min = c;
+    }
+    
+    return min;
+}
+
+/*
+ * Find a candidate with linear probing on the index
+ */
+static int cand_find(t_sketch* sketch, const char* key, const size_t len, const uint64_t h) {
+    
+    size_t i;
+    t_sketch_cand* cand;
+    
+    for (i=h & (sketch->index_size-1); sketch->index[i] != 0; i=(i+1) & (sketch->index_size-1)) {
+        cand = &sketch->cand[sketch->index[i] - 1];
+        if (cand->hash == h && cand->len == len && memcmp(cand_key(cand), key, len) == 0)
+            return sketch->index[i] - 1;
+    }
+    
+    return -1;
+}
+
+/*
+ * Find the index slot of a candidate, it has to be in the index
+ */
+static size_t index_slot(t_sketch* sketch, const uint32_t c) {
+    
+    size_t i;
+    
+    for (i=sketch->cand[c].hash & (sketch->index_size-1); sketch->index[i] != c + 1; i=(i+1) & (sketch->index_size-1));
+    
+    return i;
+}
+
+/*
+ * Insert a candidate in the first free slot of its probe sequence, index is never more than half full
+ */
+static void index_insert(t_sketch* sketch, const uint32_t c) {
+    
+    size_t i;
+    
+    for (i=sketch->cand[c].hash & (sketch->index_size-1); sketch->index[i] != 0; i=(i+1) & (sketch->index_size-1));
+    sketch->index[i] = c + 1;
+}
+
+/*
+ * Remove the candidate in slot pos, moving back the following ones of the probe sequence
+ */
+static void index_delete(t_sketch* sketch, size_t pos) {
+    
+    size_t i, home;
+    const size_t mask = sketch->index_size - 1;
+    
+    for (i=(pos+1) & mask; sketch->index[i] != 0; i=(i+1) & mask) {
+        home = sketch->cand[sketch->index[i] - 1].hash & mask;
+        if (((i - home) & mask) >= ((i - pos) & mask)) {    // its home is not between pos and i, fill the hole
+            sketch->index[pos] = sketch->index[i];
+            pos = i;
+        }
+    }
+    sketch->index[pos] = 0;
+}
+
+/*
+ * Move a heap element up while its parent has a bigger count
+ */
+static void heap_up(t_sketch* sketch, uint32_t pos) {
+    
+    uint32_t parent, c = sketch->heap[pos];
+    
+    for (; pos > 0; pos = parent) {
+        parent = (pos - 1) / 2;
+        if (sketch->cand[sketch->heap[parent]].count <= sketch->cand[c].count)
+            break;
+        sketch->heap[pos] = sketch->heap[parent];
+        sketch->cand[sketch->heap[pos]].heap = pos;
+    }
+    sketch->heap[pos] = c;
+    sketch->cand[c].heap = pos;
+}
+
+/*
+ * Move a heap element down while one of its children has a smaller count
+ */
+static void heap_down(t_sketch* sketch, uint32_t pos) {
+    
+    uint32_t child, c = sketch->heap[pos];
+    
+    while ((child = 2 * pos + 1) < sketch->cand_count) {
+        if (child + 1 < sketch->cand_count && sketch->cand[sketch->heap[child+1]].count < sketch->cand[sketch->heap[child]].count)
+            child++;
+        if (sketch->cand[sketch->heap[child]].count >= sketch->cand[c].count)
+            break;
+        sketch->heap[pos] = sketch->heap[child];
+        sketch->cand[sketch->heap[pos]].heap = pos;
+        pos = child;
+    }
+    sketch->heap[pos] = c;
+    sketch->cand[c].heap = pos;
+}
+
+/*
+ * Remove a candidate. Last heap element fills its heap position, last candidate fills its array position
+ */
+static void cand_remove(t_sketch* sketch, const uint32_t c) {
+    
+    uint32_t pos = sketch->cand[c].heap;
+    uint32_t last = sketch->cand_count - 1;
+    uint32_t moved = sketch->heap[last];
+    
+    index_delete(sketch, index_slot(sketch, c));
+    cand_free_key(&sketch->cand[c]);
+    
+    sketch->cand_count--;                               // heap shrinks first, so that sifts do not see c
+    if (pos != last) {
+        sketch->heap[pos] = moved;
+        sketch->cand[moved].heap = pos;
+        heap_up(sketch, pos);
+        heap_down(sketch, sketch->cand[moved].heap);
+    }
+    
+    if (c != last) {                                    // move last candidate in the hole
+        sketch->index[index_slot(sketch, last)] = c + 1;
+        sketch->cand[c] = sketch->cand[last];
+        sketch->heap[sketch->cand[c].heap] = c;
+    }
+}
+
+/*
+ * Compare two candidates by decreasing count, then by key bytes
+ */
+static int cand_compare(const void* a, const void* b) {
+    
+    const t_sketch_cand* x = *(t_sketch_cand**)a;
+    const t_sketch_cand* y = *(t_sketch_cand**)b;
+    int cmp;
+    
+    if (x->count != y->count)
+        return (x->count > y->count) ? -1 : 1;
+    
+    cmp = memcmp(cand_key(x), cand_key(y), (x->len < y->len) ? x->len : y->len);
+    return (cmp != 0) ? cmp : (int)x->len - (int)y->len;
+}
+
+/*
+ * Bytes of the key of a candidate, inline or on the heap depending on its length
+ */
+static inline const char* cand_key(const t_sketch_cand* cand) {
+    
+    return (cand->len <= SKETCH_KEY_SIZE) ? cand->key : cand->long_key;
+}
+
+/*
+ * Store the key of a candidate, inline if it fits. Previous key has to be freed
+ */
+static inline void cand_set_key(t_sketch_cand* cand, const char* key, const size_t len) {
+    
+    char* dst = cand->key;
+    
+    if (len > SKETCH_KEY_SIZE)
+        dst = cand->long_key = malloc(len + 1);
+    memcpy(dst, key, len);
+    dst[len] = '\0';
+    cand->len = len;
+}
+
+/*
+ * Free the key of a candidate if it does not fit inline
+ */
+static inline void cand_free_key(t_sketch_cand* cand) {
+    
+    if (cand->len > SKETCH_KEY_SIZE)
+        free(cand->long_key);
+    cand->len = 0;
+}
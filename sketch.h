@@ -0,0 +1,73 @@
+#ifndef SKETCH_H
+#define SKETCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// DEFINES
+
+#define SKETCH_KEY_SIZE 80                      // longest key kept inline by a candidate, longer ones go to the heap
+#define SKETCH_MAX_CANDIDATES 1024              // candidates of a sketch, whatever the error asked
+#define SKETCH_FILTER_HASHES 4                  // cells of the edge filter touched by each key
+#define SKETCH_FILTER_CELLS_PER_KEY 10          // cells of the edge filter for each expected key, about 1% false positives
+
+// END OF DEFINES
+
+// Count-min sketch of the counts of byte string keys, with a fixed table of candidate heavy hitters.
+// Every estimate is at least the true count, at most eps * total above it with probability 1 - delta
+typedef struct sketch t_sketch;
+
+// Counting Bloom filter over byte string keys, tells whether a key is in the set with false positives only
+typedef struct sketch_filter t_sketch_filter;
+
+// FUNCTION PROTOTYPES
+
+// Create an empty sketch for additive error eps with failure probability delta
+t_sketch* sketch_create(const double eps, const double delta);
+
+// Free the sketch
+void sketch_destroy(t_sketch* sketch);
+
+// Add n, negative to remove, to the count of a key, keeping candidates up to date
+void sketch_update(t_sketch* sketch, const char* key, const size_t len, const int n);
+
+// Estimated count of a key
+uint32_t sketch_estimate(t_sketch* sketch, const char* key, const size_t len);
+
+// Drop a key from the candidates, its counters are left as they are
+void sketch_forget(t_sketch* sketch, const char* key, const size_t len);
+
+// Refresh candidate estimates and point keys to at most size of them by decreasing estimate, each one terminated. 
+// Return the number filled
+size_t sketch_top(t_sketch* sketch, const char** keys, uint32_t* counts, const size_t size);
+
+// Sum of every count, the total the error is relative to
+uint64_t sketch_total(t_sketch* sketch);
+
+// Bytes used by the sketch, fixed at creation
+size_t sketch_bytes(t_sketch* sketch);
+
+// Number of candidates a sketch created with passed error keeps
+size_t sketch_candidates(const double eps);
+
+// Create an empty filter sized for passed number of keys
+t_sketch_filter* sketch_filter_create(const size_t keys);
+
+// Free the filter
+void sketch_filter_destroy(t_sketch_filter* filter);
+
+// Insert a key. Return 1 if it was missing, 0 if it seems present already
+int sketch_filter_add(t_sketch_filter* filter, const char* key, const size_t len);
+
+// Remove a key. Return 1 if it seemed present, 0 if missing
+int sketch_filter_del(t_sketch_filter* filter, const char* key, const size_t len);
+
+// False positive probability of the filter at its current fill
+double sketch_filter_fp(t_sketch_filter* filter);
+
+// Bytes used by the filter, fixed at creation
+size_t sketch_filter_bytes(t_sketch_filter* filter);
+
+// END OF FUNCTION PROTOTYPES
+
+#endif
@@ -0,0 +1,439 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+
+#include "store.h"
+
+// DEFINES
+
+#define STORE_MAGIC "monitor-store 1"                   // first bytes of a store file
+#define STORE_BASE ((uintptr_t)1 << 45)                 // address tried first for a new store, far from heap, stacks and libraries
+#define STORE_SLOTS 64                                  // addresses tried for a new store, STORE_RESERVE apart
+
+#define PAGE_SIZE 4096                                  // unit of page runs and of file system hints
+#define STORE_GROW ((size_t)1 << 20)                    // initial size of the file, and unit of its growth
+#define CACHE_LINE_SIZE 64                              // alignment of page run blocks
+
+#define SMALL_HEADER 8                                  // bytes before a small block, its size
+#define LARGE_HEADER CACHE_LINE_SIZE                    // bytes before a page run block, its size in the last 8
+#define CLASS_STEP 16                                   // small classes grow by this many bytes up to CLASS_STEP_MAX, then double
+#define CLASS_STEP_MAX 256                              // biggest small class of the steps
+#define CLASS_COUNT 19                                  // small classes, 16 steps then doubling up to STORE_SMALL_MAX
+
+#define PREFETCH_MIN (64 * 1024)                        // shortest range worth a readahead request
+
+// END OF DEFINES
+
+// Free page run, kept at the start of its first page in a list ordered by address
+typedef struct store_run {
+
+    struct store_run* next;             // next free run at a higher address, NULL if last
+    size_t pages;                       // length of the run in pages
+
+} t_store_run;
+
+// Header of the file, on its first page. Every pointer holds the address the file is mapped at
+typedef struct store_header {
+
+    char magic[16];                     // STORE_MAGIC, terminated
+    uintptr_t base;                     // address the file is mapped at
+    size_t size;                        // bytes of the file
+    size_t top;                         // offset of the first page never allocated
+    size_t used;                        // bytes of live blocks, headers included
+    size_t runs;                        // free page runs
+    void* small_free[CLASS_COUNT];      // first free block of each small class, NULL if none
+    t_store_run* large_free;            // first free page run, NULL if none
+    char root[STORE_ROOT_SIZE] __attribute__((aligned(CACHE_LINE_SIZE)));     // root record of the owner
+
+} t_store_header;
+
+struct store {
+
+    int fd;                             // file of the store, locked while open
+    t_store_header* head;               // header, at the start of the mapping
+
+};
+
+// FUNCTION PROTOTYPES
+
+// Map the whole reserve of the file at addr, failing if anything is mapped there
+static void* map_at(const int fd, const uintptr_t addr);
+
+// Grow the file so that it covers the first end bytes. Return 0, -1 if the reserve or the disk is full
+static int grow(t_store* store, const size_t end);
+
+// Take a run of pages, first fit among free runs, else from the top. Return NULL if the store is full
+static t_store_run* take_pages(t_store* store, const size_t pages);
+
+// Put back a run of pages among free runs, merged with its neighbours
+static void give_pages(t_store* store, t_store_run* run, const size_t pages);
+
+// Small class of a block of passed bytes, header included
+static inline int class_of(const size_t bytes);
+
+// Bytes of the blocks of a small class, header included
+static inline size_t class_size(const int c);
+
+// Bytes of a block, header included
+static inline size_t block_size(const void* p);
+
+// END OF FUNCTION PROTOTYPES
+
+/*
+ * Open the store kept in path, created empty if the file is missing or empty.
+ * The file is locked so that a second monitor cannot map it meanwhile
+ */
+t_store* store_open(const char* path, int* created) {
+    
+    int i, fd = open(path, O_RDWR | O_CREAT, 0644);
+    struct stat st;
+    t_store_header head;
+    t_store* store;
+    void* base = MAP_FAILED;
+    
+    *created = 0;
+    if (fd < 0)
+        return NULL;
+    if (flock(fd, LOCK_EX | LOCK_NB) != 0 || fstat(fd, &st) != 0) {
+        close(fd);
+        return NULL;
+    }
+    
+    if (st.st_size == 0) {                                  // new store, at the first free slot of address space
+        if (ftruncate(fd, STORE_GROW) == 0)
+            for (i=0; i<STORE_SLOTS && base == MAP_FAILED; i++)
+                base = map_at(fd, STORE_BASE + i * STORE_RESERVE);
+        if (base != MAP_FAILED) {
+            memcpy(((t_store_header*)base)->magic, STORE_MAGIC, sizeof(STORE_MAGIC));   // the rest is zero
+            ((t_store_header*)base)->base = (uintptr_t)base;
+            ((t_store_header*)base)->size = STORE_GROW;
+            ((t_store_header*)base)->top = (sizeof(t_store_header) + PAGE_SIZE - 1) & ~(size_t)(PAGE_SIZE - 1);
+            *created = 1;
+        }
+    }
+    else if (pread(fd, &head, sizeof(head), 0) == sizeof(head) && memcmp(head.magic, STORE_MAGIC, sizeof(STORE_MAGIC)) == 0)
+        base = map_at(fd, head.base);                       // where its pointers expect it
+    
+    if (base == MAP_FAILED) {
+        close(fd);
+        return NULL;
+    }
+    
+    store = malloc(sizeof(t_store));
+    store->fd = fd;
+    store->head = base;
+    
+    return store;
+}
+
+/*
+ * Write the store back to its file and unmap it
+ */
+void store_close(t_store* store) {
+    
+    msync(store->head, store->head->size, MS_SYNC);
+    munmap(store->head, STORE_RESERVE);
+    close(store->fd);                                       // releases the lock
+    free(store);
+}
+
+/*
+ * Map the whole reserve of the file at addr. Pages past the end of the file are not touched until it grows
+ */
+static void* map_at(const int fd, const uintptr_t addr) {
+    
+    void* base = mmap((void*)addr, STORE_RESERVE, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED_NOREPLACE, fd, 0);
+    
+    if (base != MAP_FAILED && base != (void*)addr) {       // kernels before 4.17 take the address as a hint
+        munmap(base, STORE_RESERVE);
+        base = MAP_FAILED;
+    }
+    
+    return base;
+}
+
+/*
+ * Grow the file so that it covers the first end bytes, doubling its size so that few calls are needed.
+ * The file is sparse, pages take disk space once written
+ */
+static int grow(t_store* store, const size_t end) {
+    
+    size_t size = store->head->size;
+    
+    if (end <= size)
+        return 0;
+    if (end > STORE_RESERVE)
+        return -1;
+    
+    size = size << 1;
+    if (size < end)
+        size = (end + STORE_GROW - 1) & ~(STORE_GROW - 1);
+    if (size > STORE_RESERVE)
+        size = STORE_RESERVE;
+    
+    if (ftruncate(store->fd, size) != 0)
+        return -1;
+    store->head->size = size;
+    
+    return 0;
+}
+
+/*
+ * Take a run of pages, first fit among free runs splitting the rest off, else from the top of the file
+ */
+static t_store_run* take_pages(t_store* store, const size_t pages) {
+    
+    t_store_header* head = store->head;
+    t_store_run** link;
+    t_store_run* run;
+    t_store_run* rest;
+    
+    for (link=&head->large_free; (run = *link) != NULL; link=&run->next)
+        if (run->pages >= pages) {
+            if (run->pages > pages) {                       // rest of the run stays free in its place
+                rest = (t_store_run*)((char*)run + pages * PAGE_SIZE);
+                rest->next = run->next;
+                rest->pages = run->pages - pages;
+                *link = rest;
+            }
+            else {
+                *link = run->next;
+                head->runs--;
+            }
+            return run;
+        }
+    
+    if (grow(store, head->top + pages * PAGE_SIZE) != 0)
+        return NULL;
+    run = (t_store_run*)(head->base + head->top);
+    head->top += pages * PAGE_SIZE;
+    
+    return run;
+}
+
+/*
+ * Put back a run of pages among free runs, in address order so that neighbours merge
+ */
+static void give_pages(t_store* store, t_store_run* run, const size_t pages) {
+    
+    t_store_header* head = store->head;
+    t_store_run** link = &head->large_free;
+    t_store_run* prev = NULL;
+    t_store_run* next;
+    
+    while (*link != NULL && *link < run) {
+        prev = *link;
+        link = &prev->next;
+    }
+    
+    run->next = *link;
+    run->pages = pages;
+    *link = run;
+    head->runs++;
+    
+    next = run->next;
+    if (next != NULL && (char*)run + run->pages * PAGE_SIZE == (char*)next) {      // merge with the run after
+        run->pages += next->pages;
+        run->next = next->next;
+        head->runs--;
+    }
+    if (prev != NULL && (char*)prev + prev->pages * PAGE_SIZE == (char*)run) {     // merge with the run before
+        prev->pages += run->pages;
+        prev->next = run->next;
+        head->runs--;
+    }
+}
+
+/*
+ * Small class of a block of passed bytes, header included. Steps keep short names close to their size
+ */
+static inline int class_of(const size_t bytes) {
+    
+    int c = CLASS_STEP_MAX / CLASS_STEP;
+    
+    if (bytes <= CLASS_STEP_MAX)
+        return (bytes + CLASS_STEP - 1) / CLASS_STEP - 1;
+    while ((CLASS_STEP_MAX << (c - CLASS_STEP_MAX / CLASS_STEP + 1)) < bytes)
+        c++;
+    
+    return c;
+}
+
+/*
+ * Bytes of the blocks of a small class, header included
+ */
+static inline size_t class_size(const int c) {
+    
+    if (c < CLASS_STEP_MAX / CLASS_STEP)
+        return (c + 1) * CLASS_STEP;
+    
+    return (size_t)CLASS_STEP_MAX << (c - CLASS_STEP_MAX / CLASS_STEP + 1);
+}
+
+/*
+ * Bytes of a block, kept right before it for small blocks and page runs alike
+ */
+static inline size_t block_size(const void* p) {
+    
+    return ((const size_t*)p)[-1];
+}
+
+/*
+ * Allocate size bytes. Small blocks come from pages split into blocks of one class, others take whole pages
+ */
+void* store_alloc(t_store* store, const size_t size) {
+    
+    t_store_header* head = store->head;
+    size_t off, bytes = size + SMALL_HEADER, pages;
+    int c;
+    char* p;
+    
+    if (bytes <= STORE_SMALL_MAX) {
+        c = class_of(bytes);
+        bytes = class_size(c);
+        if (head->small_free[c] == NULL) {                  // split a new page into blocks of the class
+            p = (char*)take_pages(store, 1);
+            if (p == NULL)
+                return NULL;
+            for (off=(PAGE_SIZE / bytes) * bytes; off>0; off-=bytes) {      // listed in address order
+                ((size_t*)(p + off - bytes + SMALL_HEADER))[-1] = bytes;
+                *(void**)(p + off - bytes + SMALL_HEADER) = head->small_free[c];
+                head->small_free[c] = p + off - bytes + SMALL_HEADER;
+            }
+        }
+        p = head->small_free[c];
+        head->small_free[c] = *(void**)p;
+    }
+    else {
+        pages = (size + LARGE_HEADER + PAGE_SIZE - 1) / PAGE_SIZE;
+        bytes = pages * PAGE_SIZE;
+        p = (char*)take_pages(store, pages);
+        if (p == NULL)
+            return NULL;
+        p += LARGE_HEADER;
+        ((size_t*)p)[-1] = bytes;
+    }
+    head->used += bytes;
+    
+    return p;
+}
+
+/*
+ * Allocate n zeroed elements of size bytes, reused blocks are not zero
+ */
+void* store_calloc(t_store* store, const size_t n, const size_t size) {
+    
+    void* p = store_alloc(store, n * size);
+    
+    if (p != NULL)
+        memset(p, 0, n * size);
+    
+    return p;
+}
+
+/*
+ * Resize a block keeping its content. A block keeps its place if it has room, or if it is the last run of the file
+ */
+void* store_realloc(t_store* store, void* p, const size_t size) {
+    
+    t_store_header* head = store->head;
+    size_t bytes, room, pages;
+    void* q;
+    
+    if (p == NULL)
+        return store_alloc(store, size);
+    
+    bytes = block_size(p);
+    room = bytes - (bytes <= STORE_SMALL_MAX ? SMALL_HEADER : LARGE_HEADER);
+    if (size <= room)
+        return p;
+    
+    if (bytes > STORE_SMALL_MAX && (char*)p - LARGE_HEADER + bytes == (char*)(head->base + head->top)) {
+        pages = (size + LARGE_HEADER + PAGE_SIZE - 1) / PAGE_SIZE;
+        if (grow(store, head->top + pages * PAGE_SIZE - bytes) == 0) {     // last run grows over the top
+            head->top += pages * PAGE_SIZE - bytes;
+            head->used += pages * PAGE_SIZE - bytes;
+            ((size_t*)p)[-1] = pages * PAGE_SIZE;
+            return p;
+        }
+    }
+    
+    q = store_alloc(store, size);
+    if (q == NULL)
+        return NULL;
+    memcpy(q, p, room);
+    store_free(store, p);
+    
+    return q;
+}
+
+/*
+ * Release a block. Small blocks go back to the list of their class, the pages of a run after its first one
+ * are punched out of the file so that it does not hold their content anymore
+ */
+void store_free(t_store* store, void* p) {
+    
+    t_store_header* head = store->head;
+    size_t bytes;
+    int c;
+    char* run;
+    
+    if (p == NULL)
+        return;
+    
+    bytes = block_size(p);
+    head->used -= bytes;
+    
+    if (bytes <= STORE_SMALL_MAX) {
+        c = class_of(bytes);
+        *(void**)p = head->small_free[c];
+        head->small_free[c] = p;
+    }
+    else {
+        run = (char*)p - LARGE_HEADER;
+        if (bytes > PAGE_SIZE)
+            madvise(run + PAGE_SIZE, bytes - PAGE_SIZE, MADV_REMOVE);      // first page keeps the free run record
+        give_pages(store, (t_store_run*)run, bytes / PAGE_SIZE);
+    }
+}
+
+/*
+ * Root record of the owner, kept in the header
+ */
+void* store_root(t_store* store) {
+    
+    return store->head->root;
+}
+
+/*
+ * Ask the kernel to read ahead the pages of [p, p+len) before a scan. Short ranges are likely resident already
+ * and would pay a system call for nothing
+ */
+void store_prefetch(t_store* store, const void* p, const size_t len) {
+    
+    uintptr_t start = (uintptr_t)p & ~(uintptr_t)(PAGE_SIZE - 1);
+    
+    if (len >= PREFETCH_MIN)
+        madvise((void*)start, (uintptr_t)p + len - start, MADV_WILLNEED);
+}
+
+/*
+ * Print file size, bytes on disk once holes are left out, and bytes in use of the store
+ */
+void store_print_stats(t_store* store, FILE* out) {
+    
+    struct stat st;
+    
+    if (fstat(store->fd, &st) != 0)
+        st.st_blocks = 0;
+    
+    fprintf(out, "store: %zu KB file, %zu KB on disk, %zu KB in use, %zu free page runs\n", store->head->size >> 10,
+            (size_t)st.st_blocks >> 1, store->head->used >> 10, store->head->runs);
+}
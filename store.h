@@ -0,0 +1,52 @@
+#ifndef STORE_H
+#define STORE_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+// DEFINES
+
+#define STORE_RESERVE ((size_t)1 << 36)         // address space of one store, the most its file can grow to
+#define STORE_ROOT_SIZE 1024                    // bytes of the root record kept in the header for the owner of the store
+#define STORE_SMALL_MAX 2048                    // biggest block carved from shared pages, header included, bigger ones take whole pages
+
+// END OF DEFINES
+
+// File-backed memory: a file mapped shared at the same address by every process opening it, with an allocator
+// whose state lives in the file too, so that pointers between blocks stay valid when the file is opened again.
+// Blocks are 8 bytes aligned, cache line aligned above STORE_SMALL_MAX. One thread at a time may use a store
+typedef struct store t_store;
+
+// FUNCTION PROTOTYPES
+
+// Open the store kept in path, created empty if the file is missing or empty, *created is set to 1 then.
+// Return NULL if the file is something else or cannot be mapped at its address
+t_store* store_open(const char* path, int* created);
+
+// Write the store back to its file and unmap it, blocks stay allocated in the file
+void store_close(t_store* store);
+
+// Allocate size bytes. Return NULL if the store is full
+void* store_alloc(t_store* store, const size_t size);
+
+// Allocate n zeroed elements of size bytes. Return NULL if the store is full
+void* store_calloc(t_store* store, const size_t n, const size_t size);
+
+// Resize a block keeping its content, allocated if p is NULL, like realloc
+void* store_realloc(t_store* store, void* p, const size_t size);
+
+// Release a block, nothing if p is NULL. Pages of a released run go back to the file system
+void store_free(t_store* store, void* p);
+
+// Root record of the owner, STORE_ROOT_SIZE bytes zeroed at creation and kept in the file
+void* store_root(t_store* store);
+
+// Ask the kernel to read ahead the pages of [p, p+len) before a scan, nothing for short ranges
+void store_prefetch(t_store* store, const void* p, const size_t len);
+
+// Print file size and bytes in use of the store
+void store_print_stats(t_store* store, FILE* out);
+
+// END OF FUNCTION PROTOTYPES
+
+#endif
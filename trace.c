@@ -0,0 +1,249 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "trace.h"
+
+// DEFINES
+
+#define NAME_INDEX_SIZE 1024                    // initial slots of the name index, power of 2
+#define NAME_BYTES_SIZE 65536                   // initial size of the dictionary
+#define TOKEN_COUNT 5                           // command and its arguments, the most a line uses
+
+// END OF DEFINES
+
+// Names met so far with their id, in order of first appearance
+typedef struct trace_dict {
+
+    char* bytes;                        // names one after the other, terminated
+    uint64_t bytes_len;                 // bytes used
+    uint64_t bytes_size;                // size of bytes
+    uint64_t* offset;                   // start of each name in bytes, by id
+    uint32_t* index;                    // open addressing on name hash, id + 1, 0 if free
+    uint32_t count;                     // number of names
+    uint32_t index_size;                // slots of index, power of 2
+
+} t_trace_dict;
+
+// Records waiting to be written
+typedef struct trace_writer {
+
+    FILE* file;                         // where chunks go
+    t_trace_record* buf;                // chunk being filled
+    size_t n;                           // records in the chunk
+    uint64_t count;                     // records put so far
+
+} t_trace_writer;
+
+// FUNCTION PROTOTYPES
+
+// Id of a name, added to the dictionary if new
+static uint32_t name_id(t_trace_dict* dict, const char* name);
+
+// FNV-1a hash of a name
+static inline uint64_t name_hash(const char* name, const size_t len);
+
+// Double the slots of the name index
+static void grow_index(t_trace_dict* dict);
+
+// Write one record, buffered
+static void put_record(t_trace_writer* w, const uint32_t op, const uint32_t a, const uint32_t b, const uint32_t c);
+
+// END OF FUNCTION PROTOTYPES
+
+/*
+ * Convert text into binary. Records are written to a temporary file while the dictionary grows,
+ * then the dictionary and the records are copied after the header
+ */
+int trace_convert(FILE* in, FILE* out) {
+    
+    t_trace_dict dict;
+    t_trace_header header;
+    t_trace_writer w;
+    char* line = NULL;
+    char* token[TOKEN_COUNT];
+    char* save;
+    char* end;
+    size_t cap = 0, got;
+    uint64_t num;
+    long k;
+    int tokens, add, status = 0;
+    
+    w.file = tmpfile();
+    if (w.file == NULL) {
+        perror("tmpfile");
+        return -1;
+    }
+    w.buf = malloc(TRACE_CHUNK * sizeof(t_trace_record));
+    w.n = w.count = 0;
+    
+    memset(&dict, 0, sizeof(dict));
+    dict.bytes_size = NAME_BYTES_SIZE;
+    dict.bytes = malloc(dict.bytes_size);
+    dict.offset = malloc(NAME_INDEX_SIZE * sizeof(uint64_t));
+    dict.index_size = NAME_INDEX_SIZE;
+    dict.index = calloc(dict.index_size, sizeof(uint32_t));
+    
+    while (getline(&line, &cap, in) > 0) {
+        tokens = 0;                                         // split on blanks, as sscanf does
+        token[0] = strtok_r(line, " \t\r\n\v\f", &save);
+        while (token[tokens] != NULL && ++tokens < TOKEN_COUNT)
+            token[tokens] = strtok_r(NULL, " \t\r\n\v\f", &save);
+        if (tokens == 0)
+            continue;
+    
+        if (strcmp(token[0], "addent") == 0 && tokens >= 2)
+            put_record(&w, TRACE_ADDENT, name_id(&dict, token[1]), 0, 0);
+    
+        else if (strcmp(token[0], "delent") == 0 && tokens >= 2)
+            put_record(&w, TRACE_DELENT, name_id(&dict, token[1]), 0, 0);
+    
+        else if ((strcmp(token[0], "addrel") == 0 || strcmp(token[0], "delrel") == 0) && tokens >= 4) {
+            add = token[0][0] == 'a';
+            if (add && tokens >= 5) {                       // optional ttl, if numeric
+                num = strtoull(token[4], &end, 10);
+                if (end != token[4])
+                    put_record(&w, TRACE_TTL, (uint32_t)num, (uint32_t)(num >> 32), 0);
+            }
+            put_record(&w, add ? TRACE_ADDREL : TRACE_DELREL,
+                       name_id(&dict, token[1]), name_id(&dict, token[2]), name_id(&dict, token[3]));
+        }
+    
+        else if (strcmp(token[0], "report") == 0)
+            put_record(&w, TRACE_REPORT, 0, 0, 0);
+    
+        else if (strcmp(token[0], "tick") == 0) {           // one if not given
+            num = tokens >= 2 ? strtoull(token[1], &end, 10) : 1;
+            if (tokens >= 2 && end == token[1])
+                num = 1;
+            put_record(&w, TRACE_TICK, (uint32_t)num, (uint32_t)(num >> 32), 0);
+        }
+    
+        else if (strcmp(token[0], "topk") == 0 && tokens >= 2) {
+            k = strtol(token[1], &end, 10);
+            if (end != token[1] && k > 0)
+                put_record(&w, TRACE_TOPK, (uint32_t)k, 0, 0);
+        }
+    
+        else if (strcmp(token[0], "end") == 0) {
+            put_record(&w, TRACE_END, 0, 0, 0);
+            break;
+        }
+    }
+    free(line);
+    
+    if (w.n > 0)                                            // last partial chunk
+        fwrite(w.buf, sizeof(t_trace_record), w.n, w.file);
+    
+    header.name_count = dict.count;
+    header.reserved = 0;
+    header.names_bytes = dict.bytes_len;
+    header.record_count = w.count;
+    fputs(TRACE_MAGIC, out);
+    fwrite(&header, sizeof(header), 1, out);
+    fwrite(dict.bytes, 1, dict.bytes_len, out);
+    
+    rewind(w.file);
+    while ((got = fread(w.buf, sizeof(t_trace_record), TRACE_CHUNK, w.file)) > 0)
+        fwrite(w.buf, sizeof(t_trace_record), got, out);
+    
+    if (ferror(w.file) || ferror(out) || fflush(out) != 0) {
+        perror("trace");
+        status = -1;
+    }
+    
+    fclose(w.file);
+    free(w.buf);
+    free(dict.bytes);
+    free(dict.offset);
+    free(dict.index);
+    
+    return status;
+}
+
+/*
+ * Find the id of a name with linear probing, appending the name to the dictionary if missing
+ */
+static uint32_t name_id(t_trace_dict* dict, const char* name) {
+    
+    size_t len = strlen(name);
+    uint32_t i, id;
+    
+    for (i = name_hash(name, len) & (dict->index_size - 1); dict->index[i] != 0; i = (i + 1) & (dict->index_size - 1)) {
+        id = dict->index[i] - 1;
+        if (strcmp(dict->bytes + dict->offset[id], name) == 0)
+            return id;
+    }
+    
+    while (dict->bytes_len + len + 1 > dict->bytes_size) {  // double size if full
+        dict->bytes_size = dict->bytes_size << 1;
+        dict->bytes = realloc(dict->bytes, dict->bytes_size);
+    }
+    memcpy(dict->bytes + dict->bytes_len, name, len);
+    dict->bytes[dict->bytes_len + len] = '\0';
+    
+    id = dict->count++;
+    dict->offset[id] = dict->bytes_len;
+    dict->bytes_len += len + 1;
+    dict->index[i] = id + 1;
+    
+    if (dict->count << 1 > dict->index_size)                // keep load under one half
+        grow_index(dict);
+    
+    return id;
+}
+
+/*
+ * FNV-1a over the characters of a name
+ */
+static inline uint64_t name_hash(const char* name, const size_t len) {
+    
+    uint64_t h = 14695981039346656037ULL;
+    size_t i;
+    
+    for (i=0; i<len; i++) {
+        h ^= (unsigned char)name[i];
+        h *= 1099511628211ULL;
+    }
+    
+    return h;
+}
+
+/*
+ * Double the index and the offsets by id, reinserting every name
+ */
+static void grow_index(t_trace_dict* dict) {
+    
+    uint32_t i, id;
+    const char* name;
+    
+    dict->index_size = dict->index_size << 1;
+    dict->offset = realloc(dict->offset, dict->index_size * sizeof(uint64_t));
+    free(dict->index);
+    dict->index = calloc(dict->index_size, sizeof(uint32_t));
+    
+    for (id=0; id<dict->count; id++) {
+        name = dict->bytes + dict->offset[id];
+        for (i = name_hash(name, strlen(name)) & (dict->index_size - 1); dict->index[i] != 0; i = (i + 1) & (dict->index_size - 1))
+            ;
+        dict->index[i] = id + 1;
+    }
+}
+
+/*
+ * Append a record to the chunk, written out when full
+ */
+static void put_record(t_trace_writer* w, const uint32_t op, const uint32_t a, const uint32_t b, const uint32_t c) {
+    
+    w->buf[w->n].op = op;
+    w->buf[w->n].arg[0] = a;
+    w->buf[w->n].arg[1] = b;
+    w->buf[w->n].arg[2] = c;
+    w->count++;
+    
+    if (++w->n == TRACE_CHUNK) {
+        fwrite(w->buf, sizeof(t_trace_record), TRACE_CHUNK, w->file);
+        w->n = 0;
+    }
+}
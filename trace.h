@@ -0,0 +1,57 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+// Binary command trace, read by monitor_execute in place of text when it starts with TRACE_MAGIC:
+//   TRACE_MAGIC line
+//   t_trace_header
+//   names_bytes bytes of names, each one terminated, id of a name is its position
+//   record_count t_trace_record
+// Integers are in host byte order, a trace is replayed on the kind of machine that wrote it
+
+// DEFINES
+
+#define TRACE_MAGIC "#monitor-trace 1\n"        // first line of a binary trace, an unknown command for the text grammar
+#define TRACE_CHUNK 4096                        // records read or written at once
+
+#define TRACE_ADDENT 1                          // addent name[arg0]
+#define TRACE_DELENT 2                          // delent name[arg0]
+#define TRACE_ADDREL 3                          // addrel name[arg0] name[arg1] name[arg2]
+#define TRACE_DELREL 4                          // delrel name[arg0] name[arg1] name[arg2]
+#define TRACE_REPORT 5                          // report
+#define TRACE_TOPK 6                            // topk arg0
+#define TRACE_TICK 7                            // tick arg0 | arg1 << 32
+#define TRACE_TTL 8                             // ttl arg0 | arg1 << 32 of the addrel right after
+#define TRACE_END 9                             // end
+
+// END OF DEFINES
+
+// Sizes of the sections after the magic line
+typedef struct trace_header {
+
+    uint32_t name_count;                // names in the dictionary
+    uint32_t reserved;                  // 0
+    uint64_t names_bytes;               // bytes of the dictionary, terminators included
+    uint64_t record_count;              // records after the dictionary
+
+} t_trace_header;
+
+// One command, names by id
+typedef struct trace_record {
+
+    uint32_t op;                        // one of TRACE_ADDENT ... TRACE_END
+    uint32_t arg[3];                    // name ids or numbers, unused ones are 0
+
+} t_trace_record;
+
+// FUNCTION PROTOTYPES
+
+// Convert a text trace of monitor_execute grammar into a binary trace, until 'end' or end of input.
+// Lines that the text grammar ignores are dropped. Return 0, -1 if out cannot be written
+int trace_convert(FILE* in, FILE* out);
+
+// END OF FUNCTION PROTOTYPES
+
+#endif